@@ -9,11 +9,22 @@ static struct tcp_connection tcp_connections[MAX_TCP_CONNECTIONS];
 // TCP端口表
 static struct tcp_port tcp_ports[MAX_TCP_PORTS];
 
+// 连接进入CLOSED：归还连接槽和本地端口，所有到达CLOSED的路径都经过这里
+static void tcp_release(struct tcp_connection* conn) {
+    if (conn->state == TCP_STATE_CLOSED) {
+        return;
+    }
+    timer_cancel(&conn->timer);
+    conn->state = TCP_STATE_CLOSED;
+    tcp_free_port(conn->local_port);
+}
+
 // 初始化TCP协议栈
 void tcp_init() {
     // 初始化连接表
     for (int i = 0; i < MAX_TCP_CONNECTIONS; i++) {
         tcp_connections[i].state = TCP_STATE_CLOSED;
+        timer_setup(&tcp_connections[i].timer, tcp_timer_expired, &tcp_connections[i]);
     }
     
     // 初始化端口表
@@ -61,7 +72,7 @@ struct tcp_connection* tcp_connect(struct ip_address dest_ip, unsigned short des
     
     // 发送SYN包
     if (tcp_send_syn(conn) < 0) {
-        conn->state = TCP_STATE_CLOSED;
+        tcp_release(conn);
         print_string("TCP: Failed to send SYN packet\n");
         return 0;
     }
@@ -81,15 +92,34 @@ void tcp_close(struct tcp_connection* conn) {
     
     print_string("TCP: Closing connection\n");
     
-    // 如果连接已建立，执行四次挥手
-    if (conn->state == TCP_STATE_ESTABLISHED) {
-        conn->state = TCP_STATE_FIN_WAIT_1;
-        // 发送FIN包
-        tcp_send_fin(conn);
-        // 等待ACK和对端FIN (简化实现)
-        conn->state = TCP_STATE_CLOSED;
-    } else {
-        conn->state = TCP_STATE_CLOSED;
+    switch (conn->state) {
+        case TCP_STATE_ESTABLISHED:
+            // 主动关闭：发送FIN后停留在FIN_WAIT_1，对端的ACK和FIN由tcp_handle_segment推进到TIME_WAIT
+            conn->state = TCP_STATE_FIN_WAIT_1;
+            if (tcp_send_fin(conn) < 0) {
+                tcp_release(conn);
+            }
+            break;
+            
+        case TCP_STATE_CLOSE_WAIT:
+            // 被动关闭：对端已经发送FIN，发送自己的FIN后等待最后的ACK
+            conn->state = TCP_STATE_LAST_ACK;
+            if (tcp_send_fin(conn) < 0) {
+                tcp_release(conn);
+            }
+            break;
+            
+        case TCP_STATE_FIN_WAIT_1:
+        case TCP_STATE_FIN_WAIT_2:
+        case TCP_STATE_CLOSING:
+        case TCP_STATE_LAST_ACK:
+            // 已经在关闭过程中
+            break;
+            
+        default:
+            // 尚未建立的连接和TIME_WAIT中的连接立即关闭
+            tcp_release(conn);
+            break;
     }
 }
 
@@ -203,6 +233,13 @@ int tcp_handle_segment(struct tcp_header* header, unsigned char* data, unsigned
             }
             break;
             
+        case TCP_STATE_LAST_ACK:
+            // 对端确认了我们的FIN，被动关闭完成
+            if (header->flags & TCP_FLAG_ACK) {
+                tcp_release(conn);
+            }
+            break;
+            
         default:
             break;
     }
@@ -440,19 +477,33 @@ int tcp_handle_fin(struct tcp_connection* conn, struct tcp_header* header, unsig
             
         case TCP_STATE_FIN_WAIT_1:
         case TCP_STATE_FIN_WAIT_2:
+            // 等待2MSL后由连接定时器关闭连接，期间连接槽不会被复用
             conn->state = TCP_STATE_TIME_WAIT;
-            // 等待一段时间后关闭连接
-            conn->state = TCP_STATE_CLOSED;
+            conn->timeout = get_current_tick() + TCP_TIME_WAIT_TICKS;
+            if (timer_add(&conn->timer, conn->timeout) != 0) {
+                // 定时器堆已满，立即结束等待
+                tcp_release(conn);
+            }
             break;
             
         default:
-            conn->state = TCP_STATE_CLOSED;
+            tcp_release(conn);
             break;
     }
     
     return 0;
 }
 
+// 连接定时器到期
+void tcp_timer_expired(void* data) {
+    struct tcp_connection* conn = (struct tcp_connection*)data;
+    
+    // TIME_WAIT结束，释放连接槽和本地端口
+    if (conn->state == TCP_STATE_TIME_WAIT) {
+        tcp_release(conn);
+    }
+}
+
 // 生成初始序列号
 unsigned int generate_initial_sequence_number() {
     // 在实际实现中，这里会生成一个随机的初始序列号
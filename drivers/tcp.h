@@ -2,6 +2,7 @@
 #define TCP_H
 
 #include "network.h"
+#include "../kernel/timer.h"
 
 // TCP最大连接数和端口数
 #define MAX_TCP_CONNECTIONS 64
@@ -33,6 +34,9 @@
 // TCP默认窗口大小
 #define TCP_DEFAULT_WINDOW_SIZE     8192
 
+// TIME_WAIT状态保持的tick数（2MSL），到期后由连接定时器关闭连接
+#define TCP_TIME_WAIT_TICKS         2000
+
 // TCP端口结构
 struct tcp_port {
     unsigned short port;
@@ -70,6 +74,7 @@ struct tcp_connection {
     unsigned int receive_buffer_tail;       // 接收缓冲区尾指针
     unsigned int window_size;               // 窗口大小
     unsigned int timeout;                   // 超时时间
+    struct timer timer;                     // 连接定时器（TIME_WAIT等超时）
 };
 
 // 函数声明
@@ -92,6 +97,7 @@ int tcp_handle_syn(struct tcp_connection* conn, struct tcp_header* header, unsig
 int tcp_handle_syn_ack(struct tcp_connection* conn, struct tcp_header* header, unsigned char* data, unsigned int length);
 int tcp_handle_data(struct tcp_connection* conn, struct tcp_header* header, unsigned char* data, unsigned int length);
 int tcp_handle_fin(struct tcp_connection* conn, struct tcp_header* header, unsigned char* data, unsigned int length);
+void tcp_timer_expired(void* data);
 
 // 辅助函数
 unsigned int generate_initial_sequence_number();
@@ -0,0 +1,397 @@
+#include "clockevent.h"
+#include "kernel.h"
+#include "timer.h"
+#include "vm.h"
+#include "smp.h"
+#include "clocksource.h"
+#include "logger.h"
+
+// 系统tick计数：周期模式下每次时钟中断加1，无tick空闲结束时一次性补上空闲期间经过的tick数
+static volatile unsigned int clock_jiffies = 0;
+
+// 当前使用的时钟事件设备
+static struct clock_event_device* clock_device = 0;
+
+// 无tick空闲状态：one-shot已编程的tick数，以及它是否已经到期
+static volatile int idle_oneshot = 0;
+static volatile int idle_oneshot_fired = 0;
+static unsigned int idle_programmed = 0;
+
+// 时钟事件统计
+static struct clockevent_stats clock_stats;
+
+// ---------------- PIT（8254通道0） ----------------
+
+// 周期模式（模式2，频率发生器）
+static void pit_set_periodic() {
+    outb(PIT_COMMAND, 0x34);
+    outb(PIT_CHANNEL0, PIT_COUNTS_PER_TICK & 0xFF);
+    outb(PIT_CHANNEL0, (PIT_COUNTS_PER_TICK >> 8) & 0xFF);
+}
+
+// one-shot模式（模式0，计数到0时中断一次）
+static void pit_set_oneshot(unsigned int ticks) {
+    unsigned int count = ticks * PIT_COUNTS_PER_TICK;
+    if (count > 0xFFFF) {
+        count = 0xFFFF;
+    }
+    
+    outb(PIT_COMMAND, 0x30);
+    outb(PIT_CHANNEL0, count & 0xFF);
+    outb(PIT_CHANNEL0, (count >> 8) & 0xFF);
+}
+
+// 锁存并读取当前计数，向上取整为tick
+static unsigned int pit_remaining() {
+    outb(PIT_COMMAND, 0x00);
+    unsigned int count = inb(PIT_CHANNEL0);
+    count |= (unsigned int)inb(PIT_CHANNEL0) << 8;
+    return (count + PIT_COUNTS_PER_TICK - 1) / PIT_COUNTS_PER_TICK;
+}
+
+// 切换到模式0但不装入计数，计数器停止
+static void pit_shutdown() {
+    outb(PIT_COMMAND, 0x30);
+}
+
+// 向主8259发送EOI
+static void pit_ack() {
+    outb(0x20, 0x20);
+}
+
+static struct clock_event_device pit_device = {
+    .name = "pit",
+    .features = CLOCKEVENT_FEAT_PERIODIC | CLOCKEVENT_FEAT_ONESHOT,
+    .rating = 100,
+    .max_delta_ticks = 0xFFFF / PIT_COUNTS_PER_TICK,
+    .set_periodic = pit_set_periodic,
+    .set_oneshot = pit_set_oneshot,
+    .remaining = pit_remaining,
+    .shutdown = pit_shutdown,
+    .ack = pit_ack,
+};
+
+// ---------------- 本地APIC定时器 ----------------
+
+static volatile unsigned int* lapic_base = 0;
+
+// 每tick对应的APIC定时器计数（16分频后），由PIT校准得到
+static unsigned int lapic_counts_per_tick = 0;
+
+static inline unsigned int lapic_read(unsigned int reg) {
+    return lapic_base[reg / 4];
+}
+
+static inline void lapic_write(unsigned int reg, unsigned int value) {
+    lapic_base[reg / 4] = value;
+}
+
+static void lapic_set_periodic() {
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_VECTOR | LAPIC_TIMER_PERIODIC);
+    lapic_write(LAPIC_REG_TIMER_INIT, lapic_counts_per_tick);
+}
+
+static void lapic_set_oneshot(unsigned int ticks) {
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, ticks * lapic_counts_per_tick);
+}
+
+static unsigned int lapic_remaining() {
+    unsigned int count = lapic_read(LAPIC_REG_TIMER_CURRENT);
+    return count / lapic_counts_per_tick + (count % lapic_counts_per_tick != 0);
+}
+
+static void lapic_shutdown() {
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_MASKED);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+}
+
+static void lapic_ack() {
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+static struct clock_event_device lapic_device = {
+    .name = "lapic",
+    .features = CLOCKEVENT_FEAT_PERIODIC | CLOCKEVENT_FEAT_ONESHOT,
+    .rating = 200,
+    .max_delta_ticks = 0,
+    .set_periodic = lapic_set_periodic,
+    .set_oneshot = lapic_set_oneshot,
+    .remaining = lapic_remaining,
+    .shutdown = lapic_shutdown,
+    .ack = lapic_ack,
+};
+
+// 处理器是否有本地APIC（CPUID.1:EDX第9位）
+static int cpu_has_lapic() {
+    unsigned int eax = 1, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 9) & 1;
+}
+
+// 映射并启用本地APIC，用PIT通道2计时LAPIC_CALIBRATE_TICKS个tick来校准定时器频率
+static int lapic_timer_setup() {
+    if (!cpu_has_lapic()) {
+        return -1;
+    }
+    
+    // APIC基址来自IA32_APIC_BASE MSR
+    unsigned int low, high;
+    __asm__ volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(0x1B));
+    unsigned int base = low & 0xFFFFF000;
+    if (base == 0) {
+        base = LAPIC_DEFAULT_BASE;
+    }
+    
+    if (vm_map_page(vm_get_kernel_directory(), base, base, 0, 1) != 0) {
+        return -1;
+    }
+    lapic_base = (volatile unsigned int*)base;
+    
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_MASKED);
+    
+    // 通道2模式0，关闭扬声器，重新打开门控开始计数
+    unsigned int count = PIT_COUNTS_PER_TICK * LAPIC_CALIBRATE_TICKS;
+    unsigned char gate = inb(PIT_GATE_PORT) & ~0x03;
+    outb(PIT_GATE_PORT, gate);
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, (count >> 8) & 0xFF);
+    outb(PIT_GATE_PORT, gate | 0x01);
+    
+    lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+    while (!(inb(PIT_GATE_PORT) & 0x20)) {
+        // 等待通道2计数到0
+    }
+    unsigned int elapsed = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CURRENT);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+    outb(PIT_GATE_PORT, gate);
+    
+    lapic_counts_per_tick = elapsed / LAPIC_CALIBRATE_TICKS;
+    if (lapic_counts_per_tick == 0) {
+        return -1;
+    }
+    
+    lapic_device.max_delta_ticks = 0xFFFFFFFF / lapic_counts_per_tick;
+    return 0;
+}
+
+// 本地APIC是否已映射并启用（SMP启动需要）
+int lapic_available() {
+    return lapic_base != 0;
+}
+
+// 读写本地APIC寄存器（供SMP启动和处理器间中断使用）
+unsigned int lapic_read_register(unsigned int reg) {
+    return lapic_read(reg);
+}
+
+void lapic_write_register(unsigned int reg, unsigned int value) {
+    lapic_write(reg, value);
+}
+
+// ---------------- 通用层 ----------------
+
+// 初始化时钟事件：先使用PIT，能校准本地APIC定时器时换用它
+void clockevent_init() {
+    clock_jiffies = 0;
+    clock_device = 0;
+    idle_oneshot = 0;
+    idle_oneshot_fired = 0;
+    idle_programmed = 0;
+    
+    clock_stats.periodic_ticks = 0;
+    clock_stats.idle_entries = 0;
+    clock_stats.oneshot_fired = 0;
+    clock_stats.early_wakeups = 0;
+    clock_stats.ticks_skipped = 0;
+    clock_stats.clamped = 0;
+    
+    clockevent_register(&pit_device);
+    
+    if (lapic_timer_setup() == 0) {
+        clockevent_register(&lapic_device);
+    } else {
+        LOG_INFO("CLOCK", "Local APIC timer unavailable, using PIT");
+    }
+    
+    print_string("Clock events initialized (");
+    print_string((char*)clock_device->name);
+    print_string(")\n");
+}
+
+// AP上线时调用：启用该处理器自己的本地APIC，并以引导处理器校准的频率开始周期tick。
+// 各处理器的本地APIC定时器频率相同，AP不做无tick空闲
+int clockevent_ap_init() {
+    if (clock_device != &lapic_device) {
+        return -1;
+    }
+    
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_set_periodic();
+    return 0;
+}
+
+// 注册时钟事件设备，rating更高时取代当前设备；返回1表示设备被选用
+int clockevent_register(struct clock_event_device* dev) {
+    if (!dev || !(dev->features & CLOCKEVENT_FEAT_PERIODIC)) {
+        return 0;
+    }
+    
+    if (clock_device && clock_device->rating >= dev->rating) {
+        return 0;
+    }
+    
+    if (clock_device) {
+        clock_device->shutdown();
+    }
+    clock_device = dev;
+    dev->set_periodic();
+    return 1;
+}
+
+// 获取当前时钟事件设备
+struct clock_event_device* clockevent_get_device() {
+    return clock_device;
+}
+
+// 时钟中断处理（IRQ0或本地APIC定时器向量）
+void clockevent_interrupt() {
+    // AP的周期tick只用于唤醒停机的处理器，系统tick由引导处理器维护
+    if (smp_processor_id() != 0) {
+        clock_device->ack();
+        return;
+    }
+    
+    if (idle_oneshot) {
+        // 空闲期间经过的tick由clockevent_idle_exit统一补上
+        idle_oneshot_fired = 1;
+    } else {
+        clock_jiffies++;
+        clock_stats.periodic_ticks++;
+    }
+    
+    if (clock_device) {
+        clock_device->ack();
+    }
+}
+
+// 进入无tick空闲：停止周期tick，把下一次中断编程到最近的定时器截止时间。
+// 调用时中断应处于关闭状态；返回0表示已有定时器到期，不应停机等待
+int clockevent_idle_enter() {
+    if (!clock_device || !(clock_device->features & CLOCKEVENT_FEAT_ONESHOT)) {
+        return 1; // 周期tick照常运行
+    }
+    
+    unsigned int now = get_current_tick();
+    unsigned int next = timer_next_expiry();
+    unsigned int delta = clock_device->max_delta_ticks;
+    
+    if (next != TIMER_NO_DEADLINE) {
+        if ((int)(next - now) <= 0) {
+            return 0;
+        }
+        
+        // 超出设备上限时先睡到上限，醒来后再编程剩余部分
+        if (next - now > delta) {
+            clock_stats.clamped++;
+        } else {
+            delta = next - now;
+        }
+    }
+    
+    idle_programmed = delta;
+    idle_oneshot_fired = 0;
+    idle_oneshot = 1;
+    clock_stats.idle_entries++;
+    
+    clock_device->set_oneshot(delta);
+    return 1;
+}
+
+// 退出无tick空闲：根据one-shot是否到期（或剩余计数）补上经过的tick，恢复周期tick
+void clockevent_idle_exit() {
+    if (!idle_oneshot) {
+        return;
+    }
+    
+    __asm__ volatile ("cli");
+    
+    unsigned int elapsed;
+    if (idle_oneshot_fired) {
+        elapsed = idle_programmed;
+        clock_stats.oneshot_fired++;
+    } else {
+        // 被其他中断提前唤醒
+        unsigned int remaining = clock_device->remaining();
+        if (remaining > idle_programmed) {
+            remaining = idle_programmed;
+        }
+        elapsed = idle_programmed - remaining;
+        clock_stats.early_wakeups++;
+    }
+    
+    idle_oneshot = 0;
+    clock_jiffies += elapsed;
+    if (elapsed > 1) {
+        clock_stats.ticks_skipped += elapsed - 1;
+    }
+    
+    clock_device->set_periodic();
+    
+    __asm__ volatile ("sti");
+}
+
+// 获取当前tick计数（毫秒）。有TSC时由时钟源换算，各处理器读到的值一致，
+// 不受引导处理器无tick空闲期间jiffies暂停的影响；否则使用时钟中断维护的jiffies
+unsigned int get_current_tick() {
+    if (clocksource_tsc_available()) {
+        return (unsigned int)div_u64_u32(ktime_get_ns(), NSEC_PER_MSEC);
+    }
+    return clock_jiffies;
+}
+
+// 获取时钟事件统计信息
+struct clockevent_stats* clockevent_get_stats() {
+    return &clock_stats;
+}
+
+// 显示时钟事件统计信息
+void clockevent_print_stats() {
+    print_string("=== Clock Event Statistics ===\n");
+    
+    char stat_str[16];
+    
+    print_string("Device: ");
+    print_string(clock_device ? (char*)clock_device->name : "none");
+    print_string(", ticks: ");
+    int_to_string(clock_jiffies, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Periodic ticks: ");
+    int_to_string(clock_stats.periodic_ticks, stat_str);
+    print_string(stat_str);
+    print_string(", skipped while idle: ");
+    int_to_string(clock_stats.ticks_skipped, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Idle entries: ");
+    int_to_string(clock_stats.idle_entries, stat_str);
+    print_string(stat_str);
+    print_string(", one-shot wakeups: ");
+    int_to_string(clock_stats.oneshot_fired, stat_str);
+    print_string(stat_str);
+    print_string(", early wakeups: ");
+    int_to_string(clock_stats.early_wakeups, stat_str);
+    print_string(stat_str);
+    print_string(", clamped: ");
+    int_to_string(clock_stats.clamped, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+}
@@ -0,0 +1,81 @@
+#ifndef CLOCKEVENT_H
+#define CLOCKEVENT_H
+
+// 系统tick频率：1 tick = 1毫秒
+#define CLOCK_HZ 1000
+
+// PIT（8254）输入时钟频率和端口
+#define PIT_FREQUENCY    1193182
+#define PIT_CHANNEL0     0x40
+#define PIT_CHANNEL2     0x42
+#define PIT_COMMAND      0x43
+#define PIT_GATE_PORT    0x61
+#define PIT_COUNTS_PER_TICK ((PIT_FREQUENCY + CLOCK_HZ / 2) / CLOCK_HZ)
+
+// 时钟中断向量：PIT接在IRQ0（重映射后为32），本地APIC定时器使用独立的向量
+#define PIT_IRQ_VECTOR      32
+#define LAPIC_TIMER_VECTOR  0xF0
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+// 本地APIC寄存器（相对于APIC基址的偏移）
+#define LAPIC_DEFAULT_BASE  0xFEE00000
+#define LAPIC_REG_EOI       0x0B0
+#define LAPIC_REG_SVR       0x0F0
+#define LAPIC_REG_LVT_TIMER 0x320
+#define LAPIC_REG_TIMER_INIT    0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIVIDE  0x3E0
+#define LAPIC_SVR_ENABLE    0x100
+#define LAPIC_TIMER_PERIODIC 0x20000
+#define LAPIC_TIMER_MASKED   0x10000
+#define LAPIC_TIMER_DIVIDE_16 0x3
+
+// 校准本地APIC定时器时用PIT通道2计时的tick数
+#define LAPIC_CALIBRATE_TICKS 10
+
+// 时钟事件设备能力
+#define CLOCKEVENT_FEAT_PERIODIC 0x1
+#define CLOCKEVENT_FEAT_ONESHOT  0x2
+
+// 时钟事件设备：按tick编程的中断源，选择rating最高的设备作为系统时钟
+struct clock_event_device {
+    const char* name;
+    unsigned int features;
+    unsigned int rating;
+    unsigned int max_delta_ticks;           // one-shot模式最多可编程的tick数
+    void (*set_periodic)();                 // 每tick一次中断
+    void (*set_oneshot)(unsigned int ticks); // ticks个tick后中断一次
+    unsigned int (*remaining)();            // one-shot模式下距离中断剩余的tick数
+    void (*shutdown)();                     // 停止产生中断
+    void (*ack)();                          // 中断处理结束时的应答（EOI）
+};
+
+// 时钟事件统计结构
+struct clockevent_stats {
+    unsigned int periodic_ticks;            // 周期模式下的时钟中断次数
+    unsigned int idle_entries;              // 进入无tick空闲的次数
+    unsigned int oneshot_fired;             // one-shot到期唤醒的次数
+    unsigned int early_wakeups;             // 被其他中断提前唤醒的次数
+    unsigned int ticks_skipped;             // 空闲期间省去的周期性时钟中断数
+    unsigned int clamped;                   // 截止时间超出设备上限而分段编程的次数
+};
+
+// 函数声明
+void clockevent_init();
+int clockevent_ap_init();
+int clockevent_register(struct clock_event_device* dev);
+struct clock_event_device* clockevent_get_device();
+void clockevent_interrupt();
+int clockevent_idle_enter();
+void clockevent_idle_exit();
+struct clockevent_stats* clockevent_get_stats();
+void clockevent_print_stats();
+int lapic_available();
+unsigned int lapic_read_register(unsigned int reg);
+void lapic_write_register(unsigned int reg, unsigned int value);
+
+// 辅助函数
+unsigned int get_current_tick();
+void int_to_string(int value, char* str);
+
+#endif
@@ -0,0 +1,139 @@
+#include "clocksource.h"
+#include "clockevent.h"
+#include "kernel.h"
+
+// 统一时钟源：开机时用PIT校准TSC频率，之后所有时间都由TSC换算得到。
+// 没有TSC的处理器退化为使用tick计数（毫秒精度）
+static int tsc_available = 0;
+
+// TSC频率（kHz）
+static unsigned int tsc_khz = 0;
+
+// 周期转纳秒的乘数，见CLOCKSOURCE_SHIFT
+static unsigned int tsc_mult = 0;
+
+// 开机校准完成时的TSC值，ktime从这里开始计时
+static unsigned long long tsc_base = 0;
+
+// 处理器是否有TSC（CPUID.1:EDX第4位）
+static int cpu_has_tsc() {
+    unsigned int eax = 1, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 4) & 1;
+}
+
+// 用PIT通道2计时TSC_CALIBRATE_MS毫秒，返回这段时间内TSC增加的周期数
+static unsigned long long tsc_calibrate_cycles() {
+    unsigned int count = PIT_COUNTS_PER_TICK * TSC_CALIBRATE_MS;
+    
+    // 通道2模式0，关闭扬声器，重新打开门控开始计数
+    unsigned char gate = inb(PIT_GATE_PORT) & ~0x03;
+    outb(PIT_GATE_PORT, gate);
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, (count >> 8) & 0xFF);
+    outb(PIT_GATE_PORT, gate | 0x01);
+    
+    unsigned long long start = rdtsc();
+    while (!(inb(PIT_GATE_PORT) & 0x20)) {
+        // 等待通道2计数到0
+    }
+    unsigned long long end = rdtsc();
+    
+    outb(PIT_GATE_PORT, gate);
+    return end - start;
+}
+
+// 初始化时钟源：校准TSC并计算周期到纳秒的换算系数
+void clocksource_init() {
+    tsc_available = cpu_has_tsc();
+    if (!tsc_available) {
+        print_string("Clocksource: no TSC, using tick counter\n");
+        return;
+    }
+    
+    // 取三次校准中的最小值，减少校准期间被SMI等打断带来的偏差
+    unsigned long long cycles = tsc_calibrate_cycles();
+    for (int i = 0; i < 2; i++) {
+        unsigned long long sample = tsc_calibrate_cycles();
+        if (sample < cycles) {
+            cycles = sample;
+        }
+    }
+    
+    tsc_khz = (unsigned int)div_u64_u32(cycles, TSC_CALIBRATE_MS);
+    if (tsc_khz < 1000) {
+        // 低于1MHz的结果不可信（换算系数也会溢出）
+        tsc_available = 0;
+        print_string("Clocksource: TSC calibration failed, using tick counter\n");
+        return;
+    }
+    
+    tsc_mult = (unsigned int)div_u64_u32((unsigned long long)NSEC_PER_MSEC << CLOCKSOURCE_SHIFT, tsc_khz);
+    tsc_base = rdtsc();
+    
+    print_string("Clocksource: TSC at ");
+    char str[24];
+    long_long_to_string(tsc_khz / 1000, str);
+    print_string(str);
+    print_string(" MHz\n");
+}
+
+// 是否使用TSC作为时钟源
+int clocksource_tsc_available() {
+    return tsc_available;
+}
+
+// 读取周期计数，没有TSC时返回0
+unsigned long long clocksource_read_cycles() {
+    return tsc_available ? rdtsc() : 0;
+}
+
+// 周期数转纳秒：按32位拆分做乘法和移位，避免64位乘法溢出和64位除法
+unsigned long long clocksource_cycles_to_ns(unsigned long long cycles) {
+    if (!tsc_available) {
+        return 0;
+    }
+    
+    unsigned int high = (unsigned int)(cycles >> 32);
+    unsigned int low = (unsigned int)cycles;
+    
+    return (((unsigned long long)low * tsc_mult) >> CLOCKSOURCE_SHIFT) +
+           (((unsigned long long)high * tsc_mult) << (32 - CLOCKSOURCE_SHIFT));
+}
+
+// 时钟源频率（Hz），没有TSC时为0
+unsigned long long clocksource_get_frequency() {
+    return (unsigned long long)tsc_khz * 1000;
+}
+
+// 开机以来的纳秒数
+unsigned long long ktime_get_ns() {
+    if (!tsc_available) {
+        return (unsigned long long)get_current_tick() * NSEC_PER_MSEC;
+    }
+    return clocksource_cycles_to_ns(rdtsc() - tsc_base);
+}
+
+// 显示时钟源信息
+void clocksource_print_info() {
+    print_string("=== Clocksource ===\n");
+    
+    char str[24];
+    
+    print_string("Source: ");
+    print_string(tsc_available ? "tsc" : "tick");
+    print_string("\n");
+    
+    if (tsc_available) {
+        print_string("TSC frequency: ");
+        long_long_to_string(tsc_khz, str);
+        print_string(str);
+        print_string(" kHz\n");
+    }
+    
+    print_string("Uptime: ");
+    long_long_to_string(div_u64_u32(ktime_get_ns(), NSEC_PER_MSEC), str);
+    print_string(str);
+    print_string(" ms\n");
+}
@@ -0,0 +1,46 @@
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+// 校准TSC时用PIT通道2计时的毫秒数（PIT计数寄存器为16位，最长约54ms）
+#define TSC_CALIBRATE_MS 50
+
+// 周期转纳秒的定点移位：ns = (cycles * mult) >> CLOCKSOURCE_SHIFT
+#define CLOCKSOURCE_SHIFT 22
+
+#define NSEC_PER_USEC 1000
+#define NSEC_PER_MSEC 1000000
+
+// 函数声明
+void clocksource_init();
+int clocksource_tsc_available();
+unsigned long long clocksource_read_cycles();
+unsigned long long clocksource_cycles_to_ns(unsigned long long cycles);
+unsigned long long clocksource_get_frequency();
+unsigned long long ktime_get_ns();
+void clocksource_print_info();
+
+// 辅助函数
+unsigned int get_current_tick();
+void long_long_to_string(unsigned long long value, char* str);
+
+// 读取时间戳计数器
+static inline unsigned long long rdtsc() {
+    unsigned int low, high;
+    __asm__ volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return ((unsigned long long)high << 32) | low;
+}
+
+// 64位除以32位（内核不链接libgcc，不能直接对64位整数做除法）
+static inline unsigned long long div_u64_u32(unsigned long long dividend, unsigned int divisor) {
+    unsigned int high = (unsigned int)(dividend >> 32);
+    unsigned int low = (unsigned int)dividend;
+    unsigned int quotient_high = high / divisor;
+    unsigned int remainder = high % divisor;
+    unsigned int quotient_low;
+    
+    // remainder < divisor，(remainder:low) / divisor的商一定能放入32位
+    __asm__ ("divl %4" : "=a"(quotient_low), "=d"(remainder) : "a"(low), "d"(remainder), "rm"(divisor));
+    return ((unsigned long long)quotient_high << 32) | quotient_low;
+}
+
+#endif
@@ -23,7 +23,8 @@ static const struct system_config default_config = {
     .enable_audit = 1,
     .enable_profiling = 1,
     .hostname = "lightweightos",
-    .timezone = 0
+    .timezone = 0,
+    .zero_pool_watermark = 64
 };
 
 // 初始化配置系统
@@ -114,6 +115,10 @@ int config_get_timezone() {
     return global_config.timezone;
 }
 
+unsigned int config_get_zero_pool_watermark() {
+    return global_config.zero_pool_watermark;
+}
+
 // 设置特定配置项
 int config_set_max_processes(int max_processes) {
     if (max_processes <= 0 || max_processes > 1024) {
@@ -211,6 +216,11 @@ void config_print() {
     int_to_string(global_config.timezone, buffer);
     print_string(buffer);
     print_string("\n");
+    
+    print_string("Zeroed Frame Pool Watermark: ");
+    int_to_string(global_config.zero_pool_watermark, buffer);
+    print_string(buffer);
+    print_string(" frames\n");
 }
 
 // 重置为默认配置
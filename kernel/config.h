@@ -15,6 +15,7 @@ struct system_config {
     int enable_profiling;           // 是否启用性能分析
     char hostname[64];              // 主机名
     int timezone;                   // 时区（相对于UTC的小时数）
+    unsigned int zero_pool_watermark; // 空闲时预先清零备用的页帧数
 };
 
 // 函数声明
@@ -32,6 +33,7 @@ int config_get_scheduler_time_slice();
 unsigned int config_get_memory_pool_size();
 const char* config_get_hostname();
 int config_get_timezone();
+unsigned int config_get_zero_pool_watermark();
 
 // 设置特定配置项
 int config_set_max_processes(int max_processes);
@@ -0,0 +1,337 @@
+#include "context.h"
+#include "kernel.h"
+#include "memory.h"
+#include "process.h"
+#include "scheduler.h"
+#include "smp.h"
+#include "logger.h"
+
+// 上下文切换：每个进程有独立的内核栈，切换时只在当前栈上压入被调用者保存的寄存器
+// （ebp、ebx、esi、edi，其余寄存器按调用约定已由调用者保存），然后交换栈指针并在目标栈上弹出。
+// 新进程的内核栈预先构造成同样的布局，返回地址指向context_trampoline，由它调用入口函数；
+// fork的子进程则指向context_fork_return，从进程栈上系统调用陷阱帧的副本返回。
+__asm__ (
+    ".text\n"
+    ".globl context_switch\n"
+    "context_switch:\n"
+    "    movl 4(%esp), %eax\n"          // old_esp
+    "    movl 8(%esp), %edx\n"          // new_esp
+    "    pushl %ebp\n"
+    "    pushl %ebx\n"
+    "    pushl %esi\n"
+    "    pushl %edi\n"
+    "    movl %esp, (%eax)\n"
+    "    movl %edx, %esp\n"
+    "    popl %edi\n"
+    "    popl %esi\n"
+    "    popl %ebx\n"
+    "    popl %ebp\n"
+    "    ret\n"
+    "\n"
+    // 新进程第一次被切换到时从这里开始执行，ebx中是入口函数，esi中是进程栈顶（0表示留在内核栈上）
+    "context_trampoline:\n"
+    "    testl %esi, %esi\n"
+    "    jz 1f\n"
+    "    movl %esi, %esp\n"
+    "1:  call *%ebx\n"
+    "    call context_exit_current\n"
+    "2:  hlt\n"
+    "    jmp 2b\n"
+    "\n"
+    // fork的子进程第一次被切换到时从这里开始执行，ebx指向进程栈上的陷阱帧（父进程陷阱帧的副本），
+    // 把其中的eax清零作为子进程fork的返回值
+    "context_fork_return:\n"
+    "    movl %ebx, %esp\n"
+    "    movl $0, 28(%esp)\n"
+    "    jmp syscall_return\n"
+);
+
+extern void context_trampoline();
+extern void context_fork_return();
+
+// 每个处理器上当前运行的进程，0表示该处理器的引导上下文（调度循环）
+static struct process* context_current[MAX_CPUS];
+
+// 各处理器的引导上下文被切换出去时保存的栈指针
+static unsigned int boot_esp[MAX_CPUS];
+
+// 各处理器FPU寄存器中保存的是哪个进程的状态，0表示寄存器内容无人拥有、可以直接覆盖；
+// 只有进程的fpu_cpu也指向该处理器时寄存器内容才是它的最新状态
+static struct process* fpu_owner[MAX_CPUS];
+
+// 处理器支持FXSAVE且已开启延迟FPU切换
+static int fpu_lazy_enabled = 0;
+
+// 上下文切换统计
+static struct context_stats ctx_stats;
+
+// 读写控制寄存器
+static inline unsigned int read_cr0() {
+    unsigned int value;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(unsigned int value) {
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(value));
+}
+
+// 置位CR0.TS，下一条FPU/SSE指令将触发设备不可用异常
+static inline void fpu_set_ts() {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+// 清除CR0.TS
+static inline void fpu_clear_ts() {
+    __asm__ volatile ("clts");
+}
+
+// 处理器是否支持FXSAVE/FXRSTOR（CPUID.1:EDX第24位）
+static int cpu_has_fxsr() {
+    unsigned int eax = 1, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 24) & 1;
+}
+
+// 开启FPU（清除EM，设置MP）和SSE（OSFXSR），然后置位TS：任何进程首次使用FPU时才分配状态
+static void context_fpu_setup() {
+    unsigned int cr4;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(cr4));
+    
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP);
+    __asm__ volatile ("fninit");
+    fpu_set_ts();
+}
+
+// 初始化上下文切换和延迟FPU切换
+void context_init() {
+    for (int i = 0; i < MAX_CPUS; i++) {
+        context_current[i] = 0;
+        boot_esp[i] = 0;
+        fpu_owner[i] = 0;
+    }
+    
+    ctx_stats.switches = 0;
+    ctx_stats.fpu_traps = 0;
+    ctx_stats.fpu_saves = 0;
+    ctx_stats.fpu_restores = 0;
+    ctx_stats.fpu_inits = 0;
+    ctx_stats.fpu_switches_avoided = 0;
+    
+    fpu_lazy_enabled = cpu_has_fxsr();
+    if (!fpu_lazy_enabled) {
+        LOG_WARNING("CONTEXT", "FXSR not supported, lazy FPU switching disabled");
+        print_string("Context switching initialized\n");
+        return;
+    }
+    
+    context_fpu_setup();
+    
+    print_string("Context switching initialized (lazy FPU)\n");
+}
+
+// AP上线时按引导处理器的设置配置本处理器的FPU
+void context_ap_init() {
+    if (fpu_lazy_enabled) {
+        context_fpu_setup();
+    }
+}
+
+// 为进程分配内核栈并构造初始栈帧：第一次切换到该进程时从start返回，ebx、esi为传给它的值
+static int context_build(struct process* proc, void (*start)(), unsigned int ebx, unsigned int esi) {
+    unsigned char* stack = (unsigned char*)allocate_memory(KERNEL_STACK_SIZE);
+    if (!stack) {
+        return -1;
+    }
+    
+    // 与context_switch保存的布局一致：edi、esi、ebx、ebp、返回地址（由低到高）
+    unsigned int* sp = (unsigned int*)(stack + KERNEL_STACK_SIZE);
+    *--sp = 0;                                  // 栈底占位，栈回溯在此终止
+    *--sp = (unsigned int)start;                // context_switch的ret目标
+    *--sp = 0;                                  // ebp
+    *--sp = ebx;                                // ebx
+    *--sp = esi;                                // esi
+    *--sp = 0;                                  // edi
+    
+    proc->kernel_stack = stack;
+    proc->kernel_esp = (unsigned int)sp;
+    proc->fpu_used = 0;
+    proc->fpu_cpu = -1;
+    return 0;
+}
+
+// 为进程分配内核栈，第一次切换到该进程时从entry_point开始执行：
+// 有进程栈（stack_pointer非0）时在进程栈上执行，否则直接在内核栈上执行
+int context_create(struct process* proc, void (*entry_point)()) {
+    return context_build(proc, context_trampoline, (unsigned int)entry_point, proc->stack_pointer);
+}
+
+// 为fork的子进程分配内核栈，第一次切换到它时从进程栈上陷阱帧regs的副本返回，fork返回值为0。
+// FPU从干净的状态开始
+int context_fork(struct process* proc, struct interrupt_registers* regs) {
+    return context_build(proc, context_fork_return, (unsigned int)regs, 0);
+}
+
+// 系统调用入口在进程栈上保存陷阱帧frame后要切换到的栈：当前进程内核栈的栈顶。
+// 已经在内核栈上（或当前是引导上下文）时返回0，留在当前栈上
+unsigned int context_syscall_stack(unsigned int frame) {
+    struct process* proc = context_current[smp_processor_id()];
+    if (!proc || !proc->kernel_stack) {
+        return 0;
+    }
+    
+    unsigned int base = (unsigned int)proc->kernel_stack;
+    if (frame >= base && frame < base + KERNEL_STACK_SIZE) {
+        return 0;
+    }
+    return base + KERNEL_STACK_SIZE;
+}
+
+// 释放进程的内核栈和FPU状态，不能对正在运行的进程调用
+void context_destroy(struct process* proc) {
+    for (int i = 0; i < MAX_CPUS; i++) {
+        if (fpu_owner[i] == proc) {
+            fpu_owner[i] = 0;
+        }
+    }
+    
+    if (proc->kernel_stack) {
+        free_memory(proc->kernel_stack);
+        proc->kernel_stack = 0;
+    }
+    proc->kernel_esp = 0;
+    proc->fpu_used = 0;
+}
+
+// 从当前上下文切换到next（0表示引导上下文），在有人切换回当前上下文时返回
+void context_switch_to(struct process* next) {
+    unsigned int cpu = smp_processor_id();
+    struct process* prev = context_current[cpu];
+    if (prev == next) {
+        return;
+    }
+    
+    unsigned int* save_esp = prev ? &prev->kernel_esp : &boot_esp[cpu];
+    unsigned int next_esp = next ? next->kernel_esp : boot_esp[cpu];
+    
+    // FPU状态的恢复是延迟的：切回FPU寄存器中状态的所有者时直接清除TS，否则置位TS，
+    // 等目标进程真正使用FPU时再在设备不可用异常中恢复。
+    // 单处理器时保存也是延迟的；多处理器时进程可能在其他处理器上继续运行，
+    // 本时间片用过FPU（TS已清除）的所有者被切换出去时立即把状态写回内存
+    if (fpu_lazy_enabled) {
+        if (prev && prev == fpu_owner[cpu] && smp_num_cpus() > 1 && !(read_cr0() & CR0_TS)) {
+            __asm__ volatile ("fxsave %0" : "=m"(prev->fpu_state));
+            ctx_stats.fpu_saves++;
+        }
+        
+        if (next && next == fpu_owner[cpu] && next->fpu_cpu == (int)cpu) {
+            fpu_clear_ts();
+            ctx_stats.fpu_switches_avoided++;
+        } else {
+            fpu_set_ts();
+        }
+    }
+    
+    context_current[cpu] = next;
+    ctx_stats.switches++;
+    context_switch(save_esp, next_esp);
+}
+
+// 当前运行的进程，0表示引导上下文
+struct process* context_get_current() {
+    return context_current[smp_processor_id()];
+}
+
+// 进程入口函数返回：放入终止队列并回到引导上下文，不再返回；资源在调度循环中由process_reap回收
+void context_exit_current() {
+    unsigned int cpu = smp_processor_id();
+    struct process* proc = context_current[cpu];
+    if (proc) {
+        scheduler_add_to_terminated(proc);
+        if (fpu_owner[cpu] == proc) {
+            fpu_owner[cpu] = 0;
+        }
+    }
+    
+    context_switch_to(0);
+}
+
+// 设备不可用异常（#NM）：当前上下文首次使用FPU，保存上一个所有者的状态并载入当前进程的状态
+int context_handle_fpu_trap() {
+    if (!fpu_lazy_enabled) {
+        return -1;
+    }
+    
+    unsigned int cpu = smp_processor_id();
+    struct process* current = context_current[cpu];
+    struct process* owner = fpu_owner[cpu];
+    
+    fpu_clear_ts();
+    ctx_stats.fpu_traps++;
+    
+    if (current && owner == current && current->fpu_cpu == (int)cpu) {
+        return 0;
+    }
+    
+    // 多处理器时所有者在切换出去时已经保存过；所有者的状态已在其他处理器上更新时寄存器内容作废
+    if (owner && smp_num_cpus() == 1) {
+        __asm__ volatile ("fxsave %0" : "=m"(owner->fpu_state));
+        ctx_stats.fpu_saves++;
+    }
+    
+    if (current && current->fpu_used) {
+        __asm__ volatile ("fxrstor %0" : : "m"(current->fpu_state));
+        ctx_stats.fpu_restores++;
+    } else {
+        // 首次使用FPU（或引导上下文使用FPU）从干净的状态开始
+        __asm__ volatile ("fninit");
+        if (current) {
+            current->fpu_used = 1;
+            ctx_stats.fpu_inits++;
+        }
+    }
+    
+    if (current) {
+        current->fpu_cpu = (int)cpu;
+    }
+    fpu_owner[cpu] = current;
+    return 0;
+}
+
+// 获取上下文切换统计信息
+struct context_stats* context_get_stats() {
+    return &ctx_stats;
+}
+
+// 显示上下文切换统计信息
+void context_print_stats() {
+    print_string("=== Context Switch Statistics ===\n");
+    
+    char stat_str[16];
+    
+    print_string("Context switches: ");
+    int_to_string(ctx_stats.switches, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("FPU traps: ");
+    int_to_string(ctx_stats.fpu_traps, stat_str);
+    print_string(stat_str);
+    print_string(", saves: ");
+    int_to_string(ctx_stats.fpu_saves, stat_str);
+    print_string(stat_str);
+    print_string(", restores: ");
+    int_to_string(ctx_stats.fpu_restores, stat_str);
+    print_string(stat_str);
+    print_string(", inits: ");
+    int_to_string(ctx_stats.fpu_inits, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("FPU switches avoided: ");
+    int_to_string(ctx_stats.fpu_switches_avoided, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+}
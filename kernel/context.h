@@ -0,0 +1,50 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+// 每个进程的内核栈大小
+#define KERNEL_STACK_SIZE 8192
+
+// FXSAVE区域大小（要求16字节对齐）
+#define FPU_STATE_SIZE 512
+
+// CR0/CR4中与FPU相关的位
+#define CR0_MP         0x00000002   // 监视协处理器，配合TS使WAIT/FWAIT也触发#NM
+#define CR0_EM         0x00000004   // 模拟协处理器，必须清除才能使用FPU/SSE
+#define CR0_TS         0x00000008   // 任务已切换，置位时首次FPU/SSE指令触发#NM
+#define CR4_OSFXSR     0x00000200   // 操作系统支持FXSAVE/FXRSTOR
+#define CR4_OSXMMEXCPT 0x00000400   // 操作系统处理SIMD浮点异常
+
+struct process;
+struct interrupt_registers;
+
+// 上下文切换统计结构
+struct context_stats {
+    unsigned int switches;          // 实际切换内核栈的次数
+    unsigned int fpu_traps;         // 设备不可用异常（延迟恢复FPU）次数
+    unsigned int fpu_saves;         // 保存FPU状态（FXSAVE）次数
+    unsigned int fpu_restores;      // 恢复FPU状态（FXRSTOR）次数
+    unsigned int fpu_inits;         // 首次使用FPU而初始化的次数
+    unsigned int fpu_switches_avoided; // 切回FPU状态仍在寄存器中的进程、无需陷入的次数
+};
+
+// 函数声明
+void context_init();
+void context_ap_init();
+int context_create(struct process* proc, void (*entry_point)());
+int context_fork(struct process* proc, struct interrupt_registers* regs);
+unsigned int context_syscall_stack(unsigned int frame);
+void context_destroy(struct process* proc);
+void context_switch_to(struct process* next);
+struct process* context_get_current();
+void context_exit_current();
+int context_handle_fpu_trap();
+struct context_stats* context_get_stats();
+void context_print_stats();
+
+// 汇编实现：保存被调用者保存的寄存器并把栈指针存入*old_esp，切换到new_esp后恢复寄存器并返回
+void context_switch(unsigned int* old_esp, unsigned int new_esp);
+
+// 辅助函数
+void int_to_string(int value, char* str);
+
+#endif
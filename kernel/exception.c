@@ -2,7 +2,9 @@
 #include "kernel.h"
 #include "logger.h"
 #include "process.h"
+#include "context.h"
 #include "profiling.h"
+#include "vm.h"
 
 // 异常处理表
 static exception_handler_t exception_handlers[32];
@@ -238,6 +240,11 @@ void invalid_opcode_handler(int exception_num, unsigned int error_code, unsigned
 }
 
 void device_not_available_handler(int exception_num, unsigned int error_code, unsigned int eip) {
+    // CR0.TS置位后首次使用FPU/SSE：延迟切换FPU状态
+    if (context_handle_fpu_trap() == 0) {
+        return;
+    }
+    
     print_string("Device not available exception\n");
     LOG_WARNING("EXCEPTION", "Device not available");
 }
@@ -288,6 +295,11 @@ void page_fault_handler(int exception_num, unsigned int error_code, unsigned int
     unsigned int faulting_address;
     __asm__ volatile ("mov %%cr2, %0" : "=r"(faulting_address));
     
+    // 按需分配等可恢复的页错误由虚拟内存管理处理
+    if (vm_handle_page_fault(faulting_address, error_code) == 0) {
+        return;
+    }
+    
     print_string("Page fault at 0x");
     char addr_str[16];
     hex_to_string(faulting_address, addr_str);
@@ -0,0 +1,161 @@
+#include "futex.h"
+#include "kernel.h"
+#include "process.h"
+#include "context.h"
+#include "logger.h"
+
+// futex的键：私有地址以（地址空间，用户地址）标识；共享内存页中的地址以物理地址标识（space为0），
+// 映射同一段共享内存的进程即使映射地址不同也得到相同的键
+struct futex_key {
+    page_directory_t* space;
+    unsigned int address;
+};
+
+// 在futex上阻塞的等待者，放在等待进程的内核栈上
+struct futex_waiter {
+    struct wait_queue_entry entry;
+    struct futex_key key;
+};
+
+// 散列桶：键不同的等待者可能落在同一个桶中，唤醒时按键过滤
+static struct wait_queue futex_queues[FUTEX_HASH_SIZE];
+
+// futex统计
+static struct futex_stats futex_statistics;
+
+// 求当前地址空间中uaddr的键
+static void futex_get_key(volatile unsigned int* uaddr, struct futex_key* key) {
+    page_directory_t* page_dir = vm_get_current_directory();
+    unsigned int physical = vm_shared_physical_address(page_dir, (unsigned int)uaddr);
+    if (physical) {
+        key->space = 0;
+        key->address = physical;
+    } else {
+        key->space = page_dir;
+        key->address = (unsigned int)uaddr;
+    }
+}
+
+static inline int futex_key_equal(const struct futex_key* a, const struct futex_key* b) {
+    return a->space == b->space && a->address == b->address;
+}
+
+// 由键得到散列桶：地址低2位恒为0，先去掉再与页目录地址混合
+static struct wait_queue* futex_bucket(const struct futex_key* key) {
+    unsigned int hash = (key->address >> 2) ^ ((unsigned int)key->space >> 12);
+    hash ^= hash >> 6;
+    return &futex_queues[hash & (FUTEX_HASH_SIZE - 1)];
+}
+
+static inline struct futex_waiter* futex_entry(struct wait_queue_entry* entry) {
+    return (struct futex_waiter*)((char*)entry - __builtin_offsetof(struct futex_waiter, entry));
+}
+
+// 地址必须非空且按4字节对齐，原子指令和比较都以整个字为单位
+static inline int futex_addr_valid(volatile unsigned int* uaddr) {
+    return uaddr && ((unsigned int)uaddr & 3) == 0;
+}
+
+// 初始化futex散列表
+void futex_init() {
+    for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+        wait_queue_init(&futex_queues[i]);
+    }
+    
+    futex_statistics.waits = 0;
+    futex_statistics.wakeups = 0;
+    futex_statistics.mismatches = 0;
+    futex_statistics.timeouts = 0;
+    
+    print_string("Futex initialized\n");
+}
+
+// *uaddr等于val时阻塞，直到futex_wake唤醒或超时（timeout为tick数，0表示一直等待）。
+// 比较和进入等待都在桶锁内完成，唤醒方修改值后必须拿到同一把锁，因此不会丢失唤醒
+int futex_wait(volatile unsigned int* uaddr, unsigned int val, unsigned int timeout) {
+    if (!futex_addr_valid(uaddr)) {
+        return FUTEX_EINVAL;
+    }
+    
+    struct futex_waiter waiter;
+    futex_get_key(uaddr, &waiter.key);
+    struct wait_queue* wq = futex_bucket(&waiter.key);
+    
+    spin_lock(&wq->lock);
+    if (*uaddr != val) {
+        spin_unlock(&wq->lock);
+        __sync_fetch_and_add(&futex_statistics.mismatches, 1);
+        return FUTEX_EAGAIN;
+    }
+    
+    // 没有进程上下文时不能阻塞，调用者重试（退化为自旋等待）
+    if (!context_get_current()) {
+        spin_unlock(&wq->lock);
+        return FUTEX_EAGAIN;
+    }
+    
+    __sync_fetch_and_add(&futex_statistics.waits, 1);
+    if (wait_queue_sleep(wq, &waiter.entry, timeout) != WAIT_WOKEN) {
+        __sync_fetch_and_add(&futex_statistics.timeouts, 1);
+        return FUTEX_ETIMEDOUT;
+    }
+    return FUTEX_OK;
+}
+
+// 按到达顺序唤醒最多nr个在uaddr上等待的进程，返回唤醒的个数
+int futex_wake(volatile unsigned int* uaddr, unsigned int nr) {
+    if (!futex_addr_valid(uaddr)) {
+        return FUTEX_EINVAL;
+    }
+    
+    struct futex_key key;
+    futex_get_key(uaddr, &key);
+    struct wait_queue* wq = futex_bucket(&key);
+    unsigned int woken = 0;
+    
+    spin_lock(&wq->lock);
+    struct wait_queue_entry* entry = wq->head;
+    while (entry && woken < nr) {
+        struct wait_queue_entry* next = entry->next;
+        struct futex_waiter* waiter = futex_entry(entry);
+        if (futex_key_equal(&waiter->key, &key)) {
+            wait_queue_wake_entry(wq, entry);
+            woken++;
+        }
+        entry = next;
+    }
+    spin_unlock(&wq->lock);
+    
+    if (woken) {
+        __sync_fetch_and_add(&futex_statistics.wakeups, woken);
+    }
+    return (int)woken;
+}
+
+// 获取futex统计信息
+struct futex_stats* futex_get_stats() {
+    return &futex_statistics;
+}
+
+// 显示futex统计信息
+void futex_print_stats() {
+    print_string("=== Futex Statistics ===\n");
+    
+    char stat_str[16];
+    
+    print_string("Waits: ");
+    int_to_string(futex_statistics.waits, stat_str);
+    print_string(stat_str);
+    print_string(", wakeups: ");
+    int_to_string(futex_statistics.wakeups, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Value mismatches: ");
+    int_to_string(futex_statistics.mismatches, stat_str);
+    print_string(stat_str);
+    print_string(", timeouts: ");
+    int_to_string(futex_statistics.timeouts, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+}
@@ -0,0 +1,39 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "vm.h"
+#include "waitqueue.h"
+
+// 快速用户态互斥（futex）：同步变量放在用户内存中，无竞争时用户态只用原子指令操作它，
+// 只有需要阻塞或唤醒时才进入内核。等待者按键挂在散列桶的等待队列上：私有地址的键为（地址空间，用户地址），
+// 共享内存页中的地址以物理地址为键，因此可以跨进程同步
+
+// 操作（SYSCALL_FUTEX的op参数）
+#define FUTEX_WAIT 0   // *uaddr仍等于val时阻塞
+#define FUTEX_WAKE 1   // 唤醒最多val个在uaddr上等待的进程
+
+// 散列桶数（2的幂）
+#define FUTEX_HASH_SIZE 64
+
+// 返回值
+#define FUTEX_OK         0
+#define FUTEX_EINVAL    -1   // 地址无效（空指针或未按4字节对齐）或操作未知
+#define FUTEX_EAGAIN    -2   // *uaddr已不等于val，或当前不在进程上下文中不能阻塞
+#define FUTEX_ETIMEDOUT -3   // 等待超时
+
+// futex统计结构
+struct futex_stats {
+    unsigned int waits;         // 进入阻塞的次数
+    unsigned int wakeups;       // 被唤醒的等待者数
+    unsigned int mismatches;    // 值已改变、不需要阻塞的次数
+    unsigned int timeouts;      // 等待超时的次数
+};
+
+// 函数声明
+void futex_init();
+int futex_wait(volatile unsigned int* uaddr, unsigned int val, unsigned int timeout);
+int futex_wake(volatile unsigned int* uaddr, unsigned int nr);
+struct futex_stats* futex_get_stats();
+void futex_print_stats();
+
+#endif
@@ -1,11 +1,43 @@
 #include "kernel.h"
 #include "interrupts.h"
 #include "logger.h"
+#include "clockevent.h"
+#include "smp.h"
+#include "process.h"
+#include "syscall.h"
 #include "../libs/stdlib.h"
 
 // 中断处理程序数组
 static interrupt_handler_t interrupt_handlers[256];
 
+// 系统调用入口（int 0x80）：所有代码都在内核态运行，处理器不切换栈，只在当前栈（进程栈）上压入
+// eflags、cs、eip。在同一个栈上补全陷阱帧，然后切换到当前进程的内核栈执行处理程序（栈上的等待队列项
+// 等对象会被其他地址空间访问，不能留在进程栈上），返回时切回进程栈。陷阱帧留在进程栈上，
+// fork复制进程栈后子进程从陷阱帧的副本返回
+__asm__ (
+    ".text\n"
+    ".globl isr128\n"
+    "isr128:\n"
+    "    pushl $0\n"                    // 错误码
+    "    pushl $0x80\n"                 // 中断号
+    "    pushal\n"
+    "    movl %esp, %ebx\n"             // 陷阱帧，ebx在C函数调用中保持不变
+    "    pushl %ebx\n"
+    "    call context_syscall_stack\n"
+    "    addl $4, %esp\n"
+    "    testl %eax, %eax\n"
+    "    jz 1f\n"
+    "    movl %eax, %esp\n"
+    "1:  pushl %ebx\n"
+    "    call interrupt_handler\n"
+    "    movl %ebx, %esp\n"
+    ".globl syscall_return\n"
+    "syscall_return:\n"
+    "    popal\n"
+    "    addl $8, %esp\n"
+    "    iret\n"
+);
+
 // 初始化中断处理
 void initialize_interrupts() {
     // 初始化中断处理程序数组
@@ -35,6 +67,19 @@ void initialize_interrupts() {
     register_interrupt_handler(20, virtualization_exception_handler);
     register_interrupt_handler(30, security_exception_handler);
     
+    // 时钟中断：PIT（IRQ0）和本地APIC定时器共用同一个处理程序
+    register_interrupt_handler(PIT_IRQ_VECTOR, clock_interrupt_handler);
+    register_interrupt_handler(LAPIC_TIMER_VECTOR, clock_interrupt_handler);
+    
+    // 调度IPI：唤醒空闲的处理器
+    register_interrupt_handler(SMP_RESCHEDULE_VECTOR, reschedule_interrupt_handler);
+    
+    // TLB shootdown IPI：其他处理器修改了本处理器可能缓存的映射
+    register_interrupt_handler(SMP_TLB_SHOOTDOWN_VECTOR, tlb_shootdown_interrupt_handler);
+    
+    // 系统调用
+    register_interrupt_handler(SYSCALL_VECTOR, system_call_interrupt_handler);
+    
     LOG_INFO("INTERRUPTS", "Interrupt handling initialized");
 }
 
@@ -69,6 +114,38 @@ void divide_by_zero_handler(struct interrupt_registers* regs) {
     // 在实际系统中，这里应该终止导致错误的进程
 }
 
+// 时钟中断处理程序
+void clock_interrupt_handler(struct interrupt_registers* regs) {
+    clockevent_interrupt();
+}
+
+// 调度IPI处理程序
+void reschedule_interrupt_handler(struct interrupt_registers* regs) {
+    smp_reschedule_interrupt();
+}
+
+// TLB shootdown IPI处理程序
+void tlb_shootdown_interrupt_handler(struct interrupt_registers* regs) {
+    smp_tlb_shootdown_interrupt();
+}
+
+// 系统调用处理程序：eax为调用号，ebx、ecx、edx为参数。处理期间把陷阱帧记在当前进程中，
+// fork据此构造子进程并把返回值写回陷阱帧中的eax
+void system_call_interrupt_handler(struct interrupt_registers* regs) {
+    struct process* proc = get_current_process();
+    struct interrupt_registers* outer = 0;
+    if (proc) {
+        outer = proc->syscall_regs;
+        proc->syscall_regs = regs;
+    }
+    
+    syscall_handler((int)regs->eax, regs->ebx, regs->ecx, regs->edx);
+    
+    if (proc) {
+        proc->syscall_regs = outer;
+    }
+}
+
 // ISR处理函数实现（汇编）
 // 注意：这些函数需要在单独的汇编文件中实现
 // 为简洁起见，这里只提供注释说明
@@ -16,12 +16,35 @@ struct idt_ptr {
     unsigned int base;
 } __attribute__((packed));
 
+// 系统调用中断向量
+#define SYSCALL_VECTOR 0x80
+
+// 中断入口保存的寄存器（陷阱帧），由低地址到高地址：pushal保存的通用寄存器、中断号和错误码、
+// 处理器压入的eip、cs、eflags（所有代码都在内核态运行，处理器不压入esp和ss）
+struct interrupt_registers {
+    unsigned int edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    unsigned int int_no, err_code;
+    unsigned int eip, cs, eflags;
+};
+
 // 函数声明
 void initialize_interrupts();
 void handle_pending_interrupts();
 void idt_set_gate(unsigned char num, unsigned long base, unsigned short sel, unsigned char flags);
 void install_isr_handlers();
 
+// 时钟中断处理程序（PIT的IRQ0和本地APIC定时器）
+void clock_interrupt_handler(struct interrupt_registers* regs);
+
+// 调度IPI处理程序（唤醒空闲的处理器）
+void reschedule_interrupt_handler(struct interrupt_registers* regs);
+
+// TLB shootdown IPI处理程序
+void tlb_shootdown_interrupt_handler(struct interrupt_registers* regs);
+
+// 系统调用处理程序（int 0x80）
+void system_call_interrupt_handler(struct interrupt_registers* regs);
+
 // ISR处理函数声明
 extern void isr0();
 extern void isr1();
@@ -56,4 +79,8 @@ extern void isr29();
 extern void isr30();
 extern void isr31();
 
+// 系统调用入口，以及从进程栈上的陷阱帧返回的出口
+extern void isr128();
+extern void syscall_return();
+
 #endif
\ No newline at end of file
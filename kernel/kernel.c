@@ -6,6 +6,13 @@
 #include "profiling.h"
 #include "security.h"
 #include "vm.h"
+#include "shm.h"
+#include "futex.h"
+#include "timer.h"
+#include "clockevent.h"
+#include "clocksource.h"
+#include "context.h"
+#include "smp.h"
 #include "scheduler.h"
 #include "logger.h"
 #include "config.h"
@@ -23,6 +30,12 @@ void kernel_main() {
     initialize_screen();
     print_string("LightweightOS Kernel Loading...\n");
     
+    // 校准TSC时钟源，之后日志、性能分析和调度器的时间戳都来自它
+    clocksource_init();
+    
+    // 装入内核GDT并设置每CPU数据，之后各模块可以使用smp_processor_id()
+    smp_early_init();
+    
     // 初始化日志系统
     logger_init();
     LOG_INFO("KERNEL", "Logger subsystem initialized");
@@ -51,10 +64,30 @@ void kernel_main() {
     vm_init();
     LOG_INFO("KERNEL", "Virtual memory management initialized");
     
+    // 初始化共享内存
+    shm_init();
+    LOG_INFO("KERNEL", "Shared memory IPC initialized");
+    
+    // 初始化futex等待队列
+    futex_init();
+    LOG_INFO("KERNEL", "Futex initialized");
+    
     // 初始化中断处理
     initialize_interrupts();
     LOG_INFO("KERNEL", "Interrupt handling initialized");
     
+    // 初始化定时器（睡眠和TCP超时共用）
+    timer_init();
+    LOG_INFO("KERNEL", "Timer subsystem initialized");
+    
+    // 初始化时钟事件设备（PIT/本地APIC），空闲时按最近的定时器编程one-shot中断
+    clockevent_init();
+    LOG_INFO("KERNEL", "Clock events initialized");
+    
+    // 初始化上下文切换（延迟FPU切换）
+    context_init();
+    LOG_INFO("KERNEL", "Context switching initialized");
+    
     // 初始化设备管理
     device_init();
     LOG_INFO("KERNEL", "Device management initialized");
@@ -95,6 +128,10 @@ void kernel_main() {
         }
     }
     
+    // 启动其余处理器，各自运行调度循环（测试只在引导处理器上运行）
+    smp_init();
+    LOG_INFO("KERNEL", "SMP initialized");
+    
     // 启动第一个用户进程
     start_init_process();
     LOG_INFO("KERNEL", "Init process started");
@@ -129,6 +166,12 @@ int check_test_mode() {
 // 调度器循环
 void scheduler_loop() {
     while (1) {
+        // 唤醒睡眠到期的进程
+        scheduler_wake_waiting();
+        
+        // 回收已终止的进程，释放它们的栈和地址空间
+        process_reap();
+        
         struct process* next = scheduler_select_next();
         if (next) {
             switch_to_process(next);
@@ -1,6 +1,7 @@
 #include "logger.h"
 #include "kernel.h"
 #include "memory.h"
+#include "clocksource.h"
 
 // 日志条目缓冲区
 static struct log_entry log_buffer[LOG_BUFFER_SIZE];
@@ -274,11 +275,9 @@ void logger_clear() {
     print_string("Log buffer cleared\n");
 }
 
-// 获取时间戳
+// 获取时间戳（开机以来的纳秒数）
 unsigned long long get_timestamp() {
-    // 在实际实现中，这会从高精度时钟获取时间戳
-    static unsigned long long timestamp = 0;
-    return timestamp++;
+    return ktime_get_ns();
 }
 
 // 长整数转字符串
@@ -1,46 +1,162 @@
 #include "memory.h"
 #include "logger.h"
+#include "kernel.h"
+#include "spinlock.h"
 
-// 内存块结构
+// 内存块状态
+#define MEMORY_BLOCK_USED    0   // 已分配
+#define MEMORY_BLOCK_FREE    1   // 空闲，属于通用堆
+#define MEMORY_BLOCK_CACHED  2   // 空闲，缓存在尺寸类别链表中
+
+// 通用堆块没有尺寸类别
+#define MEMORY_NO_CLASS      0xF
+
+// 内存块头部：大小和标志位压缩在一个32位字中
+// 下一个物理块由大小推算，前一个物理块空闲时通过其尾部的边界标记定位
 struct memory_block {
-    unsigned int size;
-    int free;
-    struct memory_block* next;
+    unsigned int size       : 25;  // 数据区大小（以4字节为单位）
+    unsigned int state      : 2;   // 块状态
+    unsigned int prev_free  : 1;   // 物理上的前一个块是否空闲
+    unsigned int size_class : 4;   // 所属尺寸类别，MEMORY_NO_CLASS表示通用堆块
+#ifdef MEMORY_DEBUG
     // 添加用于跟踪的额外信息
     const char* allocated_file;
     unsigned int allocated_line;
     unsigned int magic; // 用于检测内存损坏
+#endif
 };
 
-// 内存统计信息
-struct memory_stats {
-    unsigned int total_allocated;
-    unsigned int total_freed;
-    unsigned int current_usage;
-    unsigned int peak_usage;
-    unsigned int allocation_count;
-    unsigned int free_count;
+// 空闲块数据区开头存放的链表指针
+struct free_links {
+    struct memory_block* next;
+    struct memory_block* prev;
 };
 
+// 通用堆空闲块至少要容纳链表指针和尾部边界标记
+#define MEMORY_MIN_FREE_SIZE (sizeof(struct free_links) + sizeof(unsigned int))
+
 // 内存堆起始地址
 static unsigned int heap_start = 0x100000; // 1MB
 static unsigned int heap_end = 0x100000;
-static struct memory_block* head = 0;
+static struct memory_block* tail = 0;
+
+// 通用堆的显式空闲链表（双向）
+static struct memory_block* free_list = 0;
+
+// 各尺寸类别的空闲链表
+static struct memory_block* class_free_lists[MEMORY_SIZE_CLASSES];
 
 // 内存统计信息
-static struct memory_stats mem_stats = {0, 0, 0, 0, 0, 0};
+static struct memory_stats mem_stats;
+
+// 堆锁：保护通用堆和尺寸类别的空闲链表、堆末尾、统计和分析器表。持有期间关中断，
+// 中断处理程序也可以分配和释放内存；持有期间只写日志，不调用其他加锁的子系统
+static spinlock_t heap_lock = SPINLOCK_INIT;
 
 // 魔数用于检测内存损坏
 #define MEMORY_BLOCK_MAGIC 0xDEADBEEF
 
+#ifdef MEMORY_DEBUG
+#define BLOCK_MAGIC_OK(block) ((block)->magic == MEMORY_BLOCK_MAGIC)
+#else
+#define BLOCK_MAGIC_OK(block) 1
+#endif
+
+#ifdef MEMORY_DEBUG
+// 堆分析器：按分配位置聚合的统计表（开放寻址哈希，调用点只增不删）
+struct heap_site {
+    const char* file;
+    unsigned int line;
+    unsigned int live_bytes;
+    unsigned int live_count;
+    unsigned int total_allocations;
+    unsigned int histogram[MEMORY_PROFILE_BUCKETS];
+};
+
+static struct heap_site heap_sites[MEMORY_PROFILE_SITES];
+static unsigned int heap_sites_dropped = 0;  // 表满时未能记录的分配次数
+#endif
+
+// 块数据区大小（字节）
+static inline unsigned int block_size(struct memory_block* block) {
+    return block->size << 2;
+}
+
+static inline void set_block_size(struct memory_block* block, unsigned int size) {
+    block->size = size >> 2;
+}
+
+// 块数据区起始地址
+static inline void* block_data(struct memory_block* block) {
+    return (void*)((unsigned int)block + sizeof(struct memory_block));
+}
+
+// 由数据区指针得到块头部
+static inline struct memory_block* data_to_block(void* ptr) {
+    return (struct memory_block*)((unsigned int)ptr - sizeof(struct memory_block));
+}
+
+// 空闲块的链表指针
+static inline struct free_links* block_links(struct memory_block* block) {
+    return (struct free_links*)block_data(block);
+}
+
+// 物理上的下一个块，堆末尾返回0
+static inline struct memory_block* block_next(struct memory_block* block) {
+    unsigned int end = (unsigned int)block_data(block) + block_size(block);
+    return end < heap_end ? (struct memory_block*)end : 0;
+}
+
+// 物理上的前一个块（仅当其空闲时可通过边界标记定位）
+static inline struct memory_block* block_prev_free(struct memory_block* block) {
+    unsigned int prev_size = *(unsigned int*)((unsigned int)block - sizeof(unsigned int));
+    return (struct memory_block*)((unsigned int)block - prev_size - sizeof(struct memory_block));
+}
+
+// 在空闲块尾部写入边界标记
+static inline void set_footer(struct memory_block* block) {
+    unsigned int end = (unsigned int)block_data(block) + block_size(block);
+    *(unsigned int*)(end - sizeof(unsigned int)) = block_size(block);
+}
+
+// 初始化新块的头部
+static void block_init(struct memory_block* block, unsigned int size, int prev_free) {
+    set_block_size(block, size);
+    block->state = MEMORY_BLOCK_USED;
+    block->prev_free = prev_free;
+    block->size_class = MEMORY_NO_CLASS;
+#ifdef MEMORY_DEBUG
+    block->allocated_file = 0;
+    block->allocated_line = 0;
+    block->magic = MEMORY_BLOCK_MAGIC;
+#endif
+}
+
+// 设置块状态，并同步后继块的prev_free标志和边界标记
+static void set_block_state(struct memory_block* block, int state) {
+    block->state = state;
+    
+    if (state == MEMORY_BLOCK_FREE) {
+        set_footer(block);
+    }
+    
+    struct memory_block* next = block_next(block);
+    if (next) {
+        next->prev_free = (state == MEMORY_BLOCK_FREE);
+    }
+}
+
 // 初始化内存管理
 void initialize_memory() {
     // 初始化堆
-    head = (struct memory_block*)heap_start;
-    head->size = 0;
-    head->free = 1;
-    head->next = 0;
-    head->magic = MEMORY_BLOCK_MAGIC;
+    heap_end = heap_start;
+    tail = 0;
+    free_list = 0;
+    
+    // 清空尺寸类别链表
+    for (int i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+        class_free_lists[i] = 0;
+    }
     
     // 重置统计信息
     mem_stats.total_allocated = 0;
@@ -49,102 +165,322 @@ void initialize_memory() {
     mem_stats.peak_usage = 0;
     mem_stats.allocation_count = 0;
     mem_stats.free_count = 0;
+    for (int i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+        mem_stats.class_hits[i] = 0;
+        mem_stats.class_misses[i] = 0;
+    }
+    mem_stats.realloc_in_place = 0;
+    mem_stats.realloc_moved = 0;
+    mem_stats.header_size = sizeof(struct memory_block);
+
+#ifdef MEMORY_DEBUG
+    // 清空堆分析表
+    for (int i = 0; i < MEMORY_PROFILE_SITES; i++) {
+        heap_sites[i].file = 0;
+    }
+    heap_sites_dropped = 0;
+#endif
     
     LOG_INFO("MEMORY", "Memory management initialized");
 }
 
-// 分配内存
-void* allocate_memory_debug(unsigned int size, const char* file, unsigned int line) {
-    // 对齐到4字节边界
-    if (size % 4 != 0) {
-        size += (4 - (size % 4));
+// 根据请求大小计算尺寸类别，超过最大类别返回-1
+static int size_to_class(unsigned int size) {
+    if (size > MEMORY_MAX_CLASS_SIZE) {
+        return -1;
     }
     
-    // 遍历空闲块链表
-    struct memory_block* current = head;
+    int index = 0;
+    unsigned int class_size = MEMORY_MIN_CLASS_SIZE;
+    while (class_size < size) {
+        class_size <<= 1;
+        index++;
+    }
+    return index;
+}
+
+// 获取尺寸类别对应的对象大小
+static unsigned int class_to_size(int index) {
+    return MEMORY_MIN_CLASS_SIZE << index;
+}
+
+// 记录一次分配
+static void record_allocation(unsigned int size) {
+    mem_stats.total_allocated += size;
+    mem_stats.current_usage += size;
+    mem_stats.allocation_count++;
+    
+    if (mem_stats.current_usage > mem_stats.peak_usage) {
+        mem_stats.peak_usage = mem_stats.current_usage;
+    }
+}
+
+#ifdef MEMORY_DEBUG
+// 查找分配位置对应的统计项，不存在时创建；表满返回0
+static struct heap_site* profile_find_site(const char* file, unsigned int line) {
+    unsigned int hash = (((unsigned int)file >> 2) ^ (line * 2654435761u)) % MEMORY_PROFILE_SITES;
+    
+    for (int probe = 0; probe < MEMORY_PROFILE_SITES; probe++) {
+        struct heap_site* site = &heap_sites[(hash + probe) % MEMORY_PROFILE_SITES];
+        
+        if (site->file == file && site->line == line) {
+            return site;
+        }
+        
+        if (!site->file) {
+            site->file = file;
+            site->line = line;
+            site->live_bytes = 0;
+            site->live_count = 0;
+            site->total_allocations = 0;
+            for (int i = 0; i < MEMORY_PROFILE_BUCKETS; i++) {
+                site->histogram[i] = 0;
+            }
+            return site;
+        }
+    }
+    
+    return 0;
+}
+
+// 分配大小对应的直方图桶：16, 32, ..., 2048, 更大
+static int profile_bucket(unsigned int size) {
+    int bucket = 0;
+    unsigned int limit = MEMORY_MIN_CLASS_SIZE;
+    while (bucket < MEMORY_PROFILE_BUCKETS - 1 && size > limit) {
+        limit <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// 记录分配位置上的一次分配
+static void profile_record_allocation(const char* file, unsigned int line, unsigned int size) {
+    if (!file) {
+        return;
+    }
+    
+    struct heap_site* site = profile_find_site(file, line);
+    if (!site) {
+        heap_sites_dropped++;
+        return;
+    }
+    
+    site->live_bytes += size;
+    site->live_count++;
+    site->total_allocations++;
+    site->histogram[profile_bucket(size)]++;
+}
+
+// 记录分配位置上的一次释放
+static void profile_record_free(const char* file, unsigned int line, unsigned int size) {
+    if (!file) {
+        return;
+    }
+    
+    struct heap_site* site = profile_find_site(file, line);
+    if (site && site->live_count > 0) {
+        site->live_bytes -= size;
+        site->live_count--;
+    }
+}
+#endif
+
+// 将块插入通用堆空闲链表头部并标记为空闲
+static void free_list_insert(struct memory_block* block) {
+    set_block_state(block, MEMORY_BLOCK_FREE);
+    
+    struct free_links* links = block_links(block);
+    links->prev = 0;
+    links->next = free_list;
+    if (free_list) {
+        block_links(free_list)->prev = block;
+    }
+    free_list = block;
+}
+
+// 从通用堆空闲链表中摘除块
+static void free_list_remove(struct memory_block* block) {
+    struct free_links* links = block_links(block);
+    
+    if (links->prev) {
+        block_links(links->prev)->next = links->next;
+    } else {
+        free_list = links->next;
+    }
+    if (links->next) {
+        block_links(links->next)->prev = links->prev;
+    }
+}
+
+// 将物理后继块并入block（后继必须为空闲且已从空闲链表摘除）
+static void absorb_next_block(struct memory_block* block) {
+    struct memory_block* next = block_next(block);
+    
+    set_block_size(block, block_size(block) + sizeof(struct memory_block) + block_size(next));
+    if (tail == next) {
+        tail = block;
+    }
+}
+
+// 若剩余空间足够容纳一个空闲块，则将block分割为size字节并把剩余部分放回空闲链表
+static void split_block(struct memory_block* block, unsigned int size) {
+    if (block_size(block) < size + sizeof(struct memory_block) + MEMORY_MIN_FREE_SIZE) {
+        return;
+    }
+    
+    struct memory_block* new_block = (struct memory_block*)((unsigned int)block + sizeof(struct memory_block) + size);
+    block_init(new_block, block_size(block) - size - sizeof(struct memory_block), 0);
+    set_block_size(block, size);
+    
+    if (tail == block) {
+        tail = new_block;
+    }
+    
+    free_list_insert(new_block);
+}
+
+// 从通用堆获取一个至少size字节的块（在空闲链表上首次适配，找不到则扩展堆）
+static struct memory_block* heap_take_block(unsigned int size) {
+    // 只遍历空闲块，而不是整个堆
+    struct memory_block* current = free_list;
     while (current) {
         // 检查魔数以检测内存损坏
-        if (current->magic != MEMORY_BLOCK_MAGIC) {
+        if (!BLOCK_MAGIC_OK(current)) {
             LOG_ERROR("MEMORY", "Memory corruption detected in block %x", (unsigned int)current);
             return 0;
         }
         
-        if (current->free && current->size >= size) {
+        if (block_size(current) >= size) {
             // 找到合适的空闲块
-            current->free = 0;
-            current->allocated_file = file;
-            current->allocated_line = line;
-            
-            // 更新统计信息
-            mem_stats.total_allocated += size;
-            mem_stats.current_usage += size;
-            mem_stats.allocation_count++;
-            
-            if (mem_stats.current_usage > mem_stats.peak_usage) {
-                mem_stats.peak_usage = mem_stats.current_usage;
-            }
+            free_list_remove(current);
+            set_block_state(current, MEMORY_BLOCK_USED);
             
             // 如果剩余空间足够，分割内存块
-            if (current->size > size + sizeof(struct memory_block)) {
-                struct memory_block* new_block = (struct memory_block*)((unsigned int)current + sizeof(struct memory_block) + size);
-                new_block->size = current->size - size - sizeof(struct memory_block);
-                new_block->free = 1;
-                new_block->next = current->next;
-                new_block->magic = MEMORY_BLOCK_MAGIC;
-                
-                current->size = size;
-                current->next = new_block;
-            }
+            split_block(current, size);
             
-            // 返回内存块数据部分的指针
-            return (void*)((unsigned int)current + sizeof(struct memory_block));
+            return current;
         }
-        current = current->next;
+        current = block_links(current)->next;
+    }
+    
+    // 堆末尾块空闲但不够大时，直接将其扩展到所需大小
+    if (tail && tail->state == MEMORY_BLOCK_FREE) {
+        free_list_remove(tail);
+        heap_end += size - block_size(tail);
+        set_block_size(tail, size);
+        set_block_state(tail, MEMORY_BLOCK_USED);
+        return tail;
     }
     
     // 没有找到合适的空闲块，扩展堆
     struct memory_block* new_block = (struct memory_block*)heap_end;
-    new_block->size = size;
-    new_block->free = 0;
-    new_block->next = 0;
-    new_block->allocated_file = file;
-    new_block->allocated_line = line;
-    new_block->magic = MEMORY_BLOCK_MAGIC;
+    block_init(new_block, size, 0);
     
-    // 更新统计信息
-    mem_stats.total_allocated += size;
-    mem_stats.current_usage += size;
-    mem_stats.allocation_count++;
+    // 更新堆结束地址
+    heap_end += sizeof(struct memory_block) + size;
+    tail = new_block;
     
-    if (mem_stats.current_usage > mem_stats.peak_usage) {
-        mem_stats.peak_usage = mem_stats.current_usage;
+    return new_block;
+}
+
+// 为尺寸类别补充对象：从通用堆切出一段连续内存并分割为多个同尺寸块
+static int refill_size_class(int index) {
+    unsigned int object_size = class_to_size(index);
+    unsigned int stride = sizeof(struct memory_block) + object_size;
+    unsigned int count = MEMORY_SLAB_REFILL_BYTES / stride;
+    if (count == 0) {
+        count = 1;
     }
     
-    // 更新堆结束地址
-    heap_end += sizeof(struct memory_block) + size;
+    struct memory_block* block = heap_take_block(stride * count - sizeof(struct memory_block));
+    if (!block) {
+        return -1;
+    }
     
-    // 将新块添加到链表中
-    if (head == 0) {
-        head = new_block;
-    } else {
-        current = head;
-        while (current->next) {
-            // 检查魔数以检测内存损坏
-            if (current->magic != MEMORY_BLOCK_MAGIC) {
-                LOG_ERROR("MEMORY", "Memory corruption detected in block %x", (unsigned int)current);
+    // 分割为count个对象，均保留在物理堆中，并压入尺寸类别空闲链表
+    for (unsigned int i = 0; i < count; i++) {
+        struct memory_block* next_block = 0;
+        
+        if (i + 1 < count) {
+            next_block = (struct memory_block*)((unsigned int)block + stride);
+            block_init(next_block, block_size(block) - stride, 0);
+            set_block_size(block, object_size);
+            
+            if (tail == block) {
+                tail = next_block;
+            }
+        }
+        
+        block->state = MEMORY_BLOCK_CACHED;
+        block->size_class = index;
+        block_links(block)->next = class_free_lists[index];
+        class_free_lists[index] = block;
+        
+        block = next_block;
+    }
+    
+    return 0;
+}
+
+// 分配内存（调用者持有堆锁）
+static void* heap_allocate(unsigned int size, const char* file, unsigned int line) {
+    if (size == 0) {
+        return 0;
+    }
+    
+    // 对齐到4字节边界
+    if (size % 4 != 0) {
+        size += (4 - (size % 4));
+    }
+    
+    struct memory_block* block;
+    
+    // 小对象走尺寸类别空闲链表，O(1)弹出
+    int index = size_to_class(size);
+    if (index >= 0) {
+        if (class_free_lists[index]) {
+            mem_stats.class_hits[index]++;
+        } else {
+            mem_stats.class_misses[index]++;
+            if (refill_size_class(index) < 0) {
                 return 0;
             }
-            current = current->next;
         }
-        current->next = new_block;
+        
+        block = class_free_lists[index];
+        if (!BLOCK_MAGIC_OK(block)) {
+            LOG_ERROR("MEMORY", "Memory corruption detected in block %x", (unsigned int)block);
+            return 0;
+        }
+        class_free_lists[index] = block_links(block)->next;
+        block->state = MEMORY_BLOCK_USED;
+    } else {
+        // 大对象回退到通用堆链表
+        block = heap_take_block(size);
+        if (!block) {
+            return 0;
+        }
     }
+
+#ifdef MEMORY_DEBUG
+    block->allocated_file = file;
+    block->allocated_line = line;
+    profile_record_allocation(file, line, block_size(block));
+#else
+    (void)file;
+    (void)line;
+#endif
+    
+    // 更新统计信息
+    record_allocation(block_size(block));
     
     // 返回内存块数据部分的指针
-    return (void*)((unsigned int)new_block + sizeof(struct memory_block));
+    return block_data(block);
 }
 
-// 释放内存
-void free_memory_debug(void* ptr, const char* file, unsigned int line) {
+// 释放内存（调用者持有堆锁）
+static void heap_free(void* ptr, const char* file, unsigned int line) {
     // 检查空指针
     if (!ptr) {
         LOG_WARNING("MEMORY", "Attempt to free NULL pointer at %s:%d", file, line);
@@ -152,133 +488,324 @@ void free_memory_debug(void* ptr, const char* file, unsigned int line) {
     }
     
     // 获取内存块结构指针
-    struct memory_block* block = (struct memory_block*)((unsigned int)ptr - sizeof(struct memory_block));
+    struct memory_block* block = data_to_block(ptr);
     
     // 检查魔数以检测内存损坏
-    if (block->magic != MEMORY_BLOCK_MAGIC) {
+    if (!BLOCK_MAGIC_OK(block)) {
         LOG_ERROR("MEMORY", "Memory corruption detected when freeing block at %s:%d", file, line);
         return;
     }
     
     // 检查是否已经释放
-    if (block->free) {
+    if (block->state != MEMORY_BLOCK_USED) {
         LOG_WARNING("MEMORY", "Attempt to free already freed memory at %s:%d", file, line);
+#ifdef MEMORY_DEBUG
         LOG_WARNING("MEMORY", "Originally allocated at %s:%d", block->allocated_file, block->allocated_line);
+#endif
         return;
     }
     
     // 更新统计信息
-    mem_stats.total_freed += block->size;
-    mem_stats.current_usage -= block->size;
+    mem_stats.total_freed += block_size(block);
+    mem_stats.current_usage -= block_size(block);
     mem_stats.free_count++;
-    
-    // 标记为空闲
-    block->free = 1;
+
+#ifdef MEMORY_DEBUG
+    profile_record_free(block->allocated_file, block->allocated_line, block_size(block));
     block->allocated_file = 0;
     block->allocated_line = 0;
+#endif
     
-    // 合并相邻的空闲块
-    struct memory_block* current = head;
-    while (current) {
+    // 尺寸类别块直接归还到对应空闲链表，不参与合并
+    if (block->size_class != MEMORY_NO_CLASS) {
+        block->state = MEMORY_BLOCK_CACHED;
+        block_links(block)->next = class_free_lists[block->size_class];
+        class_free_lists[block->size_class] = block;
+        
+        LOG_DEBUG("MEMORY", "Memory block freed at %s:%d", file, line);
+        return;
+    }
+    
+    // 通过边界标记只与物理相邻的空闲块合并，O(1)
+    struct memory_block* next = block_next(block);
+    if (next && next->state == MEMORY_BLOCK_FREE) {
         // 检查魔数以检测内存损坏
-        if (current->magic != MEMORY_BLOCK_MAGIC) {
-            LOG_ERROR("MEMORY", "Memory corruption detected in block %x", (unsigned int)current);
+        if (!BLOCK_MAGIC_OK(next)) {
+            LOG_ERROR("MEMORY", "Memory corruption detected in block %x", (unsigned int)next);
             return;
         }
-        
-        if (current->free && current->next && current->next->free) {
-            // 合并当前块和下一个块
-            current->size += sizeof(struct memory_block) + current->next->size;
-            current->next = current->next->next;
-        } else {
-            current = current->next;
+        free_list_remove(next);
+        absorb_next_block(block);
+    }
+    
+    if (block->prev_free) {
+        struct memory_block* prev = block_prev_free(block);
+        // 检查魔数以检测内存损坏
+        if (!BLOCK_MAGIC_OK(prev)) {
+            LOG_ERROR("MEMORY", "Memory corruption detected in block %x", (unsigned int)prev);
+            return;
         }
+        free_list_remove(prev);
+        absorb_next_block(prev);
+        block = prev;
     }
     
+    // 标记为空闲并加入空闲链表
+    free_list_insert(block);
+    
     LOG_DEBUG("MEMORY", "Memory block freed at %s:%d", file, line);
 }
 
-// 重新分配内存
-void* realloc_memory_debug(void* ptr, unsigned int size, const char* file, unsigned int line) {
+// 尝试原地扩展通用堆块：吞并空闲的物理后继块，或在堆末尾直接扩展heap_end
+static int realloc_grow_in_place(struct memory_block* block, unsigned int size) {
+    struct memory_block* next = block_next(block);
+    
+    if (next && next->state == MEMORY_BLOCK_FREE &&
+        block_size(block) + sizeof(struct memory_block) + block_size(next) >= size) {
+        // 检查魔数以检测内存损坏
+        if (!BLOCK_MAGIC_OK(next)) {
+            LOG_ERROR("MEMORY", "Memory corruption detected in block %x", (unsigned int)next);
+            return -1;
+        }
+        free_list_remove(next);
+        absorb_next_block(block);
+        set_block_state(block, MEMORY_BLOCK_USED);
+        split_block(block, size);
+        return 0;
+    }
+    
+    if (block == tail) {
+        // 最后一个块，直接扩展堆
+        heap_end += size - block_size(block);
+        set_block_size(block, size);
+        return 0;
+    }
+    
+    return -1;
+}
+
+// 批量复制数据：先按32位字复制，再复制剩余字节
+static void memory_copy(void* dest, const void* src, unsigned int count) {
+    unsigned int words = count / 4;
+    unsigned int bytes = count % 4;
+    
+    __asm__ volatile (
+        "cld\n\t"
+        "rep movsl\n\t"
+        "mov %3, %%ecx\n\t"
+        "rep movsb"
+        : "+D"(dest), "+S"(src), "+c"(words)
+        : "r"(bytes)
+        : "memory"
+    );
+}
+
+// 重新分配内存（调用者持有堆锁）
+static void* heap_reallocate(void* ptr, unsigned int size, const char* file, unsigned int line) {
     if (!ptr) {
-        return allocate_memory_debug(size, file, line);
+        return heap_allocate(size, file, line);
     }
     
     if (size == 0) {
-        free_memory_debug(ptr, file, line);
+        heap_free(ptr, file, line);
         return 0;
     }
     
     // 获取当前块的大小
-    struct memory_block* block = (struct memory_block*)((unsigned int)ptr - sizeof(struct memory_block));
+    struct memory_block* block = data_to_block(ptr);
     
     // 检查魔数以检测内存损坏
-    if (block->magic != MEMORY_BLOCK_MAGIC) {
+    if (!BLOCK_MAGIC_OK(block)) {
         LOG_ERROR("MEMORY", "Memory corruption detected in realloc at %s:%d", file, line);
         return 0;
     }
     
-    unsigned int old_size = block->size;
+    unsigned int old_size = block_size(block);
     
     if (size <= old_size) {
         return ptr;
     }
     
+    // 对齐到4字节边界
+    if (size % 4 != 0) {
+        size += (4 - (size % 4));
+    }
+    
+    // 通用堆块尝试原地扩展
+    if (block->size_class == MEMORY_NO_CLASS && realloc_grow_in_place(block, size) == 0) {
+        mem_stats.total_allocated += block_size(block) - old_size;
+        mem_stats.current_usage += block_size(block) - old_size;
+        if (mem_stats.current_usage > mem_stats.peak_usage) {
+            mem_stats.peak_usage = mem_stats.current_usage;
+        }
+        mem_stats.realloc_in_place++;
+#ifdef MEMORY_DEBUG
+        // 增长部分计入原分配位置
+        struct heap_site* site = block->allocated_file ?
+            profile_find_site(block->allocated_file, block->allocated_line) : 0;
+        if (site) {
+            site->live_bytes += block_size(block) - old_size;
+        }
+#endif
+        return ptr;
+    }
+    
     // 分配新内存
-    void* new_ptr = allocate_memory_debug(size, file, line);
+    void* new_ptr = heap_allocate(size, file, line);
     if (!new_ptr) {
         return 0;
     }
     
     // 复制旧数据
-    char* src = (char*)ptr;
-    char* dst = (char*)new_ptr;
-    for (unsigned int i = 0; i < old_size; i++) {
-        dst[i] = src[i];
-    }
+    memory_copy(new_ptr, ptr, old_size);
+    mem_stats.realloc_moved++;
     
     // 释放旧内存
-    free_memory_debug(ptr, file, line);
+    heap_free(ptr, file, line);
     
     return new_ptr;
 }
 
+// 分配内存
+void* allocate_memory_debug(unsigned int size, const char* file, unsigned int line) {
+    unsigned int flags = spin_lock_irqsave(&heap_lock);
+    void* ptr = heap_allocate(size, file, line);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+// 释放内存
+void free_memory_debug(void* ptr, const char* file, unsigned int line) {
+    unsigned int flags = spin_lock_irqsave(&heap_lock);
+    heap_free(ptr, file, line);
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+// 重新分配内存
+void* realloc_memory_debug(void* ptr, unsigned int size, const char* file, unsigned int line) {
+    unsigned int flags = spin_lock_irqsave(&heap_lock);
+    void* new_ptr = heap_reallocate(ptr, size, file, line);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return new_ptr;
+}
+
 // 获取内存统计信息
 void get_memory_stats(struct memory_stats* stats) {
     if (stats) {
+        unsigned int flags = spin_lock_irqsave(&heap_lock);
         stats->total_allocated = mem_stats.total_allocated;
         stats->total_freed = mem_stats.total_freed;
         stats->current_usage = mem_stats.current_usage;
         stats->peak_usage = mem_stats.peak_usage;
         stats->allocation_count = mem_stats.allocation_count;
         stats->free_count = mem_stats.free_count;
+        for (int i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+            stats->class_hits[i] = mem_stats.class_hits[i];
+            stats->class_misses[i] = mem_stats.class_misses[i];
+        }
+        stats->realloc_in_place = mem_stats.realloc_in_place;
+        stats->realloc_moved = mem_stats.realloc_moved;
+        stats->header_size = mem_stats.header_size;
+        spin_unlock_irqrestore(&heap_lock, flags);
     }
 }
 
 // 打印内存统计信息
 void print_memory_stats() {
-    LOG_INFO("MEMORY", "=== Memory Statistics ===");
-    LOG_INFO("MEMORY", "Total allocated: %d bytes", mem_stats.total_allocated);
-    LOG_INFO("MEMORY", "Total freed: %d bytes", mem_stats.total_freed);
-    LOG_INFO("MEMORY", "Current usage: %d bytes", mem_stats.current_usage);
-    LOG_INFO("MEMORY", "Peak usage: %d bytes", mem_stats.peak_usage);
-    LOG_INFO("MEMORY", "Allocation count: %d", mem_stats.allocation_count);
-    LOG_INFO("MEMORY", "Free count: %d", mem_stats.free_count);
-    LOG_INFO("MEMORY", "========================");
+    unsigned int live_blocks = mem_stats.allocation_count - mem_stats.free_count;
+    char stat_str[16];
+    
+    print_string("=== Memory Statistics ===\n");
+#ifdef MEMORY_DEBUG
+    print_string("Allocator mode: debug (file/line/magic tracking)\n");
+#else
+    print_string("Allocator mode: release (packed size/flags header)\n");
+#endif
+    
+    print_string("Total allocated: ");
+    int_to_string(mem_stats.total_allocated, stat_str);
+    print_string(stat_str);
+    print_string(" bytes, freed: ");
+    int_to_string(mem_stats.total_freed, stat_str);
+    print_string(stat_str);
+    print_string(" bytes\n");
+    
+    print_string("Current usage: ");
+    int_to_string(mem_stats.current_usage, stat_str);
+    print_string(stat_str);
+    print_string(" bytes, peak: ");
+    int_to_string(mem_stats.peak_usage, stat_str);
+    print_string(stat_str);
+    print_string(" bytes\n");
+    
+    print_string("Allocations: ");
+    int_to_string(mem_stats.allocation_count, stat_str);
+    print_string(stat_str);
+    print_string(", frees: ");
+    int_to_string(mem_stats.free_count, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    // 每个存活块都带一个块头，块头大小随分配器模式变化
+    print_string("Header size: ");
+    int_to_string(mem_stats.header_size, stat_str);
+    print_string(stat_str);
+    print_string(" bytes, overhead: ");
+    int_to_string(mem_stats.header_size * live_blocks, stat_str);
+    print_string(stat_str);
+    print_string(" bytes for ");
+    int_to_string(live_blocks, stat_str);
+    print_string(stat_str);
+    print_string(" live blocks\n");
+    
+    print_string("Realloc in place: ");
+    int_to_string(mem_stats.realloc_in_place, stat_str);
+    print_string(stat_str);
+    print_string(", moved: ");
+    int_to_string(mem_stats.realloc_moved, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    for (int i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+        print_string("Class ");
+        int_to_string(class_to_size(i), stat_str);
+        print_string(stat_str);
+        print_string(" bytes: ");
+        int_to_string(mem_stats.class_hits[i], stat_str);
+        print_string(stat_str);
+        print_string(" hits, ");
+        int_to_string(mem_stats.class_misses[i], stat_str);
+        print_string(stat_str);
+        print_string(" misses\n");
+    }
 }
 
 // 检查内存完整性
 int check_memory_integrity() {
-    struct memory_block* current = head;
+    unsigned int flags = spin_lock_irqsave(&heap_lock);
+    struct memory_block* current = heap_end > heap_start ? (struct memory_block*)heap_start : 0;
+    int prev_state_free = 0;
     int errors = 0;
     
+    // 按物理顺序遍历整个堆
     while (current) {
-        if (current->magic != MEMORY_BLOCK_MAGIC) {
+        if (!BLOCK_MAGIC_OK(current)) {
             LOG_ERROR("MEMORY", "Memory corruption detected in block %x", (unsigned int)current);
             errors++;
+            break;
+        }
+        
+        // 检查边界标记是否一致
+        if (current->prev_free != prev_state_free ||
+            (prev_state_free && block_next(block_prev_free(current)) != current)) {
+            LOG_ERROR("MEMORY", "Broken boundary tag before block %x", (unsigned int)current);
+            errors++;
         }
-        current = current->next;
+        
+        prev_state_free = (current->state == MEMORY_BLOCK_FREE);
+        current = block_next(current);
     }
+    spin_unlock_irqrestore(&heap_lock, flags);
     
     if (errors == 0) {
         LOG_INFO("MEMORY", "Memory integrity check passed");
@@ -287,4 +814,128 @@ int check_memory_integrity() {
     }
     
     return errors == 0 ? 0 : -1;
+}
+
+#ifdef MEMORY_DEBUG
+// 在未选中的调用点中选出占用字节数最大的一项，没有剩余项时返回-1
+static int profile_select_largest(char* taken) {
+    int best = -1;
+    
+    for (int i = 0; i < MEMORY_PROFILE_SITES; i++) {
+        if (heap_sites[i].file && !taken[i] &&
+            (best < 0 || heap_sites[i].live_bytes > heap_sites[best].live_bytes)) {
+            best = i;
+        }
+    }
+    
+    if (best >= 0) {
+        taken[best] = 1;
+    }
+    return best;
+}
+#endif
+
+// 获取堆分析快照，按当前占用字节数降序排列
+int memory_profile_snapshot(struct heap_site_stats* out, unsigned int max_sites) {
+#ifdef MEMORY_DEBUG
+    char taken[MEMORY_PROFILE_SITES];
+    unsigned int count = 0;
+    
+    if (!out) {
+        return 0;
+    }
+    
+    for (int i = 0; i < MEMORY_PROFILE_SITES; i++) {
+        taken[i] = 0;
+    }
+    
+    // 调用点数量有限，逐次选出剩余项中占用最大的一项
+    unsigned int flags = spin_lock_irqsave(&heap_lock);
+    while (count < max_sites) {
+        int index = profile_select_largest(taken);
+        if (index < 0) {
+            break;
+        }
+        
+        struct heap_site* site = &heap_sites[index];
+        struct heap_site_stats* entry = &out[count++];
+        
+        // 文件名过长时保留末尾部分
+        const char* file = site->file;
+        unsigned int len = 0;
+        while (file[len]) {
+            len++;
+        }
+        if (len > MEMORY_PROFILE_FILE_LEN - 1) {
+            file += len - (MEMORY_PROFILE_FILE_LEN - 1);
+        }
+        unsigned int j = 0;
+        while (file[j]) {
+            entry->file[j] = file[j];
+            j++;
+        }
+        entry->file[j] = '\0';
+        
+        entry->line = site->line;
+        entry->live_bytes = site->live_bytes;
+        entry->live_count = site->live_count;
+        entry->total_allocations = site->total_allocations;
+        for (int i = 0; i < MEMORY_PROFILE_BUCKETS; i++) {
+            entry->histogram[i] = site->histogram[i];
+        }
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    
+    return count;
+#else
+    (void)out;
+    (void)max_sites;
+    return 0;
+#endif
+}
+
+// 打印占用最多的分配位置
+void print_memory_profile(unsigned int max_sites) {
+#ifdef MEMORY_DEBUG
+    char taken[MEMORY_PROFILE_SITES];
+    
+    for (int i = 0; i < MEMORY_PROFILE_SITES; i++) {
+        taken[i] = 0;
+    }
+    
+    char stat_str[16];
+    
+    print_string("=== Heap Profile ===\n");
+    unsigned int flags = spin_lock_irqsave(&heap_lock);
+    for (unsigned int i = 0; i < max_sites; i++) {
+        int index = profile_select_largest(taken);
+        if (index < 0) {
+            break;
+        }
+        print_string((char*)heap_sites[index].file);
+        print_string(":");
+        int_to_string(heap_sites[index].line, stat_str);
+        print_string(stat_str);
+        print_string(" live ");
+        int_to_string(heap_sites[index].live_bytes, stat_str);
+        print_string(stat_str);
+        print_string(" bytes in ");
+        int_to_string(heap_sites[index].live_count, stat_str);
+        print_string(stat_str);
+        print_string(" blocks, ");
+        int_to_string(heap_sites[index].total_allocations, stat_str);
+        print_string(stat_str);
+        print_string(" allocations\n");
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    if (heap_sites_dropped > 0) {
+        print_string("Heap profile table full, allocations not tracked: ");
+        int_to_string(heap_sites_dropped, stat_str);
+        print_string(stat_str);
+        print_string("\n");
+    }
+#else
+    (void)max_sites;
+    print_string("Heap profile unavailable in release mode\n");
+#endif
 }
\ No newline at end of file
@@ -1,6 +1,26 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+// 分配器模式：默认保留调试头部（分配位置和魔数），
+// 定义MEMORY_RELEASE时头部压缩为单个大小/标志字（见 make release）
+#ifndef MEMORY_RELEASE
+#define MEMORY_DEBUG
+#endif
+
+// 小对象尺寸类别（16 - 2048字节，按2的幂递增）
+#define MEMORY_SIZE_CLASSES      8
+#define MEMORY_MIN_CLASS_SIZE    16
+#define MEMORY_MAX_CLASS_SIZE    2048
+
+// 每次为空闲链表补充对象时从通用堆切分的字节数
+#define MEMORY_SLAB_REFILL_BYTES 4096
+
+// 堆分析器：按分配位置（文件:行号）聚合的调用点数量上限
+#define MEMORY_PROFILE_SITES     128
+// 大小直方图桶数：<=16, <=32, ..., <=2048, >2048
+#define MEMORY_PROFILE_BUCKETS   9
+#define MEMORY_PROFILE_FILE_LEN  32
+
 // 内存统计信息结构
 struct memory_stats {
     unsigned int total_allocated;
@@ -9,6 +29,21 @@ struct memory_stats {
     unsigned int peak_usage;
     unsigned int allocation_count;
     unsigned int free_count;
+    unsigned int class_hits[MEMORY_SIZE_CLASSES];   // 各尺寸类别空闲链表命中次数
+    unsigned int class_misses[MEMORY_SIZE_CLASSES]; // 各尺寸类别需要补充的次数
+    unsigned int realloc_in_place;                  // 原地扩展的重新分配次数
+    unsigned int realloc_moved;                     // 需要移动数据的重新分配次数
+    unsigned int header_size;                       // 当前模式下每个块的头部大小
+};
+
+// 单个分配位置的堆分析快照
+struct heap_site_stats {
+    char file[MEMORY_PROFILE_FILE_LEN];              // 源文件名（过长时保留末尾部分）
+    unsigned int line;
+    unsigned int live_bytes;                         // 当前仍未释放的字节数
+    unsigned int live_count;                         // 当前仍未释放的块数
+    unsigned int total_allocations;                  // 累计分配次数
+    unsigned int histogram[MEMORY_PROFILE_BUCKETS];  // 分配大小直方图
 };
 
 // 初始化内存管理
@@ -32,6 +67,12 @@ void print_memory_stats();
 // 检查内存完整性
 int check_memory_integrity();
 
+// 获取堆分析快照，按live_bytes降序写入最多max_sites项，返回写入项数（发布模式下恒为0）
+int memory_profile_snapshot(struct heap_site_stats* out, unsigned int max_sites);
+
+// 打印占用最多的分配位置
+void print_memory_profile(unsigned int max_sites);
+
 // 为了方便使用，定义宏来自动传递文件和行号
 #define allocate_memory(size) allocate_memory_debug(size, __FILE__, __LINE__)
 #define free_memory(ptr) free_memory_debug(ptr, __FILE__, __LINE__)
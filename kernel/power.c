@@ -4,6 +4,9 @@
 #include "process.h"
 #include "scheduler.h"
 #include "profiling.h"
+#include "vm.h"
+#include "clockevent.h"
+#include "clocksource.h"
 
 // 电源管理状态
 static int power_state = POWER_STATE_RUNNING;
@@ -15,6 +18,12 @@ static int acpi_supported = 0;
 // 电源统计信息
 static struct power_stats power_statistics;
 
+// 进入当前电源状态的时间（毫秒）
+static unsigned int power_state_since = 0;
+
+// CPU停机累计纳秒数，time_halted由它换算
+static unsigned long long power_halted_ns = 0;
+
 // 初始化电源管理
 void power_init() {
     // 初始化电源统计信息
@@ -22,6 +31,9 @@ void power_init() {
     power_statistics.time_in_running = 0;
     power_statistics.time_in_sleep = 0;
     power_statistics.time_in_idle = 0;
+    power_statistics.time_halted = 0;
+    power_halted_ns = 0;
+    power_state_since = get_current_time();
     
     // 检查ACPI支持
     acpi_supported = power_check_acpi_support();
@@ -60,16 +72,20 @@ int power_set_state(int state) {
     // 记录状态变更
     power_statistics.total_state_changes++;
     
-    // 执行状态变更前的处理
+    // 执行状态变更前的处理：累计在旧状态中停留的时间
+    unsigned int now = get_current_time();
+    unsigned int elapsed = now - power_state_since;
+    power_state_since = now;
+    
     switch (power_state) {
         case POWER_STATE_RUNNING:
-            power_statistics.time_in_running += get_current_time();
+            power_statistics.time_in_running += elapsed;
             break;
         case POWER_STATE_SLEEP:
-            power_statistics.time_in_sleep += get_current_time();
+            power_statistics.time_in_sleep += elapsed;
             break;
         case POWER_STATE_IDLE:
-            power_statistics.time_in_idle += get_current_time();
+            power_statistics.time_in_idle += elapsed;
             break;
     }
     
@@ -223,21 +239,40 @@ void power_perform_reboot() {
 
 // CPU空闲处理
 void power_cpu_idle() {
+    // 利用空闲时间预先清零页帧，缩短之后缺页和创建页表的路径
+    vm_refill_zero_pool();
+    
+    // 无tick空闲：关中断后停止周期tick，把下一次时钟中断编程到最近的定时器截止时间，
+    // 用"sti; hlt"保证编程后到停机之间到来的中断不会丢失；已有定时器到期时不停机
+    // 关中断后再检查一次运行队列，调度IPI在此之前到达时不停机
+    __asm__ volatile ("cli");
+    unsigned long long halt_start = ktime_get_ns();
+    if (scheduler_has_ready() || !clockevent_idle_enter()) {
+        __asm__ volatile ("sti");
+        return;
+    }
+    
     // 如果电源管理已启用且当前不是关机状态
     if (power_management_enabled && power_state != POWER_STATE_SHUTDOWN) {
         // 更新电源状态为IDLE（如果当前是RUNNING）
         if (power_state == POWER_STATE_RUNNING) {
             // 只是临时进入空闲，不正式更改状态
             // 这里可以执行CPU休眠指令
-            __asm__ volatile ("hlt");
+            __asm__ volatile ("sti; hlt");
         } else {
             // 在其他状态下，执行HLT指令
-            __asm__ volatile ("hlt");
+            __asm__ volatile ("sti; hlt");
         }
     } else {
         // 电源管理未启用或系统正在关机，只执行HLT
-        __asm__ volatile ("hlt");
+        __asm__ volatile ("sti; hlt");
     }
+    
+    // 补上空闲期间经过的tick并恢复周期tick
+    clockevent_idle_exit();
+    
+    power_halted_ns += ktime_get_ns() - halt_start;
+    power_statistics.time_halted = (unsigned int)div_u64_u32(power_halted_ns, NSEC_PER_MSEC);
 }
 
 // 启用电源管理
@@ -281,6 +316,20 @@ void power_print_stats() {
     print_string("Power management enabled: ");
     print_string(power_management_enabled ? "yes" : "no");
     print_string("\n");
+    
+    print_string("Time in running/sleep/idle: ");
+    int_to_string(power_statistics.time_in_running, stat_str);
+    print_string(stat_str);
+    print_string("/");
+    int_to_string(power_statistics.time_in_sleep, stat_str);
+    print_string(stat_str);
+    print_string("/");
+    int_to_string(power_statistics.time_in_idle, stat_str);
+    print_string(stat_str);
+    print_string(" ms, halted: ");
+    int_to_string(power_statistics.time_halted, stat_str);
+    print_string(stat_str);
+    print_string(" ms\n");
 }
 
 // 电源状态转字符串
@@ -301,10 +350,9 @@ const char* power_state_to_string(int state) {
     }
 }
 
-// 获取当前时间（简化实现）
+// 获取当前时间（开机以来的毫秒数）
 unsigned int get_current_time() {
-    static unsigned int time = 0;
-    return time++;
+    return (unsigned int)div_u64_u32(ktime_get_ns(), NSEC_PER_MSEC);
 }
 
 // 整数转字符串
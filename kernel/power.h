@@ -11,9 +11,10 @@
 // 电源统计结构
 struct power_stats {
     unsigned int total_state_changes;
-    unsigned int time_in_running;
+    unsigned int time_in_running;   // 各状态累计时间（毫秒）
     unsigned int time_in_sleep;
     unsigned int time_in_idle;
+    unsigned int time_halted;       // CPU空闲停机（hlt）累计时间（毫秒）
 };
 
 // 函数声明
@@ -1,46 +1,314 @@
 #include "kernel.h"
+#include "memory.h"
 #include "process.h"
+#include "context.h"
+#include "scheduler.h"
+#include "spinlock.h"
+#include "smp.h"
 
-// 进程表
-static struct process process_table[MAX_PROCESSES];
-static int process_count = 0;
-static int current_process = -1;
+// 进程表：槽位按PROCESS_TABLE_CHUNK个一组按需分配，分配出去的组不再释放也不会移动，
+// 调度队列和定时器中保存的进程指针在槽位被回收复用之前始终有效
+static struct process* process_chunks[MAX_PROCESSES / PROCESS_TABLE_CHUNK];
+static unsigned int process_chunk_count = 0;
 
-// 初始化进程管理
+// 空闲槽位链表（通过next链接），回收的槽位优先复用
+static struct process* process_free_list = 0;
+
+// 按PID散列的进程，get_process在桶内查找
+static struct process* pid_hash[PID_HASH_SIZE];
+
+// 下一个尝试分配的PID
+static unsigned int next_pid = 1;
+
+// 已分配槽位（包括尚未回收的已终止进程）的进程数
+static unsigned int process_count = 0;
+
+// 保护进程表、空闲链表和PID散列表
+static spinlock_t process_lock = SPINLOCK_INIT;
+
+static struct process* current_process[MAX_CPUS];
+
+static inline unsigned int pid_hash_index(unsigned int pid) {
+    return pid & (PID_HASH_SIZE - 1);
+}
+
+// 在PID散列表中查找进程（调用者持有process_lock）
+static struct process* pid_hash_find(unsigned int pid) {
+    struct process* proc = pid_hash[pid_hash_index(pid)];
+    while (proc && proc->pid != pid) {
+        proc = proc->pid_hash_next;
+    }
+    return proc;
+}
+
+// 从PID散列表中删除进程（调用者持有process_lock）
+static void pid_hash_remove(struct process* proc) {
+    struct process** link = &pid_hash[pid_hash_index(proc->pid)];
+    while (*link && *link != proc) {
+        link = &(*link)->pid_hash_next;
+    }
+    if (*link) {
+        *link = proc->pid_hash_next;
+    }
+    proc->pid_hash_next = 0;
+}
+
+// 分配一个未被占用的PID：按顺序递增，超过PID_MAX后从1重新开始，跳过仍在使用的PID。
+// 存活进程数不超过MAX_PROCESSES，远小于PID_MAX，循环总能结束（调用者持有process_lock）
+static unsigned int pid_alloc() {
+    while (1) {
+        unsigned int pid = next_pid;
+        next_pid = next_pid >= PID_MAX ? 1 : next_pid + 1;
+        if (!pid_hash_find(pid)) {
+            return pid;
+        }
+    }
+}
+
+// 将槽位恢复为空闲状态
+static void process_slot_reset(struct process* proc) {
+    proc->pid = 0;
+    proc->state = PROCESS_STOPPED;
+    proc->parent_pid = 0;
+    proc->pid_hash_next = 0;
+    proc->stack_pointer = 0;
+    proc->syscall_regs = 0;
+    proc->page_dir = 0;
+    proc->next = 0;
+    proc->prev = 0;
+    timer_setup(&proc->sleep_timer, 0, 0);
+    timer_setup(&proc->dl_timer, 0, 0);
+    proc->kernel_stack = 0;
+    proc->kernel_esp = 0;
+    proc->cpu = 0;
+    proc->last_cpu = -1;
+    proc->on_cpu = 0;
+    proc->on_rq = 0;
+}
+
+// 扩充进程表：分配一组槽位放入空闲链表，已达MAX_PROCESSES或内存不足时返回-1（调用者持有process_lock）
+static int process_table_grow() {
+    if (process_chunk_count >= MAX_PROCESSES / PROCESS_TABLE_CHUNK) {
+        return -1;
+    }
+    
+    // 分配器只保证4字节对齐，多分配15字节使fpu_state（FXSAVE区域）对齐到16字节
+    void* memory = allocate_memory(PROCESS_TABLE_CHUNK * sizeof(struct process) + 15);
+    if (!memory) {
+        return -1;
+    }
+    struct process* chunk = (struct process*)(((unsigned int)memory + 15) & ~15u);
+    process_chunks[process_chunk_count++] = chunk;
+    
+    // 倒序压入，使低地址的槽位先被使用
+    for (int i = PROCESS_TABLE_CHUNK - 1; i >= 0; i--) {
+        process_slot_reset(&chunk[i]);
+        chunk[i].next = process_free_list;
+        process_free_list = &chunk[i];
+    }
+    return 0;
+}
+
+// 取一个空闲槽位并分配PID，进程表已满时返回0
+static struct process* process_alloc() {
+    spin_lock(&process_lock);
+    if (!process_free_list && process_table_grow() != 0) {
+        spin_unlock(&process_lock);
+        return 0;
+    }
+    
+    struct process* proc = process_free_list;
+    process_free_list = proc->next;
+    proc->next = 0;
+    
+    proc->pid = pid_alloc();
+    unsigned int index = pid_hash_index(proc->pid);
+    proc->pid_hash_next = pid_hash[index];
+    pid_hash[index] = proc;
+    process_count++;
+    
+    spin_unlock(&process_lock);
+    return proc;
+}
+
+// 释放槽位：PID不再能被查到，槽位放回空闲链表（调用者已释放进程占用的资源）
+static void process_free(struct process* proc) {
+    spin_lock(&process_lock);
+    
+    pid_hash_remove(proc);
+    for (int i = 0; i < MAX_CPUS; i++) {
+        if (current_process[i] == proc) {
+            current_process[i] = 0;
+        }
+    }
+    
+    process_slot_reset(proc);
+    proc->next = process_free_list;
+    process_free_list = proc;
+    process_count--;
+    
+    spin_unlock(&process_lock);
+}
+
+// 初始化进程管理：已分配的槽位全部放回空闲链表
 void initialize_processes() {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        process_table[i].pid = 0;
-        process_table[i].state = PROCESS_STOPPED;
+    spin_lock_init(&process_lock);
+    
+    process_free_list = 0;
+    for (int i = (int)process_chunk_count - 1; i >= 0; i--) {
+        for (int j = PROCESS_TABLE_CHUNK - 1; j >= 0; j--) {
+            struct process* proc = &process_chunks[i][j];
+            process_slot_reset(proc);
+            proc->next = process_free_list;
+            process_free_list = proc;
+        }
     }
     
+    for (int i = 0; i < PID_HASH_SIZE; i++) {
+        pid_hash[i] = 0;
+    }
+    next_pid = 1;
     process_count = 0;
-    current_process = -1;
+    
+    for (int i = 0; i < MAX_CPUS; i++) {
+        current_process[i] = 0;
+    }
 }
 
-// 创建进程
-void create_process(void (*entry_point)()) {
-    if (process_count >= MAX_PROCESSES) {
+// 创建进程，返回PID，失败时返回-1
+int create_process(void (*entry_point)()) {
+    struct process* proc = process_alloc();
+    if (!proc) {
         print_string("Error: Maximum process limit reached.\n");
-        return;
+        return -1;
     }
     
-    struct process* proc = &process_table[process_count];
-    proc->pid = process_count + 1;
-    proc->state = PROCESS_READY;
     proc->priority = 1;
     proc->program_counter = (unsigned int)entry_point;
+    proc->parent_pid = 0;
+    proc->cpu = smp_processor_id();
+    proc->last_cpu = -1;
+    proc->on_cpu = 0;
+    scheduler_init_task(proc, 0);
     
-    // 为进程分配栈空间
-    void* stack = allocate_memory(4096); // 4KB 栈空间
-    if (stack != 0) {
-        proc->stack_pointer = (unsigned int)stack + 4096;
-    } else {
-        proc->state = PROCESS_STOPPED;
+    // 每个进程拥有独立的地址空间，内核部分共享
+    proc->page_dir = vm_create_address_space();
+    if (!proc->page_dir) {
+        process_free(proc);
+        print_string("Error: Failed to create address space for process.\n");
+        return -1;
+    }
+    
+    // 进程栈在进程自己的地址空间中，随地址空间一起释放
+    if (vm_map_stack(proc->page_dir, PROCESS_STACK_TOP - PROCESS_STACK_SIZE, PROCESS_STACK_SIZE) != 0) {
+        vm_destroy_directory(proc->page_dir);
+        process_free(proc);
         print_string("Error: Failed to allocate stack for process.\n");
-        return;
+        return -1;
     }
+    proc->stack_pointer = PROCESS_STACK_TOP;
     
-    process_count++;
+    // 独立的内核栈，第一次被调度时在进程栈上从入口函数开始执行
+    if (context_create(proc, entry_point) != 0) {
+        vm_destroy_directory(proc->page_dir);
+        process_free(proc);
+        print_string("Error: Failed to allocate kernel stack for process.\n");
+        return -1;
+    }
+    
+    // 放入所属CPU的就绪队列，调度循环才能选中它
+    scheduler_add_to_ready(proc);
+    return proc->pid;
+}
+
+// 获取当前运行的进程
+struct process* get_current_process() {
+    return current_process[smp_processor_id()];
+}
+
+// 按PID查找进程，找不到或进程已终止时返回0
+struct process* get_process(unsigned int pid) {
+    spin_lock(&process_lock);
+    struct process* proc = pid_hash_find(pid);
+    if (proc && proc->state == PROCESS_STOPPED) {
+        proc = 0;
+    }
+    spin_unlock(&process_lock);
+    return proc;
+}
+
+// 复制当前进程，地址空间以写时复制方式共享（进程栈直接复制），返回子进程PID。
+// 只能在经int 0x80进入的系统调用中调用：子进程从进程栈上陷阱帧的副本返回，fork的返回值为0
+int fork_process() {
+    struct process* parent = get_current_process();
+    if (!parent || !parent->page_dir) {
+        return -1;
+    }
+    
+    unsigned int regs = (unsigned int)parent->syscall_regs;
+    if (regs < PROCESS_STACK_TOP - PROCESS_STACK_SIZE || regs >= PROCESS_STACK_TOP) {
+        print_string("Error: fork must be called through the system call interrupt.\n");
+        return -1;
+    }
+    
+    struct process* child = process_alloc();
+    if (!child) {
+        print_string("Error: Maximum process limit reached.\n");
+        return -1;
+    }
+    
+    page_directory_t* child_dir = vm_clone_directory(parent->page_dir);
+    if (!child_dir) {
+        process_free(child);
+        print_string("Error: Failed to clone address space for fork.\n");
+        return -1;
+    }
+    
+    child->priority = parent->priority;
+    child->stack_pointer = parent->stack_pointer;
+    child->program_counter = parent->program_counter;
+    child->parent_pid = parent->pid;
+    child->page_dir = child_dir;
+    child->cpu = smp_processor_id();
+    child->last_cpu = -1;
+    child->on_cpu = 0;
+    scheduler_init_task(child, parent);
+    
+    // 子进程有自己的内核栈，第一次被调度时从系统调用返回
+    if (context_fork(child, parent->syscall_regs) != 0) {
+        vm_destroy_directory(child_dir);
+        process_free(child);
+        print_string("Error: Failed to allocate kernel stack for fork.\n");
+        return -1;
+    }
+    
+    scheduler_add_to_ready(child);
+    return child->pid;
+}
+
+// 回收终止队列中的进程：释放内核栈和地址空间（包括进程栈），槽位和PID可以被新进程复用。
+// 返回本次回收的进程数
+int process_reap() {
+    int reaped = 0;
+    struct process* proc;
+    
+    while ((proc = scheduler_take_terminated()) != 0) {
+        timer_cancel(&proc->sleep_timer);
+        timer_cancel(&proc->dl_timer);
+        context_destroy(proc);
+        if (proc->page_dir) {
+            vm_destroy_directory(proc->page_dir);
+        }
+        process_free(proc);
+        reaped++;
+    }
+    
+    return reaped;
+}
+
+// 已分配槽位的进程数（包括尚未回收的已终止进程）
+unsigned int process_get_count() {
+    return process_count;
 }
 
 // 启动初始进程
@@ -62,49 +330,56 @@ void init_process_entry() {
     }
 }
 
-// 调度器
+// 调度器：从当前处理器的运行队列中选择下一个进程并切换过去
 void scheduler() {
-    if (process_count == 0) return;
-    
-    // 寻找下一个就绪进程
-    int next_process = -1;
-    for (int i = 0; i < process_count; i++) {
-        int index = (current_process + i + 1) % process_count;
-        if (process_table[index].state == PROCESS_READY) {
-            next_process = index;
-            break;
-        }
-    }
-    
-    // 如果找到就绪进程，则切换到该进程
-    if (next_process != -1 && next_process != current_process) {
-        current_process = next_process;
-        process_table[current_process].state = PROCESS_RUNNING;
-        switch_to_process(&process_table[current_process]);
+    struct process* next = scheduler_select_next();
+    if (next) {
+        switch_to_process(next);
     }
 }
 
 // 切换到指定进程
 void switch_to_process(struct process* proc) {
-    // 这里应该保存当前进程的上下文并恢复目标进程的上下文
-    // 简化实现，仅打印信息
-    print_string("Switching to process ");
-    // 简单的数字转字符串
-    char pid_str[12];
-    int_to_string(proc->pid, pid_str);
-    print_string(pid_str);
-    print_string("\n");
+    unsigned int cpu = smp_processor_id();
+    
+    // 切换地址空间（只重新加载CR3，没有独立地址空间的进程使用内核页目录）。
+    // 进程上次在别的处理器上运行时，它可能在那里修改过映射，本处理器TLB中的旧条目必须丢弃
+    if (proc->last_cpu >= 0 && proc->last_cpu != (int)cpu) {
+        vm_reload_address_space(proc->page_dir);
+    } else {
+        vm_switch_address_space(proc->page_dir);
+    }
+    proc->last_cpu = (int)cpu;
+    current_process[cpu] = proc;
+    
+    // 保存当前上下文并切换到目标进程的内核栈，目标进程让出处理器后才返回这里
+    if (proc->kernel_stack) {
+        context_switch_to(proc);
+    }
+    
+    // 已终止的进程回收时要销毁它的页目录，先换回内核页目录，使它不再被任何处理器加载
+    if (proc->state == PROCESS_STOPPED) {
+        vm_switch_address_space(0);
+    }
+    
+    // 进程的上下文已经完整保存，此后其他处理器才可以选中它
+    proc->on_cpu = 0;
+}
+
+// 当前进程主动让出处理器，回到调度循环
+void process_yield() {
+    struct process* proc = context_get_current();
+    if (!proc) {
+        return;
+    }
+    
+    // 状态不变，由调度循环根据时间片决定继续运行它还是换下一个进程
+    context_switch_to(0);
 }
 
 // 检查是否没有运行中的进程
 int no_running_processes() {
-    for (int i = 0; i < process_count; i++) {
-        if (process_table[i].state == PROCESS_RUNNING || 
-            process_table[i].state == PROCESS_READY) {
-            return 0;
-        }
-    }
-    return 1;
+    return scheduler_nr_runnable() == 0;
 }
 
 // 整数转字符串辅助函数
@@ -1,31 +1,87 @@
 #ifndef PROCESS_H
 #define PROCESS_H
 
+#include "vm.h"
+#include "timer.h"
+#include "context.h"
+#include "interrupts.h"
+#include "../libs/rbtree.h"
+
 // 进程状态
 #define PROCESS_RUNNING 0
 #define PROCESS_READY   1
 #define PROCESS_WAITING 2
 #define PROCESS_STOPPED 3
 
-// 最大进程数
-#define MAX_PROCESSES 64
+// 最大进程数：进程表按PROCESS_TABLE_CHUNK个槽位一组按需扩充，最多MAX_PROCESSES个
+#define MAX_PROCESSES 4096
+#define PROCESS_TABLE_CHUNK 32
+
+// 进程栈：位于每个地址空间中文件映射范围之下的固定位置，进程代码在它上面运行。
+// fork时整个复制，子进程中的地址不变，栈上的指针和返回地址仍然有效
+#define PROCESS_STACK_SIZE (4 * PAGE_SIZE)
+#define PROCESS_STACK_TOP  VM_MMAP_BASE
+
+// PID散列表的桶数（2的幂），PID在1到PID_MAX之间循环分配
+#define PID_HASH_SIZE 1024
+#define PID_MAX 32767
 
 // 进程控制块
 struct process {
     unsigned int pid;           // 进程ID
     unsigned int state;         // 进程状态
     unsigned int priority;      // 进程优先级
-    unsigned int stack_pointer; // 栈指针
+    unsigned int stack_pointer; // 进程栈顶（PROCESS_STACK_TOP），0表示直接在内核栈上运行
     unsigned int program_counter; // 程序计数器
     unsigned int registers[8];  // 通用寄存器快照
+    unsigned int parent_pid;    // 父进程ID
+    struct process* pid_hash_next; // PID散列桶中的后一个进程
+    struct interrupt_registers* syscall_regs; // 正在处理的系统调用的陷阱帧（位于进程栈上），0表示不在系统调用中
+    page_directory_t* page_dir; // 进程地址空间，0表示使用内核页目录
+    struct process* next;       // 所在调度队列中的后一个进程
+    struct process* prev;       // 所在调度队列中的前一个进程，用于O(1)出队
+    unsigned int wake_time;     // 睡眠结束的tick
+    struct timer sleep_timer;   // 睡眠定时器，到期时将进程移回就绪队列
+    void* kernel_stack;         // 内核栈（KERNEL_STACK_SIZE字节），0表示没有独立的执行上下文
+    unsigned int kernel_esp;    // 切换出去时保存的内核栈指针
+    unsigned int fpu_used;      // 是否用过FPU（fpu_state中有有效状态）
+    int fpu_cpu;                // 寄存器中持有其最新FPU状态的处理器，-1表示只在fpu_state中
+    unsigned int cpu;           // 所在运行队列的处理器
+    int last_cpu;               // 上次运行的处理器，-1表示还没有运行过
+    volatile unsigned int on_cpu; // 正在处理器上执行，切换回调度循环之前不能被其他处理器选中
+    unsigned int on_rq;         // 在运行队列中等待被选中
+    unsigned int sched_class;   // 调度类：实时类按优先级，公平类按虚拟运行时间
+    int nice;                   // 公平类的nice值
+    unsigned int weight;        // nice值对应的权重
+    unsigned long long vruntime; // 按权重折算的虚拟运行时间（纳秒），公平类按它排序
+    unsigned long long exec_start; // 本次计时开始的调度时钟
+    unsigned long long sum_exec_runtime; // 累计运行时间（纳秒）
+    unsigned long long prev_sum_exec_runtime; // 被选中运行时的累计运行时间，用于判断时间片是否用完
+    struct rb_node run_node;    // 公平类或截止时间类运行队列红黑树中的节点
+    unsigned long long dl_runtime; // 截止时间类：每个周期的运行时间预算（纳秒）
+    unsigned long long dl_deadline; // 截止时间类：相对于周期开始的截止时间（纳秒）
+    unsigned long long dl_period; // 截止时间类：周期（纳秒）
+    unsigned long long dl_abs_deadline; // 当前实例的绝对截止时间（调度时钟）
+    long long dl_budget;        // 当前实例剩余的运行时间预算
+    unsigned int dl_bw;         // 占用的处理器带宽（定点数，见SCHED_DL_BW_SHIFT）
+    unsigned int dl_throttled;  // 预算用完，等待下个周期补充
+    unsigned int dl_missed;     // 当前实例已记录过错过截止时间
+    struct timer dl_timer;      // 补充预算的定时器
+    unsigned char fpu_state[FPU_STATE_SIZE] __attribute__((aligned(16))); // FXSAVE区域
 };
 
 // 函数声明
 void initialize_processes();
 void scheduler();
-void create_process(void (*entry_point)());
+int create_process(void (*entry_point)());
 void start_init_process();
 int no_running_processes();
+int process_reap();
+unsigned int process_get_count();
 void switch_to_process(struct process* proc);
+struct process* get_current_process();
+struct process* get_process(unsigned int pid);
+int fork_process();
+void process_yield();
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "profiling.h"
 #include "kernel.h"
 #include "process.h"
+#include "clocksource.h"
 
 // 系统性能统计
 static struct system_stats g_stats;
@@ -29,6 +30,10 @@ void profiling_init() {
     g_stats.network_packets_received = 0;
     g_stats.disk_reads = 0;
     g_stats.disk_writes = 0;
+    g_stats.zero_pool_hits = 0;
+    g_stats.zero_pool_misses = 0;
+    g_stats.zero_pool_refills = 0;
+    g_stats.zero_pool_refill_time = 0;
     
     // 初始化性能计数器
     g_counter_count = 0;
@@ -39,8 +44,8 @@ void profiling_init() {
         g_counters[i].name[0] = '\0';
     }
     
-    // 估算CPU频率（在实际实现中应该通过硬件获取）
-    g_cpu_frequency = 1000000000ULL; // 假设1GHz
+    // 计时使用时钟源的TSC频率；没有TSC时时间戳直接是纳秒，相当于1GHz
+    g_cpu_frequency = clocksource_tsc_available() ? clocksource_get_frequency() : 1000000000ULL;
     
     print_string("Performance profiling subsystem initialized.\n");
 }
@@ -93,9 +98,12 @@ void profiling_print_counter(struct perf_counter* counter) {
     print_string("': ");
     
     char count_str[32];
-    int_to_string(counter->count, count_str);
+    long_long_to_string(counter->count, count_str);
     print_string(count_str);
-    print_string(" cycles\n");
+    print_string(" cycles (");
+    long_long_to_string(profiling_cycles_to_ns(counter->count), count_str);
+    print_string(count_str);
+    print_string(" ns)\n");
 }
 
 // 记录系统统计信息
@@ -164,6 +172,38 @@ void profiling_print_system_stats() {
     int_to_string(g_stats.disk_writes, stat_str);
     print_string(stat_str);
     print_string("\n");
+    
+    unsigned long long zero_requests = g_stats.zero_pool_hits + g_stats.zero_pool_misses;
+    print_string("Zeroed frame pool: ");
+    int_to_string(g_stats.zero_pool_hits, stat_str);
+    print_string(stat_str);
+    print_string(" hits, ");
+    int_to_string(g_stats.zero_pool_misses, stat_str);
+    print_string(stat_str);
+    print_string(" misses");
+    if (zero_requests > 0) {
+        print_string(" (");
+        int_to_string((int)div_u64_u32(g_stats.zero_pool_hits * 100, (unsigned int)zero_requests), stat_str);
+        print_string(stat_str);
+        print_string("% hit rate)");
+    }
+    print_string("\n");
+    
+    print_string("Zeroed frame pool refills: ");
+    int_to_string(g_stats.zero_pool_refills, stat_str);
+    print_string(stat_str);
+    print_string(" frames in ");
+    unsigned long long refill_ns = profiling_cycles_to_ns(g_stats.zero_pool_refill_time);
+    long_long_to_string(div_u64_u32(refill_ns, NSEC_PER_USEC), stat_str);
+    print_string(stat_str);
+    print_string(" us");
+    if (g_stats.zero_pool_refills > 0) {
+        print_string(" (");
+        long_long_to_string(div_u64_u32(refill_ns, (unsigned int)g_stats.zero_pool_refills), stat_str);
+        print_string(stat_str);
+        print_string(" ns per frame)");
+    }
+    print_string("\n");
 }
 
 // 获取系统统计信息
@@ -171,11 +211,20 @@ struct system_stats* profiling_get_system_stats() {
     return &g_stats;
 }
 
-// 获取时间戳
+// 获取时间戳（周期数），没有TSC时为纳秒
 unsigned long long profiling_get_timestamp() {
-    // 在实际实现中，应该使用RDTSC指令或其他高精度计时器
-    static unsigned long long fake_timestamp = 0;
-    return fake_timestamp++;
+    if (clocksource_tsc_available()) {
+        return clocksource_read_cycles();
+    }
+    return ktime_get_ns();
+}
+
+// 时间戳差值（周期数）转纳秒
+unsigned long long profiling_cycles_to_ns(unsigned long long cycles) {
+    if (clocksource_tsc_available()) {
+        return clocksource_cycles_to_ns(cycles);
+    }
+    return cycles;
 }
 
 // 获取CPU频率
@@ -238,6 +287,22 @@ void profiling_disk_write() {
     g_stats.disk_writes++;
 }
 
+// 记录从预清零页帧池取得页帧
+void profiling_zero_pool_hit() {
+    g_stats.zero_pool_hits++;
+}
+
+// 记录池为空时在分配路径上清零页帧
+void profiling_zero_pool_miss() {
+    g_stats.zero_pool_misses++;
+}
+
+// 记录空闲时补充预清零页帧池
+void profiling_zero_pool_refill(unsigned int frames, unsigned long long elapsed) {
+    g_stats.zero_pool_refills += frames;
+    g_stats.zero_pool_refill_time += elapsed;
+}
+
 // 性能优化建议
 void profiling_print_optimization_suggestions() {
     print_string("=== Performance Optimization Suggestions ===\n");
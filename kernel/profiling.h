@@ -28,6 +28,10 @@ struct system_stats {
     unsigned long long network_packets_received;
     unsigned long long disk_reads;
     unsigned long long disk_writes;
+    unsigned long long zero_pool_hits;        // 从预清零页帧池取得页帧的次数
+    unsigned long long zero_pool_misses;      // 池为空、在分配路径上清零的次数
+    unsigned long long zero_pool_refills;     // 空闲时清零并放入池中的页帧数
+    unsigned long long zero_pool_refill_time; // 空闲时补充池所花的总时间
 };
 
 // 函数声明
@@ -41,6 +45,7 @@ void profiling_print_system_stats();
 struct system_stats* profiling_get_system_stats();
 unsigned long long profiling_get_timestamp();
 unsigned long long profiling_get_cpu_frequency();
+unsigned long long profiling_cycles_to_ns(unsigned long long cycles);
 
 // 内存性能统计
 void profiling_memory_alloc(unsigned int size);
@@ -67,10 +72,16 @@ void profiling_network_packet_received();
 void profiling_disk_read();
 void profiling_disk_write();
 
+// 预清零页帧池统计
+void profiling_zero_pool_hit();
+void profiling_zero_pool_miss();
+void profiling_zero_pool_refill(unsigned int frames, unsigned long long elapsed);
+
 // 性能优化
 void profiling_print_optimization_suggestions();
 
 // 辅助函数
 void int_to_string(int value, char* str);
+void long_long_to_string(unsigned long long value, char* str);
 
 #endif
\ No newline at end of file
@@ -2,37 +2,604 @@
 #include "kernel.h"
 #include "process.h"
 #include "profiling.h"
+#include "logger.h"
+#include "clocksource.h"
+#include "spinlock.h"
+#include "smp.h"
+#include "../libs/rbtree.h"
 
-// 进程队列
-static struct process_queue ready_queue[MAX_PRIORITY_LEVELS];
+// 按键值排序的红黑树，缓存最左节点使选择下一个进程为O(1)：
+// 公平类以vruntime为键，截止时间类以绝对截止时间为键
+struct sched_timeline {
+    struct rb_root root;
+    struct rb_node* leftmost;
+    unsigned int count;                 // 树中的进程数
+};
+
+// 每个处理器一个运行队列：各自的优先级就绪队列、就绪位图和当前进程，由队列自己的锁保护。
+// 进程所在的运行队列由proc->cpu记录，只有持有该队列的锁时才能把进程移到别的队列
+struct run_queue {
+    spinlock_t lock;
+    struct process_queue ready_queue[MAX_PRIORITY_LEVELS];
+    
+    // 就绪位图：第p位表示优先级p的就绪队列非空；摘要字的第i位表示ready_bitmap[i]非0，
+    // 选择下一个进程只需两次位扫描
+    unsigned int ready_bitmap[PRIORITY_BITMAP_WORDS];
+    unsigned int ready_summary;
+    
+    // 公平类
+    struct sched_timeline fair_timeline;
+    unsigned int fair_weight;           // 树中进程的权重之和
+    unsigned long long min_vruntime;    // 单调递增的vruntime基准，新建和唤醒的进程以它为起点
+    
+    // 截止时间类：进程不参与窃取和负载均衡，带宽按所在处理器准入
+    struct sched_timeline dl_timeline;
+    unsigned int dl_bw;                 // 已准入的截止时间类带宽之和
+    
+    unsigned int nr_ready;              // 就绪进程数（所有调度类之和）
+    struct process* current;            // 正在运行的进程，0表示空闲
+    unsigned int time_slice_counter;    // 当前进程已运行的时间片计数
+    unsigned int last_balance;          // 上次负载均衡的tick
+    struct sched_cpu_stats stats;
+};
+
+static struct run_queue run_queues[MAX_CPUS];
+
+// 等待队列和终止队列所有处理器共用，由sched_lock保护
 static struct process_queue waiting_queue;
 static struct process_queue terminated_queue;
+static spinlock_t sched_lock = SPINLOCK_INIT;
 
-// 当前运行的进程
-static struct process* current_process = 0;
-
-// 调度器统计信息
+// 调度器统计信息（切换次数等由各处理器的统计汇总）
 static struct scheduler_stats sched_stats;
 
-// 时间片计数器
-static unsigned int time_slice_counter = 0;
+// 可运行（就绪或运行中）的进程数，由scheduler_set_state维护
+static int sched_nr_runnable = 0;
+
+// 公平类和截止时间类计时使用的时钟（纳秒），基准测试可以替换为虚拟时钟
+static unsigned long long (*sched_clock)() = ktime_get_ns;
+
+// nice值到权重的映射（nice -20到19），相邻两级相差约1.25倍，使nice每差1处理器份额约差10%
+static const unsigned int sched_nice_to_weight[SCHED_NICE_MAX - SCHED_NICE_MIN + 1] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15
+};
+
+// 调度跟踪环形缓冲区，默认关闭
+static struct sched_trace_entry sched_trace[SCHED_TRACE_ENTRIES];
+static unsigned int sched_trace_count = 0;
+static int sched_trace_enabled = 0;
+
+// 返回最低的置位位序号（value不能为0）
+static inline unsigned int bit_scan_forward(unsigned int value) {
+    unsigned int index;
+    __asm__ ("bsf %1, %0" : "=r"(index) : "rm"(value));
+    return index;
+}
+
+// 返回最高的置位位序号（value不能为0）
+static inline unsigned int bit_scan_reverse(unsigned int value) {
+    unsigned int index;
+    __asm__ ("bsr %1, %0" : "=r"(index) : "rm"(value));
+    return index;
+}
+
+// 记录一个调度事件，跟踪关闭时只有一次判断；多个处理器同时记录时原子地占用条目
+static inline void sched_trace_record(unsigned int event, struct process* proc, unsigned int arg) {
+    if (!sched_trace_enabled) {
+        return;
+    }
+    
+    unsigned int slot = __sync_fetch_and_add(&sched_trace_count, 1);
+    struct sched_trace_entry* entry = &sched_trace[slot & (SCHED_TRACE_ENTRIES - 1)];
+    entry->timestamp = ktime_get_ns();
+    entry->pid = proc->pid;
+    entry->event = (unsigned short)event;
+    entry->arg = (unsigned short)arg;
+    entry->cpu = smp_processor_id();
+}
+
+// 进程所在的就绪队列下标
+static inline unsigned int sched_priority_index(struct process* proc) {
+    unsigned int priority = proc->priority;
+    if (priority >= MAX_PRIORITY_LEVELS) {
+        priority = MAX_PRIORITY_LEVELS - 1;
+    }
+    return priority;
+}
+
+// 初始化队列
+static void queue_init(struct process_queue* queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->count = 0;
+}
+
+// 添加进程到队列尾部
+static inline void queue_push_tail(struct process_queue* queue, struct process* proc) {
+    proc->next = 0;
+    proc->prev = queue->tail;
+    
+    if (queue->tail) {
+        queue->tail->next = proc;
+    } else {
+        queue->head = proc;
+    }
+    
+    queue->tail = proc;
+    queue->count++;
+}
+
+// 从队列中摘除进程（调用者保证进程在该队列中）
+static inline void queue_remove(struct process_queue* queue, struct process* proc) {
+    if (proc->prev) {
+        proc->prev->next = proc->next;
+    } else {
+        queue->head = proc->next;
+    }
+    
+    if (proc->next) {
+        proc->next->prev = proc->prev;
+    } else {
+        queue->tail = proc->prev;
+    }
+    
+    proc->next = 0;
+    proc->prev = 0;
+    queue->count--;
+}
+
+// 标记优先级priority的就绪队列非空
+static inline void ready_bitmap_set(struct run_queue* rq, unsigned int priority) {
+    rq->ready_bitmap[priority / 32] |= (1u << (priority % 32));
+    rq->ready_summary |= (1u << (priority / 32));
+}
+
+// 优先级priority的就绪队列变空后清除对应位
+static inline void ready_bitmap_clear(struct run_queue* rq, unsigned int priority) {
+    rq->ready_bitmap[priority / 32] &= ~(1u << (priority % 32));
+    if (!rq->ready_bitmap[priority / 32]) {
+        rq->ready_summary &= ~(1u << (priority / 32));
+    }
+}
+
+// nice值对应的权重
+static inline unsigned int sched_weight(int nice) {
+    return sched_nice_to_weight[nice - SCHED_NICE_MIN];
+}
+
+// vruntime的比较：按差值的符号判断，计数回绕后仍然正确
+static inline int vruntime_before(unsigned long long a, unsigned long long b) {
+    return (long long)(a - b) < 0;
+}
+
+static inline struct process* timeline_entry(struct rb_node* node) {
+    return rb_entry(node, struct process, run_node);
+}
+
+// 进程在所属调度类的红黑树中的键值
+static inline unsigned long long timeline_key(struct process* proc) {
+    return proc->sched_class == SCHED_CLASS_DEADLINE ? proc->dl_abs_deadline : proc->vruntime;
+}
+
+static void timeline_init(struct sched_timeline* timeline) {
+    rb_root_init(&timeline->root);
+    timeline->leftmost = 0;
+    timeline->count = 0;
+}
+
+// 按键值插入红黑树，键值相同时排在后面（先入队的先运行）
+static void timeline_insert(struct sched_timeline* timeline, struct process* proc) {
+    struct rb_node** link = &timeline->root.node;
+    struct rb_node* parent = 0;
+    unsigned long long key = timeline_key(proc);
+    int leftmost = 1;
+    
+    while (*link) {
+        parent = *link;
+        if (vruntime_before(key, timeline_key(timeline_entry(parent)))) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    
+    rb_link_node(&proc->run_node, parent, link);
+    rb_insert_color(&proc->run_node, &timeline->root);
+    if (leftmost) {
+        timeline->leftmost = &proc->run_node;
+    }
+    timeline->count++;
+}
+
+static void timeline_remove(struct sched_timeline* timeline, struct process* proc) {
+    if (timeline->leftmost == &proc->run_node) {
+        timeline->leftmost = rb_next(&proc->run_node);
+    }
+    rb_erase(&proc->run_node, &timeline->root);
+    timeline->count--;
+}
+
+// 键值最小的进程，树为空时返回0
+static inline struct process* timeline_first(struct sched_timeline* timeline) {
+    return timeline->leftmost ? timeline_entry(timeline->leftmost) : 0;
+}
+
+// 实际运行时间按权重折算为虚拟运行时间：权重越大，vruntime增长越慢，得到的处理器份额越多
+static inline unsigned long long fair_scale_delta(unsigned long long delta, unsigned int weight) {
+    if (weight == SCHED_NICE_0_WEIGHT) {
+        return delta;
+    }
+    return div_u64_u32(delta * SCHED_NICE_0_WEIGHT, weight);
+}
+
+// 公平类进程本轮的时间片：调度周期按权重在可运行进程（包括proc自己）间分配
+static unsigned long long fair_slice(struct run_queue* rq, struct process* proc) {
+    unsigned int nr_running = rq->fair_timeline.count + 1;
+    unsigned long long period = SCHED_LATENCY_NS;
+    if (nr_running > SCHED_NR_LATENCY) {
+        period = nr_running * SCHED_MIN_GRANULARITY_NS;
+    }
+    return div_u64_u32(period * proc->weight, rq->fair_weight + proc->weight);
+}
+
+// 推进min_vruntime：取正在运行的公平类进程和树中最左进程的较小vruntime，只增不减
+static void fair_update_min_vruntime(struct run_queue* rq, struct process* curr) {
+    unsigned long long vruntime = rq->min_vruntime;
+    
+    if (curr) {
+        vruntime = curr->vruntime;
+    }
+    if (rq->fair_timeline.leftmost) {
+        unsigned long long leftmost = timeline_first(&rq->fair_timeline)->vruntime;
+        if (!curr || vruntime_before(leftmost, vruntime)) {
+            vruntime = leftmost;
+        }
+    }
+    
+    if (vruntime_before(rq->min_vruntime, vruntime)) {
+        rq->min_vruntime = vruntime;
+    }
+}
+
+// 累计正在运行的公平类进程自上次计时以来的运行时间（调用者持有rq->lock）
+static void fair_update_curr(struct run_queue* rq, struct process* curr, unsigned long long now) {
+    if (now <= curr->exec_start) {
+        return;
+    }
+    
+    unsigned long long delta = now - curr->exec_start;
+    curr->exec_start = now;
+    curr->sum_exec_runtime += delta;
+    curr->vruntime += fair_scale_delta(delta, curr->weight);
+    
+    fair_update_min_vruntime(rq, curr);
+}
+
+// 唤醒的进程睡眠期间vruntime没有增长，最多补偿半个调度周期，避免长时间睡眠后独占处理器
+static inline void fair_place_waking(struct run_queue* rq, struct process* proc) {
+    unsigned long long floor = rq->min_vruntime - SCHED_LATENCY_NS / 2;
+    if (vruntime_before(proc->vruntime, floor)) {
+        proc->vruntime = floor;
+    }
+}
+
+// 进程在运行队列间迁移时按两边的min_vruntime平移vruntime，保持它在队列中的相对位置
+static inline void fair_migrate_vruntime(struct process* proc, unsigned long long src_min,
+                                         unsigned long long dst_min) {
+    if (proc->sched_class == SCHED_CLASS_FAIR) {
+        proc->vruntime = proc->vruntime - src_min + dst_min;
+    }
+}
+
+// 截止时间类进程开始一个新的实例：预算补满，截止时间从now起算
+static inline void dl_new_instance(struct process* proc, unsigned long long now) {
+    proc->dl_abs_deadline = now + proc->dl_deadline;
+    proc->dl_budget = (long long)proc->dl_runtime;
+    proc->dl_missed = 0;
+}
+
+// 唤醒的截止时间类进程：截止时间已过，或剩余预算按剩余时间计算的带宽超过了准入的带宽
+// （继续使用旧的截止时间会挤占其他进程）时开始新的实例，否则沿用当前实例（恒定带宽服务器规则）。
+// 两边同时右移10位，避免纳秒数相乘溢出
+static void dl_place_waking(struct process* proc, unsigned long long now) {
+    if (!vruntime_before(now, proc->dl_abs_deadline) || proc->dl_budget <= 0) {
+        dl_new_instance(proc, now);
+        return;
+    }
+    
+    unsigned long long left = proc->dl_abs_deadline - now;
+    if (((unsigned long long)proc->dl_budget >> 10) * (proc->dl_deadline >> 10) >
+        (left >> 10) * (proc->dl_runtime >> 10)) {
+        dl_new_instance(proc, now);
+    }
+}
+
+// 正在运行或等待运行的截止时间类进程已超过截止时间：每个实例只计一次错过，延迟持续更新最大值
+static void dl_check_miss(struct run_queue* rq, struct process* proc, unsigned long long now) {
+    if (!vruntime_before(proc->dl_abs_deadline, now)) {
+        return;
+    }
+    
+    if (!proc->dl_missed) {
+        proc->dl_missed = 1;
+        rq->stats.dl_deadline_misses++;
+    }
+    unsigned long long lateness = now - proc->dl_abs_deadline;
+    if (lateness > rq->stats.dl_max_lateness) {
+        rq->stats.dl_max_lateness = lateness;
+    }
+}
+
+// 扣除正在运行的截止时间类进程自上次计时以来的运行时间（调用者持有rq->lock）
+static void dl_update_curr(struct run_queue* rq, struct process* curr, unsigned long long now) {
+    if (now > curr->exec_start) {
+        unsigned long long delta = now - curr->exec_start;
+        curr->exec_start = now;
+        curr->sum_exec_runtime += delta;
+        curr->dl_budget -= (long long)delta;
+    }
+    dl_check_miss(rq, curr, now);
+}
+
+// 补充预算：按周期推进截止时间，直到超支的部分被补足；补充后截止时间仍已过去时从now开始新的实例
+static void dl_replenish(struct process* proc, unsigned long long now) {
+    while (proc->dl_budget <= 0) {
+        proc->dl_abs_deadline += proc->dl_period;
+        proc->dl_budget += (long long)proc->dl_runtime;
+    }
+    if (vruntime_before(proc->dl_abs_deadline, now)) {
+        dl_new_instance(proc, now);
+    }
+    proc->dl_missed = 0;
+    proc->dl_throttled = 0;
+}
+
+// 将进程加入运行队列（调用者持有rq->lock）
+static inline void rq_enqueue(struct run_queue* rq, struct process* proc) {
+    if (proc->sched_class == SCHED_CLASS_FAIR) {
+        timeline_insert(&rq->fair_timeline, proc);
+        rq->fair_weight += proc->weight;
+    } else if (proc->sched_class == SCHED_CLASS_DEADLINE) {
+        timeline_insert(&rq->dl_timeline, proc);
+    } else {
+        unsigned int priority = sched_priority_index(proc);
+        queue_push_tail(&rq->ready_queue[priority], proc);
+        ready_bitmap_set(rq, priority);
+    }
+    proc->on_rq = 1;
+    rq->nr_ready++;
+    rq->stats.enqueues++;
+}
+
+// 将进程从运行队列摘除（调用者持有rq->lock，且进程在该队列中）
+static inline void rq_remove(struct run_queue* rq, struct process* proc) {
+    if (proc->sched_class == SCHED_CLASS_FAIR) {
+        timeline_remove(&rq->fair_timeline, proc);
+        rq->fair_weight -= proc->weight;
+    } else if (proc->sched_class == SCHED_CLASS_DEADLINE) {
+        timeline_remove(&rq->dl_timeline, proc);
+    } else {
+        unsigned int priority = sched_priority_index(proc);
+        queue_remove(&rq->ready_queue[priority], proc);
+        if (!rq->ready_queue[priority].head) {
+            ready_bitmap_clear(rq, priority);
+        }
+    }
+    proc->on_rq = 0;
+    rq->nr_ready--;
+}
+
+// 下一个应运行的进程：截止时间最早的截止时间类进程，其次是最高优先级实时队列的队首，
+// 最后是vruntime最小的公平类进程
+static inline struct process* rq_pick_first(struct run_queue* rq) {
+    if (rq->dl_timeline.leftmost) {
+        return timeline_first(&rq->dl_timeline);
+    }
+    
+    if (rq->ready_summary) {
+        // 摘要字找到第一个非空的位图字，再在字内找到最高优先级
+        unsigned int word = bit_scan_forward(rq->ready_summary);
+        unsigned int priority = word * 32 + bit_scan_forward(rq->ready_bitmap[word]);
+        return rq->ready_queue[priority].head;
+    }
+    
+    return timeline_first(&rq->fair_timeline);
+}
+
+// 进程开始在本处理器上运行（调用者持有rq->lock）
+static inline void rq_set_current(struct run_queue* rq, struct process* proc, unsigned long long now) {
+    rq->current = proc;
+    rq->time_slice_counter = 0;
+    proc->exec_start = now;
+    proc->prev_sum_exec_runtime = proc->sum_exec_runtime;
+    
+    if (proc->sched_class == SCHED_CLASS_FAIR) {
+        fair_update_min_vruntime(rq, proc);
+    } else if (proc->sched_class == SCHED_CLASS_DEADLINE) {
+        dl_check_miss(rq, proc, now);
+    }
+}
+
+// 累计正在运行的进程的运行时间：公平类推进vruntime，截止时间类扣除预算（调用者持有rq->lock）
+static inline void rq_update_curr(struct run_queue* rq, struct process* curr, unsigned long long now) {
+    if (curr->sched_class == SCHED_CLASS_FAIR) {
+        fair_update_curr(rq, curr, now);
+    } else if (curr->sched_class == SCHED_CLASS_DEADLINE) {
+        dl_update_curr(rq, curr, now);
+    }
+}
+
+// 正在运行的公平类进程是否应该让出处理器：更高调度类的进程就绪，或时间片用完且有其他公平类进程等待
+static inline int fair_should_preempt(struct run_queue* rq, struct process* curr) {
+    if (rq->dl_timeline.leftmost || rq->ready_summary) {
+        return 1;
+    }
+    if (!rq->fair_timeline.leftmost) {
+        return 0;
+    }
+    return curr->sum_exec_runtime - curr->prev_sum_exec_runtime >= fair_slice(rq, curr);
+}
+
+// 正在运行的截止时间类进程是否应该让出处理器：有截止时间更早的进程就绪
+static inline int dl_should_preempt(struct run_queue* rq, struct process* curr) {
+    struct process* first = timeline_first(&rq->dl_timeline);
+    return first && vruntime_before(first->dl_abs_deadline, curr->dl_abs_deadline);
+}
+
+// 预算补充定时器到期：补满预算，进程仍可运行时放回所在处理器的运行队列
+static void dl_replenish_timer(void* data) {
+    struct process* proc = (struct process*)data;
+    unsigned int cpu = proc->cpu;
+    struct run_queue* rq = &run_queues[cpu];
+    
+    spin_lock(&rq->lock);
+    int queued = 0;
+    if (proc->dl_throttled && proc->sched_class == SCHED_CLASS_DEADLINE) {
+        dl_replenish(proc, sched_clock());
+        if (proc->state == PROCESS_READY) {
+            rq_enqueue(rq, proc);
+            queued = 1;
+        }
+    }
+    int idle = rq->current == 0;
+    spin_unlock(&rq->lock);
+    
+    if (queued) {
+        sched_trace_record(SCHED_TRACE_ENQUEUE, proc, sched_priority_index(proc));
+        if (idle) {
+            smp_send_reschedule(cpu);
+        }
+    }
+}
+
+// 截止时间类进程用完本周期的预算：限流到下个周期开始，由定时器补充预算后再入队。
+// 返回0表示定时器堆已满，预算被立即补充，进程可以继续入队（调用者持有rq->lock）
+static int dl_throttle(struct run_queue* rq, struct process* proc, unsigned long long now) {
+    unsigned long long next_period = proc->dl_abs_deadline - proc->dl_deadline + proc->dl_period;
+    unsigned int ticks = 1;
+    if (next_period > now) {
+        ticks = (unsigned int)div_u64_u32(next_period - now + NSEC_PER_MSEC - 1, NSEC_PER_MSEC);
+    }
+    
+    rq->stats.dl_throttles++;
+    proc->dl_throttled = 1;
+    if (timer_add(&proc->dl_timer, get_current_tick() + ticks) != 0) {
+        LOG_WARNING("SCHED", "Timer heap full, deadline budget replenished early");
+        dl_replenish(proc, now);
+        return 0;
+    }
+    return 1;
+}
+
+// 可以迁移的最高优先级进程（跳过上下文尚未保存完的进程），用于空闲窃取。
+// 截止时间类进程的带宽在所在处理器上准入，不参与迁移
+static struct process* rq_first_migratable(struct run_queue* rq) {
+    for (unsigned int word = 0; word < PRIORITY_BITMAP_WORDS; word++) {
+        unsigned int bits = rq->ready_bitmap[word];
+        while (bits) {
+            unsigned int priority = word * 32 + bit_scan_forward(bits);
+            for (struct process* proc = rq->ready_queue[priority].head; proc; proc = proc->next) {
+                if (!proc->on_cpu) {
+                    return proc;
+                }
+            }
+            bits &= bits - 1;
+        }
+    }
+    
+    for (struct rb_node* node = rq->fair_timeline.leftmost; node; node = rb_next(node)) {
+        if (!timeline_entry(node)->on_cpu) {
+            return timeline_entry(node);
+        }
+    }
+    return 0;
+}
+
+// 可以迁移的最不急需运行的进程，用于负载均衡：被拉走的进程对源处理器影响最小。
+// 先找vruntime最大的公平类进程，没有时找最低优先级、最晚入队的实时类进程
+static struct process* rq_last_migratable(struct run_queue* rq) {
+    for (struct rb_node* node = rb_last(&rq->fair_timeline.root); node; node = rb_prev(node)) {
+        if (!timeline_entry(node)->on_cpu) {
+            return timeline_entry(node);
+        }
+    }
+    
+    for (int word = PRIORITY_BITMAP_WORDS - 1; word >= 0; word--) {
+        unsigned int bits = rq->ready_bitmap[word];
+        while (bits) {
+            unsigned int bit = bit_scan_reverse(bits);
+            unsigned int priority = word * 32 + bit;
+            for (struct process* proc = rq->ready_queue[priority].tail; proc; proc = proc->prev) {
+                if (!proc->on_cpu) {
+                    return proc;
+                }
+            }
+            bits &= ~(1u << bit);
+        }
+    }
+    return 0;
+}
+
+// 运行队列的负载：就绪进程数加上正在运行的进程
+static inline unsigned int rq_load(struct run_queue* rq) {
+    return rq->nr_ready + (rq->current ? 1 : 0);
+}
+
+// 初始化运行队列
+static void rq_init(struct run_queue* rq) {
+    spin_lock_init(&rq->lock);
+    
+    for (int i = 0; i < MAX_PRIORITY_LEVELS; i++) {
+        queue_init(&rq->ready_queue[i]);
+    }
+    for (int i = 0; i < PRIORITY_BITMAP_WORDS; i++) {
+        rq->ready_bitmap[i] = 0;
+    }
+    rq->ready_summary = 0;
+    
+    timeline_init(&rq->fair_timeline);
+    rq->fair_weight = 0;
+    rq->min_vruntime = 0;
+    
+    timeline_init(&rq->dl_timeline);
+    rq->dl_bw = 0;
+    
+    rq->nr_ready = 0;
+    rq->current = 0;
+    rq->time_slice_counter = 0;
+    rq->last_balance = 0;
+    
+    rq->stats.context_switches = 0;
+    rq->stats.preemptive_switches = 0;
+    rq->stats.enqueues = 0;
+    rq->stats.idle_selections = 0;
+    rq->stats.steals = 0;
+    rq->stats.balance_runs = 0;
+    rq->stats.balance_pulls = 0;
+    rq->stats.fair_preemptions = 0;
+    rq->stats.dl_throttles = 0;
+    rq->stats.dl_deadline_misses = 0;
+    rq->stats.dl_max_lateness = 0;
+}
 
 // 初始化调度器
 void scheduler_init() {
     // 初始化队列
-    for (int i = 0; i < MAX_PRIORITY_LEVELS; i++) {
-        ready_queue[i].head = 0;
-        ready_queue[i].tail = 0;
-        ready_queue[i].count = 0;
+    for (int i = 0; i < MAX_CPUS; i++) {
+        rq_init(&run_queues[i]);
     }
     
-    waiting_queue.head = 0;
-    waiting_queue.tail = 0;
-    waiting_queue.count = 0;
-    
-    terminated_queue.head = 0;
-    terminated_queue.tail = 0;
-    terminated_queue.count = 0;
+    spin_lock_init(&sched_lock);
+    queue_init(&waiting_queue);
+    queue_init(&terminated_queue);
     
     // 初始化统计信息
     sched_stats.total_context_switches = 0;
@@ -40,71 +607,127 @@ void scheduler_init() {
     sched_stats.voluntary_switches = 0;
     sched_stats.process_created = 0;
     sched_stats.process_terminated = 0;
+    sched_stats.dl_admitted = 0;
+    sched_stats.dl_rejected = 0;
+    sched_stats.dl_deadline_misses = 0;
+    sched_stats.dl_max_lateness = 0;
+    sched_nr_runnable = 0;
     
-    current_process = 0;
-    time_slice_counter = 0;
+    sched_trace_count = 0;
     
     print_string("Advanced scheduler initialized\n");
 }
 
-// 添加进程到就绪队列
+// 添加进程到就绪队列：进入它所在处理器的运行队列（缓存中可能还有它的数据），
+// 该处理器未上线时进入当前处理器的队列；目标处理器空闲时发送调度IPI唤醒它
 void scheduler_add_to_ready(struct process* proc) {
     if (!proc) {
         return;
     }
     
-    // 设置进程状态
-    proc->state = PROCESS_READY;
-    
-    // 获取优先级队列
-    int priority = proc->priority;
-    if (priority >= MAX_PRIORITY_LEVELS) {
-        priority = MAX_PRIORITY_LEVELS - 1;
+    unsigned int cpu = proc->cpu;
+    unsigned int prev_cpu = cpu;
+    if (!smp_cpu_online(cpu)) {
+        cpu = smp_processor_id();
+        proc->cpu = cpu;
     }
+    struct run_queue* rq = &run_queues[cpu];
     
-    // 添加到队列尾部
-    if (ready_queue[priority].tail) {
-        ready_queue[priority].tail->next = proc;
-    } else {
-        ready_queue[priority].head = proc;
+    spin_lock(&rq->lock);
+    
+    // 设置进程状态并添加到所属调度类的就绪队列
+    scheduler_set_state(proc, PROCESS_READY);
+    if (proc->sched_class == SCHED_CLASS_FAIR) {
+        if (cpu != prev_cpu) {
+            fair_migrate_vruntime(proc, run_queues[prev_cpu].min_vruntime, rq->min_vruntime);
+        }
+        fair_place_waking(rq, proc);
+    } else if (proc->sched_class == SCHED_CLASS_DEADLINE) {
+        // 限流中的进程由预算补充定时器放回队列
+        if (proc->dl_throttled) {
+            spin_unlock(&rq->lock);
+            return;
+        }
+        dl_place_waking(proc, sched_clock());
     }
+    rq_enqueue(rq, proc);
+    int idle = rq->current == 0;
     
-    proc->next = 0;
-    ready_queue[priority].tail = proc;
-    ready_queue[priority].count++;
+    spin_unlock(&rq->lock);
     
-    sched_stats.process_created++;
+    sched_trace_record(SCHED_TRACE_ENQUEUE, proc, sched_priority_index(proc));
     
-    print_string("Process ");
-    char pid_str[12];
-    int_to_string(proc->pid, pid_str);
-    print_string(pid_str);
-    print_string(" added to ready queue (priority ");
-    int_to_string(priority, pid_str);
-    print_string(pid_str);
-    print_string(")\n");
+    if (idle) {
+        smp_send_reschedule(cpu);
+    }
 }
 
-// 从就绪队列移除进程
+// 从当前处理器的就绪队列移除最高优先级的进程
 struct process* scheduler_remove_from_ready() {
-    // 按优先级查找进程
-    for (int i = 0; i < MAX_PRIORITY_LEVELS; i++) {
-        if (ready_queue[i].head) {
-            struct process* proc = ready_queue[i].head;
-            ready_queue[i].head = proc->next;
-            
-            if (!ready_queue[i].head) {
-                ready_queue[i].tail = 0;
-            }
-            
-            ready_queue[i].count--;
-            proc->next = 0;
-            
-            return proc;
+    struct run_queue* rq = &run_queues[smp_processor_id()];
+    
+    spin_lock(&rq->lock);
+    struct process* proc = rq_pick_first(rq);
+    if (proc) {
+        rq_remove(rq, proc);
+    }
+    spin_unlock(&rq->lock);
+    
+    if (!proc) {
+        return 0; // 没有就绪进程
+    }
+    
+    sched_trace_record(SCHED_TRACE_DEQUEUE, proc, sched_priority_index(proc));
+    return proc;
+}
+
+// 锁住进程所在的运行队列：进程可能同时被其他处理器迁移，锁住后核对它是否仍在这个运行队列中
+static struct run_queue* sched_lock_task_rq(struct process* proc) {
+    while (1) {
+        unsigned int cpu = proc->cpu;
+        struct run_queue* rq = &run_queues[cpu];
+    
+        spin_lock(&rq->lock);
+        if (proc->cpu == cpu) {
+            return rq;
         }
+        spin_unlock(&rq->lock);
+    }
+}
+
+// 截止时间类进程离开该调度类：释放准入的带宽，取消尚未到期的预算补充（调用者持有rq->lock）。
+// 返回1表示进程正处于限流中且仍可运行，调用者负责将它放回运行队列
+static int dl_release(struct run_queue* rq, struct process* proc) {
+    rq->dl_bw -= proc->dl_bw;
+    proc->dl_bw = 0;
+    if (!proc->dl_throttled) {
+        return 0;
+    }
+    
+    timer_cancel(&proc->dl_timer);
+    proc->dl_throttled = 0;
+    return proc->state == PROCESS_READY;
+}
+
+// 将指定进程从就绪队列中摘除（例如进程被终止时），入队后修改调度属性需通过scheduler_setattr
+void scheduler_dequeue(struct process* proc) {
+    if (!proc || proc->state != PROCESS_READY) {
+        return;
     }
     
-    return 0; // 没有就绪进程
+    struct run_queue* rq = sched_lock_task_rq(proc);
+    
+    // 刚被唤醒、还没放回就绪队列的进程状态已是READY，但不在队列中
+    unsigned int priority = sched_priority_index(proc);
+    int queued = proc->state == PROCESS_READY && proc->on_rq;
+    if (queued) {
+        rq_remove(rq, proc);
+    }
+    spin_unlock(&rq->lock);
+    
+    if (queued) {
+        sched_trace_record(SCHED_TRACE_DEQUEUE, proc, priority);
+    }
 }
 
 // 添加进程到等待队列
@@ -113,138 +736,347 @@ void scheduler_add_to_waiting(struct process* proc) {
         return;
     }
     
-    // 设置进程状态
-    proc->state = PROCESS_WAITING;
+    // 正在运行的进程进入等待前结算本次的运行时间
+    struct run_queue* rq = &run_queues[smp_processor_id()];
+    if (proc->sched_class != SCHED_CLASS_RT && rq->current == proc) {
+        spin_lock(&rq->lock);
+        if (rq->current == proc && proc->state == PROCESS_RUNNING) {
+            rq_update_curr(rq, proc, sched_clock());
+        }
+        spin_unlock(&rq->lock);
+    }
+    
+    spin_lock(&sched_lock);
     
-    // 添加到等待队列尾部
-    if (waiting_queue.tail) {
-        waiting_queue.tail->next = proc;
-    } else {
-        waiting_queue.head = proc;
+    // 设置进程状态并添加到等待队列尾部
+    scheduler_set_state(proc, PROCESS_WAITING);
+    queue_push_tail(&waiting_queue, proc);
+    
+    spin_unlock(&sched_lock);
+    
+    sched_trace_record(SCHED_TRACE_WAIT, proc, 0);
+}
+
+// 把进程从等待队列中取出，返回1表示由调用者负责将它放回就绪队列；
+// 睡眠定时器到期和提前唤醒可能在不同处理器上同时发生，只有一方能取出
+static int sched_take_waiting(struct process* proc) {
+    spin_lock(&sched_lock);
+    if (proc->state != PROCESS_WAITING) {
+        spin_unlock(&sched_lock);
+        return 0;
     }
     
-    proc->next = 0;
-    waiting_queue.tail = proc;
-    waiting_queue.count++;
+    queue_remove(&waiting_queue, proc);
+    scheduler_set_state(proc, PROCESS_READY);
+    spin_unlock(&sched_lock);
     
-    print_string("Process ");
-    char pid_str[12];
-    int_to_string(proc->pid, pid_str);
-    print_string(pid_str);
-    print_string(" added to waiting queue\n");
+    sched_trace_record(SCHED_TRACE_WAKE, proc, 0);
+    return 1;
 }
 
 // 从等待队列移除进程
 void scheduler_remove_from_waiting(struct process* proc) {
+    if (!proc || !sched_take_waiting(proc)) {
+        return; // 进程不在等待队列中
+    }
+    
+    // 被提前唤醒时取消尚未到期的睡眠定时器
+    timer_cancel(&proc->sleep_timer);
+}
+
+// 添加进程到终止队列，进程此前可以在就绪队列或等待队列中
+void scheduler_add_to_terminated(struct process* proc) {
     if (!proc) {
         return;
     }
     
-    // 查找进程在等待队列中的位置
-    struct process* prev = 0;
-    struct process* current = waiting_queue.head;
+    // 就绪的进程先从运行队列摘除，截止时间类进程释放准入的带宽
+    scheduler_dequeue(proc);
+    if (proc->sched_class == SCHED_CLASS_DEADLINE) {
+        struct run_queue* rq = sched_lock_task_rq(proc);
+        dl_release(rq, proc);
+        spin_unlock(&rq->lock);
+    }
+    
+    spin_lock(&sched_lock);
     
-    while (current && current != proc) {
-        prev = current;
-        current = current->next;
+    // 设置进程状态并添加到终止队列尾部
+    int waiting = proc->state == PROCESS_WAITING;
+    if (waiting) {
+        queue_remove(&waiting_queue, proc);
     }
+    scheduler_set_state(proc, PROCESS_STOPPED);
+    queue_push_tail(&terminated_queue, proc);
+    sched_stats.process_terminated++;
     
-    if (!current) {
-        return; // 进程不在等待队列中
+    spin_unlock(&sched_lock);
+    
+    if (waiting) {
+        timer_cancel(&proc->sleep_timer);
     }
     
-    // 从队列中移除
-    if (prev) {
-        prev->next = proc->next;
-    } else {
-        waiting_queue.head = proc->next;
+    sched_trace_record(SCHED_TRACE_TERMINATE, proc, 0);
+}
+
+// 从终止队列取出一个可以回收的进程，没有时返回0。
+// 上下文还没有在处理器上保存完（on_cpu）的进程仍在使用内核栈，留在队列中等下次回收
+struct process* scheduler_take_terminated() {
+    if (terminated_queue.count == 0) {
+        return 0;
     }
     
-    if (waiting_queue.tail == proc) {
-        waiting_queue.tail = prev;
+    spin_lock(&sched_lock);
+    struct process* proc = terminated_queue.head;
+    while (proc && proc->on_cpu) {
+        proc = proc->next;
     }
+    if (proc) {
+        queue_remove(&terminated_queue, proc);
+    }
+    spin_unlock(&sched_lock);
     
-    waiting_queue.count--;
-    proc->next = 0;
+    return proc;
+}
+
+// 修改进程状态并维护可运行进程数。就绪和运行之间的切换不改变计数，调度路径上可以直接赋值
+void scheduler_set_state(struct process* proc, unsigned int state) {
+    int was_runnable = proc->state == PROCESS_RUNNING || proc->state == PROCESS_READY;
+    int runnable = state == PROCESS_RUNNING || state == PROCESS_READY;
     
-    print_string("Process ");
-    char pid_str[12];
-    int_to_string(proc->pid, pid_str);
-    print_string(pid_str);
-    print_string(" removed from waiting queue\n");
+    proc->state = state;
+    if (runnable != was_runnable) {
+        __sync_fetch_and_add(&sched_nr_runnable, runnable - was_runnable);
+    }
 }
 
-// 添加进程到终止队列
-void scheduler_add_to_terminated(struct process* proc) {
+// 可运行（就绪或运行中）的进程数，所有处理器之和
+int scheduler_nr_runnable() {
+    return sched_nr_runnable;
+}
+
+// 找出负载最重且有就绪进程的其他处理器，没有时返回MAX_CPUS（不加锁读取，只作为选择依据）
+static unsigned int sched_find_busiest(unsigned int self, int count_current) {
+    unsigned int busiest = MAX_CPUS;
+    unsigned int max_load = 0;
+    
+    for (unsigned int cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        if (cpu == self || !smp_cpu_online(cpu) || run_queues[cpu].nr_ready == 0) {
+            continue;
+        }
+    
+        unsigned int load = count_current ? rq_load(&run_queues[cpu]) : run_queues[cpu].nr_ready;
+        if (load > max_load) {
+            max_load = load;
+            busiest = cpu;
+        }
+    }
+    
+    return busiest;
+}
+
+// 本地没有就绪进程时从最忙的处理器窃取一个最高优先级的进程，直接在本处理器上运行
+static struct process* scheduler_steal(unsigned int cpu) {
+    unsigned int victim = sched_find_busiest(cpu, 0);
+    if (victim == MAX_CPUS) {
+        return 0;
+    }
+    
+    struct run_queue* src = &run_queues[victim];
+    struct run_queue* rq = &run_queues[cpu];
+    
+    spin_lock(&src->lock);
+    struct process* proc = rq_first_migratable(src);
+    unsigned long long src_min = src->min_vruntime;
+    if (proc) {
+        rq_remove(src, proc);
+        proc->cpu = cpu;
+        proc->state = PROCESS_RUNNING;
+        proc->on_cpu = 1;
+    }
+    spin_unlock(&src->lock);
+    
     if (!proc) {
-        return;
+        return 0;
     }
     
-    // 设置进程状态
-    proc->state = PROCESS_STOPPED;
+    spin_lock(&rq->lock);
+    fair_migrate_vruntime(proc, src_min, rq->min_vruntime);
+    rq_set_current(rq, proc, sched_clock());
+    rq->stats.steals++;
+    spin_unlock(&rq->lock);
     
-    // 添加到终止队列尾部
-    if (terminated_queue.tail) {
-        terminated_queue.tail->next = proc;
-    } else {
-        terminated_queue.head = proc;
+    sched_trace_record(SCHED_TRACE_MIGRATE, proc, victim);
+    return proc;
+}
+
+// 负载均衡：与最忙的处理器相差至少SCHED_IMBALANCE_MIN时，从它那里拉取一半差额的进程。
+// 同时持有两个运行队列的锁，按CPU号从小到大加锁避免死锁
+void scheduler_balance() {
+    unsigned int cpu = smp_processor_id();
+    struct run_queue* rq = &run_queues[cpu];
+    
+    rq->stats.balance_runs++;
+    
+    unsigned int busiest = sched_find_busiest(cpu, 1);
+    if (busiest == MAX_CPUS) {
+        return;
     }
     
-    proc->next = 0;
-    terminated_queue.tail = proc;
-    terminated_queue.count++;
+    struct run_queue* src = &run_queues[busiest];
+    if (rq_load(src) < rq_load(rq) + SCHED_IMBALANCE_MIN) {
+        return;
+    }
     
-    sched_stats.process_terminated++;
+    struct run_queue* first = cpu < busiest ? rq : src;
+    struct run_queue* second = cpu < busiest ? src : rq;
+    spin_lock(&first->lock);
+    spin_lock(&second->lock);
     
-    print_string("Process ");
-    char pid_str[12];
-    int_to_string(proc->pid, pid_str);
-    print_string(pid_str);
-    print_string(" added to terminated queue\n");
+    // 加锁后重新计算差额，期间负载可能已经变化
+    unsigned int src_load = rq_load(src);
+    unsigned int local_load = rq_load(rq);
+    unsigned int pulls = src_load > local_load ? (src_load - local_load) / 2 : 0;
+    
+    while (pulls-- > 0) {
+        struct process* proc = rq_last_migratable(src);
+        if (!proc) {
+            break;
+        }
+    
+        rq_remove(src, proc);
+        proc->cpu = cpu;
+        fair_migrate_vruntime(proc, src->min_vruntime, rq->min_vruntime);
+        rq_enqueue(rq, proc);
+        rq->stats.balance_pulls++;
+    
+        sched_trace_record(SCHED_TRACE_MIGRATE, proc, busiest);
+    }
+    
+    spin_unlock(&second->lock);
+    spin_unlock(&first->lock);
 }
 
-// 调度器主函数
+// 当前处理器的运行队列中是否有就绪进程（空闲前关中断后再检查一次，避免错过调度IPI）
+int scheduler_has_ready() {
+    return run_queues[smp_processor_id()].nr_ready != 0;
+}
+
+// 调度器主函数：在当前处理器的运行队列上选择下一个进程
 struct process* scheduler_select_next() {
-    // 记录上下文切换
-    sched_stats.total_context_switches++;
+    unsigned int cpu = smp_processor_id();
+    struct run_queue* rq = &run_queues[cpu];
+    
     profiling_context_switch();
     
-    // 如果当前进程仍在运行且时间片未用完，继续运行
-    if (current_process && current_process->state == PROCESS_RUNNING) {
-        time_slice_counter++;
-        
-        // 检查时间片是否用完
-        if (time_slice_counter < TIME_SLICE_QUANTUM) {
-            return current_process;
+    // 周期性负载均衡
+    if (smp_num_cpus() > 1) {
+        unsigned int now = get_current_tick();
+        if (now - rq->last_balance >= SCHED_BALANCE_INTERVAL) {
+            rq->last_balance = now;
+            scheduler_balance();
+        }
+    }
+    
+    unsigned long long now = sched_clock();
+    spin_lock(&rq->lock);
+    
+    // 记录上下文切换
+    rq->stats.context_switches++;
+    
+    // 如果当前进程仍在本处理器上运行且时间片未用完，继续运行
+    // （进程睡眠后被唤醒并迁移到其他处理器时，proc->cpu已不是本处理器）
+    struct process* current = rq->current;
+    if (current && current->state == PROCESS_RUNNING && current->cpu == cpu) {
+        // 截止时间类运行到预算用完或有更早的截止时间，实时类按固定的tick数轮转，
+        // 公平类按运行时间和可运行进程数决定的时间片；截止时间类进程就绪时其他调度类立即让出
+        int expired;
+        int throttled = 0;
+        if (current->sched_class == SCHED_CLASS_DEADLINE) {
+            dl_update_curr(rq, current, now);
+            if (current->dl_budget <= 0) {
+                throttled = dl_throttle(rq, current, now);
+                expired = 1;
+            } else {
+                expired = dl_should_preempt(rq, current);
+            }
+        } else if (current->sched_class == SCHED_CLASS_FAIR) {
+            fair_update_curr(rq, current, now);
+            expired = fair_should_preempt(rq, current);
+        } else {
+            rq->time_slice_counter++;
+            expired = rq->time_slice_counter >= TIME_SLICE_QUANTUM || rq->dl_timeline.leftmost;
+        }
+    
+        if (!expired) {
+            current->on_cpu = 1;
+            spin_unlock(&rq->lock);
+            return current;
+        }
+    
+        // 时间片用完，进行抢占式切换，将当前进程放回就绪队列（限流的进程等预算补充后再入队）
+        rq->stats.preemptive_switches++;
+        if (current->sched_class == SCHED_CLASS_FAIR) {
+            rq->stats.fair_preemptions++;
+        }
+        rq->time_slice_counter = 0;
+        current->state = PROCESS_READY;
+        if (!throttled) {
+            rq_enqueue(rq, current);
+            sched_trace_record(SCHED_TRACE_ENQUEUE, current, sched_priority_index(current));
         }
-        
-        // 时间片用完，进行抢占式切换
-        sched_stats.preemptive_switches++;
-        time_slice_counter = 0;
-        
-        // 将当前进程放回就绪队列
-        scheduler_add_to_ready(current_process);
     }
     
     // 选择下一个进程
-    struct process* next_process = scheduler_remove_from_ready();
+    struct process* next_process = rq_pick_first(rq);
     
     if (next_process) {
         // 设置为运行状态
+        rq_remove(rq, next_process);
         next_process->state = PROCESS_RUNNING;
-        current_process = next_process;
-        time_slice_counter = 0;
-        
-        print_string("Switching to process ");
-        char pid_str[12];
-        int_to_string(next_process->pid, pid_str);
-        print_string(pid_str);
-        print_string("\n");
-    } else {
-        current_process = 0;
+        next_process->on_cpu = 1;
+        rq_set_current(rq, next_process, now);
+        spin_unlock(&rq->lock);
+    
+        sched_trace_record(SCHED_TRACE_SWITCH, next_process, sched_priority_index(next_process));
+        return next_process;
     }
     
-    return current_process;
+    rq->current = 0;
+    spin_unlock(&rq->lock);
+    
+    // 本地没有就绪进程，从其他处理器窃取
+    if (smp_num_cpus() > 1) {
+        next_process = scheduler_steal(cpu);
+        if (next_process) {
+            sched_trace_record(SCHED_TRACE_SWITCH, next_process, sched_priority_index(next_process));
+            return next_process;
+        }
+    }
+    
+    rq->stats.idle_selections++;
+    return 0;
+}
+
+// 睡眠定时器到期：将进程从等待队列移回就绪队列
+static void scheduler_sleep_expired(void* data) {
+    struct process* proc = (struct process*)data;
+    
+    if (sched_take_waiting(proc)) {
+        scheduler_add_to_ready(proc);
+    }
+}
+
+// 注册在wake_time到期的睡眠定时器（进程已在等待队列中），定时器堆已满时立即唤醒并返回-1
+static int sched_arm_sleep_timer(struct process* proc) {
+    timer_setup(&proc->sleep_timer, scheduler_sleep_expired, proc);
+    if (timer_add(&proc->sleep_timer, proc->wake_time) != 0) {
+        LOG_WARNING("SCHED", "Timer heap full, sleep skipped");
+        if (sched_take_waiting(proc)) {
+            scheduler_add_to_ready(proc);
+        }
+        return -1;
+    }
+    return 0;
 }
 
 // 进程睡眠
@@ -256,63 +1088,216 @@ void scheduler_sleep(struct process* proc, unsigned int ticks) {
     // 设置唤醒时间
     proc->wake_time = get_current_tick() + ticks;
     
-    // 添加到等待队列
+    // 先加入等待队列再注册睡眠定时器：定时器可能立即在其他处理器上到期。
+    // 定时器堆已满时不睡眠，直接让出处理器
     scheduler_add_to_waiting(proc);
+    sched_arm_sleep_timer(proc);
+}
+
+// 进程进入等待，直到被scheduler_wake_process唤醒；timeout不为0时最多等待timeout个tick。
+// 只改变状态，调用者随后让出处理器。定时器堆已满时进程保持可运行并返回-1
+int scheduler_block(struct process* proc, unsigned int timeout) {
+    if (!proc) {
+        return -1;
+    }
+    
+    scheduler_add_to_waiting(proc);
+    if (timeout == 0) {
+        return 0;
+    }
     
-    print_string("Process ");
-    char pid_str[12];
-    int_to_string(proc->pid, pid_str);
-    print_string(pid_str);
-    print_string(" sleeping for ");
-    int_to_string(ticks, pid_str);
-    print_string(pid_str);
-    print_string(" ticks\n");
+    proc->wake_time = get_current_tick() + timeout;
+    return sched_arm_sleep_timer(proc);
 }
 
-// 唤醒等待的进程
+// 唤醒等待中的进程并放回就绪队列，返回0表示进程不在等待（已被唤醒或超时）
+int scheduler_wake_process(struct process* proc) {
+    if (!proc || !sched_take_waiting(proc)) {
+        return 0;
+    }
+    
+    timer_cancel(&proc->sleep_timer);
+    scheduler_add_to_ready(proc);
+    return 1;
+}
+
+// 唤醒睡眠到期的进程：只处理已到期的定时器，没有到期时只比较一次最近的截止时间
 void scheduler_wake_waiting() {
-    struct process* proc = waiting_queue.head;
-    struct process* prev = 0;
-    
-    while (proc) {
-        // 检查是否应该唤醒
-        if (get_current_tick() >= proc->wake_time) {
-            struct process* next = proc->next;
-            
-            // 从等待队列移除
-            if (prev) {
-                prev->next = next;
-            } else {
-                waiting_queue.head = next;
-            }
-            
-            if (waiting_queue.tail == proc) {
-                waiting_queue.tail = prev;
-            }
-            
-            waiting_queue.count--;
-            
-            // 添加到就绪队列
-            scheduler_add_to_ready(proc);
-            
-            proc = next;
-        } else {
-            prev = proc;
-            proc = proc->next;
+    timer_run_expired(get_current_tick());
+}
+
+// 初始化新进程的调度属性：从父进程继承调度类、优先级和nice值，没有父进程时为nice 0的公平类进程。
+// 带宽预留不能继承，截止时间类进程的子进程为公平类。
+// 公平类进程从所在运行队列的min_vruntime开始，不会因为vruntime从0开始而长时间占用处理器
+void scheduler_init_task(struct process* proc, struct process* parent) {
+    if (parent) {
+        proc->sched_class = parent->sched_class;
+        proc->priority = parent->priority;
+        proc->nice = parent->nice;
+        if (proc->sched_class == SCHED_CLASS_DEADLINE) {
+            proc->sched_class = SCHED_CLASS_FAIR;
+            proc->nice = 0;
+        }
+    } else {
+        proc->sched_class = SCHED_CLASS_FAIR;
+        proc->nice = 0;
+    }
+    proc->weight = sched_weight(proc->nice);
+    proc->on_rq = 0;
+    proc->sum_exec_runtime = 0;
+    proc->prev_sum_exec_runtime = 0;
+    proc->exec_start = 0;
+    proc->dl_bw = 0;
+    proc->dl_throttled = 0;
+    
+    struct run_queue* rq = &run_queues[proc->cpu];
+    spin_lock(&rq->lock);
+    proc->vruntime = rq->min_vruntime;
+    spin_unlock(&rq->lock);
+}
+
+// 修改进程的调度类，value对实时类为优先级（0到MAX_PRIORITY_LEVELS-1），对公平类为nice值
+int scheduler_setscheduler(struct process* proc, unsigned int sched_class, int value) {
+    struct sched_attr attr;
+    attr.sched_policy = sched_class;
+    attr.sched_nice = value;
+    attr.sched_priority = (unsigned int)value;
+    attr.sched_runtime = 0;
+    attr.sched_deadline = 0;
+    attr.sched_period = 0;
+    return scheduler_setattr(proc, &attr);
+}
+
+// 修改进程的调度属性。截止时间类要求0 < runtime <= deadline <= period，并且所在处理器上
+// 已准入的带宽加上runtime / period不超过SCHED_DL_BW_LIMIT，否则拒绝。
+// 进程在就绪队列中时先摘除，按新的属性重新入队；成功返回0，参数无效或准入失败返回-1
+int scheduler_setattr(struct process* proc, const struct sched_attr* attr) {
+    if (!proc || !attr) {
+        return -1;
+    }
+    
+    unsigned int policy = attr->sched_policy;
+    unsigned long long period = attr->sched_period ? attr->sched_period : attr->sched_deadline;
+    unsigned int bw = 0;
+    if (policy == SCHED_CLASS_RT) {
+        if (attr->sched_priority >= MAX_PRIORITY_LEVELS) {
+            return -1;
+        }
+    } else if (policy == SCHED_CLASS_FAIR) {
+        if (attr->sched_nice < SCHED_NICE_MIN || attr->sched_nice > SCHED_NICE_MAX) {
+            return -1;
+        }
+    } else if (policy == SCHED_CLASS_DEADLINE) {
+        if (attr->sched_runtime == 0 || attr->sched_runtime > attr->sched_deadline ||
+            attr->sched_deadline > period || period > SCHED_DL_PERIOD_MAX_NS) {
+            return -1;
+        }
+        bw = (unsigned int)div_u64_u32(attr->sched_runtime << SCHED_DL_BW_SHIFT, (unsigned int)period);
+    } else {
+        return -1;
+    }
+    
+    struct run_queue* rq = sched_lock_task_rq(proc);
+    
+    // 准入控制：替换进程原有的预留后检查总带宽
+    if (policy == SCHED_CLASS_DEADLINE) {
+        unsigned int total = rq->dl_bw - proc->dl_bw + bw;
+        if (total > SCHED_DL_BW_LIMIT) {
+            spin_unlock(&rq->lock);
+            __sync_fetch_and_add(&sched_stats.dl_rejected, 1);
+            return -1;
+        }
+    }
+    
+    unsigned long long now = sched_clock();
+    int running = rq->current == proc && proc->state == PROCESS_RUNNING;
+    int queued = proc->on_rq;
+    if (queued) {
+        rq_remove(rq, proc);
+    }
+    
+    // 正在运行的进程先按原来的属性结算
+    if (running) {
+        rq_update_curr(rq, proc, now);
+    }
+    
+    // 限流中的截止时间类进程取消预算补充，按新的属性直接入队
+    if (proc->sched_class == SCHED_CLASS_DEADLINE && dl_release(rq, proc)) {
+        queued = 1;
+    }
+    
+    if (policy == SCHED_CLASS_FAIR) {
+        if (proc->sched_class != SCHED_CLASS_FAIR) {
+            proc->vruntime = rq->min_vruntime;
         }
+        proc->nice = attr->sched_nice;
+        proc->weight = sched_weight(attr->sched_nice);
+    } else if (policy == SCHED_CLASS_RT) {
+        proc->priority = attr->sched_priority;
+    } else {
+        if (proc->sched_class != SCHED_CLASS_DEADLINE) {
+            __sync_fetch_and_add(&sched_stats.dl_admitted, 1);
+        }
+        proc->dl_runtime = attr->sched_runtime;
+        proc->dl_deadline = attr->sched_deadline;
+        proc->dl_period = period;
+        proc->dl_bw = bw;
+        rq->dl_bw += bw;
+        timer_setup(&proc->dl_timer, dl_replenish_timer, proc);
+        dl_new_instance(proc, now);
+    }
+    proc->sched_class = policy;
+    
+    if (running) {
+        proc->exec_start = now;
+        proc->prev_sum_exec_runtime = proc->sum_exec_runtime;
     }
+    if (queued) {
+        rq_enqueue(rq, proc);
+    }
+    
+    spin_unlock(&rq->lock);
+    return 0;
+}
+
+// 设置公平类计时使用的时钟，传入0时恢复为ktime_get_ns
+void scheduler_set_clock(unsigned long long (*clock)()) {
+    sched_clock = clock ? clock : ktime_get_ns;
 }
 
 // 获取调度器统计信息
 struct scheduler_stats* scheduler_get_stats() {
+    sched_stats.total_context_switches = 0;
+    sched_stats.preemptive_switches = 0;
+    sched_stats.process_created = 0;
+    sched_stats.dl_deadline_misses = 0;
+    sched_stats.dl_max_lateness = 0;
+    
+    for (int i = 0; i < MAX_CPUS; i++) {
+        sched_stats.total_context_switches += run_queues[i].stats.context_switches;
+        sched_stats.preemptive_switches += run_queues[i].stats.preemptive_switches;
+        sched_stats.process_created += run_queues[i].stats.enqueues;
+        sched_stats.dl_deadline_misses += run_queues[i].stats.dl_deadline_misses;
+        if (run_queues[i].stats.dl_max_lateness > sched_stats.dl_max_lateness) {
+            sched_stats.dl_max_lateness = run_queues[i].stats.dl_max_lateness;
+        }
+    }
+    
     return &sched_stats;
 }
 
+// 获取指定处理器的调度统计信息
+struct sched_cpu_stats* scheduler_get_cpu_stats(unsigned int cpu) {
+    return cpu < MAX_CPUS ? &run_queues[cpu].stats : 0;
+}
+
 // 显示调度器统计信息
 void scheduler_print_stats() {
     print_string("=== Scheduler Statistics ===\n");
     
-    char stat_str[16];
+    char stat_str[24];
+    
+    scheduler_get_stats();
     
     print_string("Total context switches: ");
     int_to_string(sched_stats.total_context_switches, stat_str);
@@ -339,13 +1324,42 @@ void scheduler_print_stats() {
     print_string(stat_str);
     print_string("\n");
     
+    print_string("Deadline tasks admitted: ");
+    int_to_string(sched_stats.dl_admitted, stat_str);
+    print_string(stat_str);
+    print_string(", rejected: ");
+    int_to_string(sched_stats.dl_rejected, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Deadline misses: ");
+    int_to_string(sched_stats.dl_deadline_misses, stat_str);
+    print_string(stat_str);
+    print_string(", worst lateness: ");
+    long_long_to_string(div_u64_u32(sched_stats.dl_max_lateness, NSEC_PER_USEC), stat_str);
+    print_string(stat_str);
+    print_string(" us\n");
+    
     // 显示队列状态
+    // 优先级级别较多，只显示非空的就绪队列（优先级:所有处理器上的进程数）
     print_string("Ready queue counts: ");
+    int printed = 0;
     for (int i = 0; i < MAX_PRIORITY_LEVELS; i++) {
-        if (i > 0) print_string(", ");
-        int_to_string(ready_queue[i].count, stat_str);
+        int count = 0;
+        for (unsigned int cpu = 0; cpu < smp_num_cpus(); cpu++) {
+            count += run_queues[cpu].ready_queue[i].count;
+        }
+        if (count == 0) {
+            continue;
+        }
+        if (printed++ > 0) print_string(", ");
+        int_to_string(i, stat_str);
+        print_string(stat_str);
+        print_string(":");
+        int_to_string(count, stat_str);
         print_string(stat_str);
     }
+    if (!printed) print_string("none");
     print_string("\n");
     
     print_string("Waiting queue count: ");
@@ -357,13 +1371,139 @@ void scheduler_print_stats() {
     int_to_string(terminated_queue.count, stat_str);
     print_string(stat_str);
     print_string("\n");
+    
+    print_string("Runnable processes: ");
+    int_to_string(sched_nr_runnable, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    // 每个处理器的运行队列
+    for (unsigned int cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        struct run_queue* rq = &run_queues[cpu];
+        struct process* current = rq->current;
+    
+        print_string("CPU ");
+        int_to_string(cpu, stat_str);
+        print_string(stat_str);
+        if (!smp_cpu_online(cpu)) {
+            print_string(": offline\n");
+            continue;
+        }
+    
+        print_string(": running ");
+        if (current) {
+            int_to_string(current->pid, stat_str);
+            print_string(stat_str);
+        } else {
+            print_string("idle");
+        }
+        print_string(", ready ");
+        int_to_string(rq->nr_ready, stat_str);
+        print_string(stat_str);
+        print_string(", switches ");
+        int_to_string(rq->stats.context_switches, stat_str);
+        print_string(stat_str);
+        print_string(", preemptive ");
+        int_to_string(rq->stats.preemptive_switches, stat_str);
+        print_string(stat_str);
+        print_string(", idle ");
+        int_to_string(rq->stats.idle_selections, stat_str);
+        print_string(stat_str);
+        print_string("\n");
+    
+        print_string("       steals ");
+        int_to_string(rq->stats.steals, stat_str);
+        print_string(stat_str);
+        print_string(", balance runs ");
+        int_to_string(rq->stats.balance_runs, stat_str);
+        print_string(stat_str);
+        print_string(", pulled ");
+        int_to_string(rq->stats.balance_pulls, stat_str);
+        print_string(stat_str);
+        print_string("\n");
+    
+        print_string("       fair ready ");
+        int_to_string(rq->fair_timeline.count, stat_str);
+        print_string(stat_str);
+        print_string(", fair preemptions ");
+        int_to_string(rq->stats.fair_preemptions, stat_str);
+        print_string(stat_str);
+        print_string(", min vruntime ");
+        long_long_to_string(div_u64_u32(rq->min_vruntime, NSEC_PER_USEC), stat_str);
+        print_string(stat_str);
+        print_string(" us\n");
+    
+        // 带宽以千分比显示
+        print_string("       deadline ready ");
+        int_to_string(rq->dl_timeline.count, stat_str);
+        print_string(stat_str);
+        print_string(", bandwidth ");
+        int_to_string((int)(((unsigned long long)rq->dl_bw * 1000) >> SCHED_DL_BW_SHIFT), stat_str);
+        print_string(stat_str);
+        print_string("/1000, throttles ");
+        int_to_string(rq->stats.dl_throttles, stat_str);
+        print_string(stat_str);
+        print_string(", misses ");
+        int_to_string(rq->stats.dl_deadline_misses, stat_str);
+        print_string(stat_str);
+        print_string(", worst lateness ");
+        long_long_to_string(div_u64_u32(rq->stats.dl_max_lateness, NSEC_PER_USEC), stat_str);
+        print_string(stat_str);
+        print_string(" us\n");
+    }
+}
+
+// 开启或关闭调度跟踪，开启时清空之前的记录
+void scheduler_set_trace(int enabled) {
+    if (enabled && !sched_trace_enabled) {
+        sched_trace_count = 0;
+    }
+    sched_trace_enabled = enabled;
 }
 
-// 获取当前tick计数
-unsigned int get_current_tick() {
-    // 在实际实现中，这会从系统时钟获取当前tick
-    static unsigned int tick = 0;
-    return tick++;
+// 输出调度跟踪缓冲区中保留的事件（最多SCHED_TRACE_ENTRIES条，按时间顺序）
+void scheduler_print_trace() {
+    static char* event_names[] = {
+        "enqueue", "dequeue", "switch", "wait", "wake", "terminate", "migrate"
+    };
+    
+    print_string("=== Scheduler Trace ===\n");
+    
+    unsigned int first = 0;
+    if (sched_trace_count > SCHED_TRACE_ENTRIES) {
+        first = sched_trace_count - SCHED_TRACE_ENTRIES;
+    }
+    
+    char str[24];
+    for (unsigned int i = first; i < sched_trace_count; i++) {
+        struct sched_trace_entry* entry = &sched_trace[i & (SCHED_TRACE_ENTRIES - 1)];
+    
+        print_string("[");
+        long_long_to_string(entry->timestamp, str);
+        print_string(str);
+        print_string("] CPU ");
+        int_to_string(entry->cpu, str);
+        print_string(str);
+        print_string(" process ");
+        int_to_string(entry->pid, str);
+        print_string(str);
+        print_string(" ");
+        print_string(event_names[entry->event]);
+    
+        if (entry->event == SCHED_TRACE_ENQUEUE || entry->event == SCHED_TRACE_DEQUEUE ||
+            entry->event == SCHED_TRACE_SWITCH) {
+            print_string(" (priority ");
+            int_to_string(entry->arg, str);
+            print_string(str);
+            print_string(")");
+        } else if (entry->event == SCHED_TRACE_MIGRATE) {
+            print_string(" (from CPU ");
+            int_to_string(entry->arg, str);
+            print_string(str);
+            print_string(")");
+        }
+        print_string("\n");
+    }
 }
 
 // 整数转字符串
@@ -3,12 +3,70 @@
 
 #include "process.h"
 
-// 最大优先级级别数
-#define MAX_PRIORITY_LEVELS 8
+// 最大优先级级别数（0为最高优先级），就绪位图支持32到140级
+#define MAX_PRIORITY_LEVELS 140
+
+#if MAX_PRIORITY_LEVELS < 32 || MAX_PRIORITY_LEVELS > 140
+#error "MAX_PRIORITY_LEVELS must be between 32 and 140"
+#endif
+
+// 就绪位图字数，每位表示对应优先级的就绪队列是否非空
+#define PRIORITY_BITMAP_WORDS ((MAX_PRIORITY_LEVELS + 31) / 32)
+
+// 调度跟踪缓冲区条目数（2的幂）
+#define SCHED_TRACE_ENTRIES 64
+
+// 调度跟踪事件类型
+#define SCHED_TRACE_ENQUEUE   0
+#define SCHED_TRACE_DEQUEUE   1
+#define SCHED_TRACE_SWITCH    2
+#define SCHED_TRACE_WAIT      3
+#define SCHED_TRACE_WAKE      4
+#define SCHED_TRACE_TERMINATE 5
+#define SCHED_TRACE_MIGRATE   6
 
 // 时间片量子（ticks）
 #define TIME_SLICE_QUANTUM 10
 
+// 调度类：截止时间类按最早截止时间优先（EDF）调度，实时类使用按优先级严格调度的就绪队列，
+// 公平类按加权虚拟运行时间分享处理器；高的调度类有就绪进程时低的调度类不会被选中
+#define SCHED_CLASS_RT       0
+#define SCHED_CLASS_FAIR     1
+#define SCHED_CLASS_DEADLINE 2
+
+// 公平类的nice值范围，nice为0的进程权重为SCHED_NICE_0_WEIGHT，nice每差1权重约差1.25倍
+#define SCHED_NICE_MIN -20
+#define SCHED_NICE_MAX 19
+#define SCHED_NICE_0_WEIGHT 1024
+
+// 公平类的调度周期（纳秒）：可运行进程不超过SCHED_NR_LATENCY个时，周期内每个进程都运行一次；
+// 进程更多时周期按每个进程SCHED_MIN_GRANULARITY_NS延长，时间片不会无限缩小
+#define SCHED_LATENCY_NS         6000000ULL
+#define SCHED_MIN_GRANULARITY_NS 750000ULL
+#define SCHED_NR_LATENCY         8
+
+// 截止时间类的带宽为runtime / period，用SCHED_DL_BW_SHIFT位小数的定点数表示；
+// 每个处理器上准入的截止时间类进程带宽之和不超过SCHED_DL_BW_LIMIT（95%），给其他调度类留出时间
+#define SCHED_DL_BW_SHIFT 20
+#define SCHED_DL_BW_LIMIT ((95 << SCHED_DL_BW_SHIFT) / 100)
+
+// 截止时间类周期的上限（纳秒），带宽计算以32位周期为除数
+#define SCHED_DL_PERIOD_MAX_NS 4000000000ULL
+
+// 负载均衡间隔（ticks），以及触发均衡所需的最小负载差
+#define SCHED_BALANCE_INTERVAL 100
+#define SCHED_IMBALANCE_MIN 2
+
+// 调度参数（scheduler_setattr和SYSCALL_SCHED_SETATTR使用）
+struct sched_attr {
+    unsigned int sched_policy;            // 调度类（SCHED_CLASS_*）
+    int sched_nice;                       // 公平类的nice值
+    unsigned int sched_priority;          // 实时类的优先级
+    unsigned long long sched_runtime;     // 截止时间类：每个周期的运行时间（纳秒）
+    unsigned long long sched_deadline;    // 截止时间类：相对截止时间（纳秒）
+    unsigned long long sched_period;      // 截止时间类：周期（纳秒），0表示与截止时间相同
+};
+
 // 进程队列结构
 struct process_queue {
     struct process* head;
@@ -16,6 +74,15 @@ struct process_queue {
     int count;
 };
 
+// 调度跟踪条目：开启跟踪后，入队/出队/切换等操作只在这里记录，由scheduler_print_trace统一输出
+struct sched_trace_entry {
+    unsigned long long timestamp; // 事件发生的时间（开机以来的纳秒数）
+    unsigned int pid;           // 相关进程
+    unsigned short event;       // 事件类型
+    unsigned short arg;         // 附加参数（优先级，迁移时为源处理器）
+    unsigned int cpu;           // 记录事件的处理器
+};
+
 // 调度器统计结构
 struct scheduler_stats {
     unsigned int total_context_switches;  // 总上下文切换次数
@@ -23,20 +90,54 @@ struct scheduler_stats {
     unsigned int voluntary_switches;      // 自愿切换次数
     unsigned int process_created;         // 创建的进程数
     unsigned int process_terminated;      // 终止的进程数
+    unsigned int dl_admitted;             // 准入的截止时间类进程数
+    unsigned int dl_rejected;             // 因带宽不足被拒绝的截止时间类请求数
+    unsigned int dl_deadline_misses;      // 截止时间类错过截止时间的次数
+    unsigned long long dl_max_lateness;   // 截止时间类超过截止时间的最大延迟（纳秒）
+};
+
+// 每个处理器的调度统计
+struct sched_cpu_stats {
+    unsigned int context_switches;        // 调度选择次数
+    unsigned int preemptive_switches;     // 时间片用完被抢占的次数
+    unsigned int enqueues;                // 进入本处理器就绪队列的次数
+    unsigned int idle_selections;         // 没有可运行进程的次数
+    unsigned int steals;                  // 空闲时从其他处理器窃取的进程数
+    unsigned int balance_runs;            // 负载均衡执行次数
+    unsigned int balance_pulls;           // 负载均衡拉取的进程数
+    unsigned int fair_preemptions;        // 公平类进程用完时间片被抢占的次数
+    unsigned int dl_throttles;            // 截止时间类进程用完预算被限流的次数
+    unsigned int dl_deadline_misses;      // 截止时间类进程错过截止时间的次数
+    unsigned long long dl_max_lateness;   // 截止时间类进程超过截止时间的最大延迟（纳秒）
 };
 
 // 函数声明
 void scheduler_init();
 void scheduler_add_to_ready(struct process* proc);
 struct process* scheduler_remove_from_ready();
+void scheduler_dequeue(struct process* proc);
 void scheduler_add_to_waiting(struct process* proc);
 void scheduler_remove_from_waiting(struct process* proc);
 void scheduler_add_to_terminated(struct process* proc);
+struct process* scheduler_take_terminated();
+void scheduler_set_state(struct process* proc, unsigned int state);
+int scheduler_nr_runnable();
 struct process* scheduler_select_next();
 void scheduler_sleep(struct process* proc, unsigned int ticks);
+int scheduler_block(struct process* proc, unsigned int timeout);
+int scheduler_wake_process(struct process* proc);
 void scheduler_wake_waiting();
+void scheduler_balance();
+int scheduler_has_ready();
 struct scheduler_stats* scheduler_get_stats();
+struct sched_cpu_stats* scheduler_get_cpu_stats(unsigned int cpu);
 void scheduler_print_stats();
+void scheduler_set_trace(int enabled);
+void scheduler_print_trace();
+void scheduler_init_task(struct process* proc, struct process* parent);
+int scheduler_setscheduler(struct process* proc, unsigned int sched_class, int value);
+int scheduler_setattr(struct process* proc, const struct sched_attr* attr);
+void scheduler_set_clock(unsigned long long (*clock)());
 
 // 辅助函数
 unsigned int get_current_tick();
@@ -0,0 +1,248 @@
+#include "shm.h"
+#include "kernel.h"
+#include "memory.h"
+#include "logger.h"
+#include "spinlock.h"
+#include "smp.h"
+
+// 命名共享内存段：页帧在创建时全部分配并清零，段本身持有每个页帧的一个引用，
+// 每个映射再各持有一个引用，因此段被删除后已有的映射仍然有效，最后一个映射解除时页帧才归还
+struct shm_segment {
+    char name[SHM_NAME_LEN];    // 空字符串表示空槽
+    unsigned int pages;
+    unsigned int* frames;
+};
+
+static struct shm_segment shm_segments[SHM_MAX_SEGMENTS];
+
+// 共享内存统计
+static struct shm_stats shm_statistics;
+
+// 段表锁：保护段表和统计，中断处理程序不使用共享内存，因此不关中断。持有者会调用虚拟内存接口
+// 并可能等待TLB shootdown应答，等待者自旋期间代为处理发给本处理器的shootdown请求。
+// 加锁顺序为段表锁、虚拟内存锁、堆锁
+static spinlock_t shm_spinlock = SPINLOCK_INIT;
+
+static void shm_lock() {
+    while (!spin_trylock(&shm_spinlock)) {
+        smp_tlb_shootdown_poll();
+        __asm__ volatile ("pause");
+    }
+}
+
+static void shm_unlock() {
+    spin_unlock(&shm_spinlock);
+}
+
+// 比较段名
+static int shm_name_equal(const char* a, const char* b) {
+    for (int i = 0; i < SHM_NAME_LEN; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+        if (a[i] == '\0') {
+            return 1;
+        }
+    }
+    return 1;
+}
+
+// 按名称查找段
+static struct shm_segment* shm_find(const char* name) {
+    for (int i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (shm_segments[i].name[0] != '\0' && shm_name_equal(shm_segments[i].name, name)) {
+            return &shm_segments[i];
+        }
+    }
+    return 0;
+}
+
+// 释放段持有的页帧引用和页帧表
+static void shm_release_frames(struct shm_segment* segment, unsigned int count) {
+    for (unsigned int i = 0; i < count; i++) {
+        vm_free_frame(segment->frames[i]);
+    }
+    free_memory(segment->frames);
+    segment->frames = 0;
+}
+
+// 初始化共享内存管理
+void shm_init() {
+    for (int i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        shm_segments[i].name[0] = '\0';
+        shm_segments[i].pages = 0;
+        shm_segments[i].frames = 0;
+    }
+    
+    shm_statistics.segments = 0;
+    shm_statistics.pages = 0;
+    shm_statistics.attaches = 0;
+    shm_statistics.detaches = 0;
+    
+    print_string("Shared memory IPC initialized\n");
+}
+
+// 创建命名共享内存段（调用者持有段表锁）
+static int shm_create_locked(const char* name, unsigned int size) {
+    if (!name || name[0] == '\0' || size == 0 || size > SHM_MAX_SIZE) {
+        return -1;
+    }
+    
+    // 名称必须能完整存入段表
+    int length = 0;
+    while (name[length] != '\0') {
+        if (++length >= SHM_NAME_LEN) {
+            return -1;
+        }
+    }
+    
+    if (shm_find(name)) {
+        LOG_WARNING("SHM", "Shared memory segment already exists");
+        return -1;
+    }
+    
+    struct shm_segment* segment = 0;
+    for (int i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (shm_segments[i].name[0] == '\0') {
+            segment = &shm_segments[i];
+            break;
+        }
+    }
+    if (!segment) {
+        LOG_ERROR("SHM", "No free shared memory segment slots");
+        return -1;
+    }
+    
+    unsigned int pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    segment->frames = (unsigned int*)allocate_memory(pages * sizeof(unsigned int));
+    if (!segment->frames) {
+        return -1;
+    }
+    
+    // 页帧立即分配，映射时各地址空间直接共享
+    for (unsigned int i = 0; i < pages; i++) {
+        segment->frames[i] = vm_allocate_zeroed_frame();
+        if (segment->frames[i] == 0) {
+            LOG_ERROR("SHM", "Out of memory creating shared memory segment");
+            shm_release_frames(segment, i);
+            return -1;
+        }
+    }
+    
+    for (int i = 0; i <= length; i++) {
+        segment->name[i] = name[i];
+    }
+    segment->pages = pages;
+    
+    shm_statistics.segments++;
+    shm_statistics.pages += pages;
+    return 0;
+}
+
+// 将段映射到地址空间（调用者持有段表锁）
+static unsigned int shm_attach_locked(page_directory_t* page_dir, const char* name, int writable) {
+    if (!page_dir || !name) {
+        return 0;
+    }
+    
+    struct shm_segment* segment = shm_find(name);
+    if (!segment) {
+        return 0;
+    }
+    
+    unsigned int flags = VM_REGION_USER;
+    if (writable) {
+        flags |= VM_REGION_WRITE;
+    }
+    
+    unsigned int addr = vm_map_shared(page_dir, segment->frames, segment->pages, flags);
+    if (addr != 0) {
+        shm_statistics.attaches++;
+    }
+    return addr;
+}
+
+
+// 删除命名段（调用者持有段表锁）
+static int shm_unlink_locked(const char* name) {
+    if (!name) {
+        return -1;
+    }
+    
+    struct shm_segment* segment = shm_find(name);
+    if (!segment) {
+        return -1;
+    }
+    
+    shm_statistics.segments--;
+    shm_statistics.pages -= segment->pages;
+    
+    shm_release_frames(segment, segment->pages);
+    segment->name[0] = '\0';
+    segment->pages = 0;
+    return 0;
+}
+
+// 创建命名共享内存段，成功返回0，名称已存在或资源不足返回-1
+int shm_create(const char* name, unsigned int size) {
+    shm_lock();
+    int result = shm_create_locked(name, size);
+    shm_unlock();
+    return result;
+}
+
+// 将段映射到地址空间，返回映射起始地址，段不存在或映射失败返回0
+unsigned int shm_attach(page_directory_t* page_dir, const char* name, int writable) {
+    shm_lock();
+    unsigned int addr = shm_attach_locked(page_dir, name, writable);
+    shm_unlock();
+    return addr;
+}
+
+// 解除段的映射
+int shm_detach(page_directory_t* page_dir, unsigned int addr) {
+    if (vm_release_region(page_dir, addr) != 0) {
+        return -1;
+    }
+    
+    shm_lock();
+    shm_statistics.detaches++;
+    shm_unlock();
+    return 0;
+}
+
+// 删除命名段：名称立即失效，页帧在最后一个映射解除后归还
+int shm_unlink(const char* name) {
+    shm_lock();
+    int result = shm_unlink_locked(name);
+    shm_unlock();
+    return result;
+}
+
+// 获取共享内存统计信息
+struct shm_stats* shm_get_stats() {
+    return &shm_statistics;
+}
+
+// 显示共享内存统计信息
+void shm_print_stats() {
+    print_string("=== Shared Memory Statistics ===\n");
+    
+    char stat_str[16];
+    
+    print_string("Segments: ");
+    int_to_string(shm_statistics.segments, stat_str);
+    print_string(stat_str);
+    print_string(", pages: ");
+    int_to_string(shm_statistics.pages, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Attaches: ");
+    int_to_string(shm_statistics.attaches, stat_str);
+    print_string(stat_str);
+    print_string(", detaches: ");
+    int_to_string(shm_statistics.detaches, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+}
@@ -0,0 +1,32 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include "vm.h"
+
+// 命名共享内存段数上限
+#define SHM_MAX_SEGMENTS 32
+
+// 段名最大长度（含结尾的'\0'）
+#define SHM_NAME_LEN 32
+
+// 单个段的最大大小（4MB）
+#define SHM_MAX_SIZE (4 * 1024 * 1024)
+
+// 共享内存统计结构
+struct shm_stats {
+    unsigned int segments;      // 当前存在的段数
+    unsigned int pages;         // 这些段占用的页帧数
+    unsigned int attaches;      // 累计映射次数
+    unsigned int detaches;      // 累计解除映射次数
+};
+
+// 函数声明
+void shm_init();
+int shm_create(const char* name, unsigned int size);
+unsigned int shm_attach(page_directory_t* page_dir, const char* name, int writable);
+int shm_detach(page_directory_t* page_dir, unsigned int addr);
+int shm_unlink(const char* name);
+struct shm_stats* shm_get_stats();
+void shm_print_stats();
+
+#endif
@@ -0,0 +1,540 @@
+#include "smp.h"
+#include "kernel.h"
+#include "memory.h"
+#include "vm.h"
+#include "clockevent.h"
+#include "clocksource.h"
+#include "context.h"
+#include "scheduler.h"
+#include "process.h"
+#include "logger.h"
+#include "spinlock.h"
+
+#define SMP_STR_(x) #x
+#define SMP_STR(x) SMP_STR_(x)
+
+// 启动代码复制到SMP_TRAMPOLINE_ADDR后，其中符号的运行地址
+#define SMP_TRAMPOLINE_SYM(label) "(" SMP_STR(SMP_TRAMPOLINE_ADDR) " + " #label " - smp_trampoline_start)"
+
+// AP启动代码：AP收到SIPI后在实模式下从SMP_TRAMPOLINE_ADDR开始执行，装入临时GDT进入保护模式，
+// 按引导处理器的CR4/CR3/CR0开启分页（内核页目录恒等映射了低端物理内存），切换到分配好的栈，
+// 然后调用smp_ap_entry(cpu)。代码与参数区一起被复制到低端内存，只能使用相对于起始处的地址
+__asm__ (
+    ".text\n"
+    ".globl smp_trampoline_start\n"
+    ".globl smp_trampoline_params\n"
+    ".globl smp_trampoline_end\n"
+    ".code16\n"
+    "smp_trampoline_start:\n"
+    "    cli\n"
+    "    xorw %ax, %ax\n"
+    "    movw %ax, %ds\n"
+    "    lgdtl " SMP_TRAMPOLINE_SYM(smp_trampoline_gdtr) "\n"
+    "    movl %cr0, %eax\n"
+    "    orl $1, %eax\n"
+    "    movl %eax, %cr0\n"
+    "    ljmpl $" SMP_STR(SMP_KERNEL_CS) ", $" SMP_TRAMPOLINE_SYM(smp_trampoline_32) "\n"
+    ".code32\n"
+    "smp_trampoline_32:\n"
+    "    movw $" SMP_STR(SMP_KERNEL_DS) ", %ax\n"
+    "    movw %ax, %ds\n"
+    "    movw %ax, %es\n"
+    "    movw %ax, %ss\n"
+    "    movw %ax, %fs\n"
+    "    movw %ax, %gs\n"
+    "    movl " SMP_TRAMPOLINE_SYM(smp_trampoline_params) " + 4, %eax\n"     // cr4（PSE/PGE须在开启分页前设置）
+    "    movl %eax, %cr4\n"
+    "    movl " SMP_TRAMPOLINE_SYM(smp_trampoline_params) ", %eax\n"         // cr3
+    "    movl %eax, %cr3\n"
+    "    movl " SMP_TRAMPOLINE_SYM(smp_trampoline_params) " + 8, %eax\n"     // cr0
+    "    movl %eax, %cr0\n"
+    "    movl " SMP_TRAMPOLINE_SYM(smp_trampoline_params) " + 12, %esp\n"    // stack
+    "    pushl " SMP_TRAMPOLINE_SYM(smp_trampoline_params) " + 20\n"         // cpu
+    "    call *" SMP_TRAMPOLINE_SYM(smp_trampoline_params) " + 16\n"         // entry
+    "1:  hlt\n"
+    "    jmp 1b\n"
+    ".align 8\n"
+    "smp_trampoline_gdt:\n"
+    "    .quad 0\n"
+    "    .quad 0x00CF9A000000FFFF\n"
+    "    .quad 0x00CF92000000FFFF\n"
+    "smp_trampoline_gdtr:\n"
+    "    .word 23\n"
+    "    .long " SMP_TRAMPOLINE_SYM(smp_trampoline_gdt) "\n"
+    ".align 4\n"
+    "smp_trampoline_params:\n"
+    "    .fill 6, 4, 0\n"
+    "smp_trampoline_end:\n"
+);
+
+extern unsigned char smp_trampoline_start[];
+extern unsigned char smp_trampoline_params[];
+extern unsigned char smp_trampoline_end[];
+
+// 启动代码参数区，布局与上面的偏移一致
+struct smp_trampoline_params {
+    unsigned int cr3;
+    unsigned int cr4;
+    unsigned int cr0;
+    unsigned int stack;
+    unsigned int entry;
+    unsigned int cpu;
+};
+
+// ACPI表结构（只用到找出处理器所需的部分）
+struct acpi_rsdp {
+    char signature[8];          // "RSD PTR "
+    unsigned char checksum;
+    char oem_id[6];
+    unsigned char revision;
+    unsigned int rsdt_address;
+} __attribute__((packed));
+
+struct acpi_sdt_header {
+    char signature[4];
+    unsigned int length;
+    unsigned char revision;
+    unsigned char checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    unsigned int oem_revision;
+    unsigned int creator_id;
+    unsigned int creator_revision;
+} __attribute__((packed));
+
+// MADT：表头后是本地APIC地址和标志，之后是变长的中断控制器条目
+struct acpi_madt {
+    struct acpi_sdt_header header;
+    unsigned int lapic_address;
+    unsigned int flags;
+} __attribute__((packed));
+
+// MADT类型0条目：处理器本地APIC
+#define ACPI_MADT_LAPIC 0
+#define ACPI_MADT_LAPIC_ENABLED 0x1
+
+struct acpi_madt_lapic {
+    unsigned char type;
+    unsigned char length;
+    unsigned char processor_id;
+    unsigned char apic_id;
+    unsigned int flags;
+} __attribute__((packed));
+
+// GDTR
+struct gdt_pointer {
+    unsigned short limit;
+    unsigned int base;
+} __attribute__((packed));
+
+// 每个处理器的私有数据
+static struct cpu_data cpu_table[MAX_CPUS];
+
+// 已分配的CPU号数量（含启动失败的），以及已上线的处理器数
+static volatile unsigned int cpu_count = 1;
+static volatile unsigned int cpus_online = 1;
+
+// 当前的TLB shootdown请求：地址范围和尚未应答的处理器位图，由tlb_shootdown_lock串行化
+static spinlock_t tlb_shootdown_lock = SPINLOCK_INIT;
+static volatile unsigned int tlb_shootdown_addr;
+static volatile unsigned int tlb_shootdown_pages;
+static volatile unsigned int tlb_shootdown_pending;
+
+// 内核GDT
+static unsigned long long smp_gdt[SMP_GDT_ENTRIES] __attribute__((aligned(8)));
+
+void smp_ap_entry(unsigned int cpu);
+
+// 构造段描述符
+static unsigned long long gdt_entry(unsigned int base, unsigned int limit, unsigned int access, unsigned int flags) {
+    unsigned long long entry = limit & 0xFFFF;
+    entry |= (unsigned long long)(base & 0xFFFFFF) << 16;
+    entry |= (unsigned long long)(access & 0xFF) << 40;
+    entry |= (unsigned long long)((limit >> 16) & 0xF) << 48;
+    entry |= (unsigned long long)(flags & 0xF) << 52;
+    entry |= (unsigned long long)((base >> 24) & 0xFF) << 56;
+    return entry;
+}
+
+// 装入内核GDT，重新加载段寄存器，GS指向cpu的私有数据
+static void smp_load_gdt(unsigned int cpu) {
+    struct gdt_pointer gdtr;
+    gdtr.limit = sizeof(smp_gdt) - 1;
+    gdtr.base = (unsigned int)smp_gdt;
+    
+    __asm__ volatile (
+        "lgdt %0\n"
+        "ljmp $" SMP_STR(SMP_KERNEL_CS) ", $1f\n"
+        "1:\n"
+        "movw %w1, %%ds\n"
+        "movw %w1, %%es\n"
+        "movw %w1, %%fs\n"
+        "movw %w1, %%ss\n"
+        "movw %w2, %%gs\n"
+        :
+        : "m"(gdtr), "r"(SMP_KERNEL_DS), "r"(SMP_PERCPU_SELECTOR(cpu))
+        : "memory"
+    );
+}
+
+// 忙等待指定的微秒数（基于TSC时钟源）
+static void smp_delay_us(unsigned int us) {
+    unsigned long long start = ktime_get_ns();
+    unsigned long long wait = (unsigned long long)us * NSEC_PER_USEC;
+    while (ktime_get_ns() - start < wait) {
+        __asm__ volatile ("pause");
+    }
+}
+
+// ACPI表校验和：所有字节之和为0
+static int acpi_checksum_ok(const void* table, unsigned int length) {
+    const unsigned char* bytes = (const unsigned char*)table;
+    unsigned char sum = 0;
+    for (unsigned int i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+// 确保物理区间可以直接访问：恒等映射范围之外的页按需映射到内核页目录
+static void acpi_map(unsigned int address, unsigned int length) {
+    unsigned int page = address & ~(PAGE_SIZE - 1);
+    unsigned int end = address + length;
+    for (; page < end; page += PAGE_SIZE) {
+        if (page >= PHYSICAL_MEMORY_SIZE) {
+            vm_map_page(vm_get_kernel_directory(), page, page, 0, 0);
+        }
+    }
+}
+
+// 在[start, end)中按16字节边界查找RSDP
+static struct acpi_rsdp* acpi_scan_rsdp(unsigned int start, unsigned int end) {
+    for (unsigned int addr = start; addr + sizeof(struct acpi_rsdp) <= end; addr += 16) {
+        const char* p = (const char*)addr;
+        if (p[0] == 'R' && p[1] == 'S' && p[2] == 'D' && p[3] == ' ' &&
+            p[4] == 'P' && p[5] == 'T' && p[6] == 'R' && p[7] == ' ' &&
+            acpi_checksum_ok(p, sizeof(struct acpi_rsdp))) {
+            return (struct acpi_rsdp*)addr;
+        }
+    }
+    return 0;
+}
+
+// RSDP位于EBDA的前1KB或BIOS只读区0xE0000-0xFFFFF
+static struct acpi_rsdp* acpi_find_rsdp() {
+    // BIOS数据区0x40E处是EBDA的段地址
+    unsigned int ebda;
+    __asm__ volatile ("movzwl 0x40E, %0" : "=r"(ebda));
+    ebda <<= 4;
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        struct acpi_rsdp* rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+        if (rsdp) {
+            return rsdp;
+        }
+    }
+    return acpi_scan_rsdp(0xE0000, 0x100000);
+}
+
+// 从MADT中找出所有已启用处理器的APIC ID，返回数量
+static unsigned int acpi_find_cpus(unsigned int* apic_ids, unsigned int max) {
+    struct acpi_rsdp* rsdp = acpi_find_rsdp();
+    if (!rsdp || rsdp->rsdt_address == 0) {
+        return 0;
+    }
+    
+    acpi_map(rsdp->rsdt_address, sizeof(struct acpi_sdt_header));
+    struct acpi_sdt_header* rsdt = (struct acpi_sdt_header*)rsdp->rsdt_address;
+    acpi_map(rsdp->rsdt_address, rsdt->length);
+    if (!acpi_checksum_ok(rsdt, rsdt->length)) {
+        return 0;
+    }
+    
+    unsigned int tables = (rsdt->length - sizeof(struct acpi_sdt_header)) / 4;
+    unsigned int* entries = (unsigned int*)(rsdt + 1);
+    
+    for (unsigned int i = 0; i < tables; i++) {
+        acpi_map(entries[i], sizeof(struct acpi_sdt_header));
+        struct acpi_sdt_header* table = (struct acpi_sdt_header*)entries[i];
+        if (table->signature[0] != 'A' || table->signature[1] != 'P' ||
+            table->signature[2] != 'I' || table->signature[3] != 'C') {
+            continue;
+        }
+    
+        acpi_map(entries[i], table->length);
+        if (!acpi_checksum_ok(table, table->length)) {
+            return 0;
+        }
+    
+        unsigned int count = 0;
+        unsigned char* entry = (unsigned char*)table + sizeof(struct acpi_madt);
+        unsigned char* end = (unsigned char*)table + table->length;
+        while (entry + 2 <= end && entry[1] >= 2) {
+            struct acpi_madt_lapic* lapic = (struct acpi_madt_lapic*)entry;
+            if (lapic->type == ACPI_MADT_LAPIC && (lapic->flags & ACPI_MADT_LAPIC_ENABLED) && count < max) {
+                apic_ids[count++] = lapic->apic_id;
+            }
+            entry += entry[1];
+        }
+        return count;
+    }
+    
+    return 0;
+}
+
+// 向目标APIC发送处理器间中断，等待发送完成
+static void lapic_send_ipi(unsigned int apic_id, unsigned int command) {
+    lapic_write_register(LAPIC_REG_ICR_HIGH, apic_id << 24);
+    lapic_write_register(LAPIC_REG_ICR_LOW, command);
+    while (lapic_read_register(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile ("pause");
+    }
+}
+
+// 用INIT-SIPI-SIPI序列启动一个AP，等待它上线，成功返回0
+static int smp_boot_ap(unsigned int cpu, unsigned int apic_id) {
+    void* stack = allocate_memory(KERNEL_STACK_SIZE);
+    if (!stack) {
+        return -1;
+    }
+    
+    struct cpu_data* data = &cpu_table[cpu];
+    data->apic_id = apic_id;
+    data->idle_stack = stack;
+    data->online = 0;
+    
+    // 启动代码一次只服务一个AP，参数区在复制后的位置上填写
+    struct smp_trampoline_params* params = (struct smp_trampoline_params*)
+        (SMP_TRAMPOLINE_ADDR + (smp_trampoline_params - smp_trampoline_start));
+    unsigned int value;
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(value));
+    params->cr3 = value;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(value));
+    params->cr4 = value;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(value));
+    params->cr0 = value;
+    params->stack = (unsigned int)stack + KERNEL_STACK_SIZE;
+    params->entry = (unsigned int)smp_ap_entry;
+    params->cpu = cpu;
+    
+    // CPU号一经分配不再复用：超时后才上线的AP也不会与后面的AP冲突
+    cpu_count = cpu + 1;
+    
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT);
+    smp_delay_us(10000);
+    
+    for (int attempt = 0; attempt < 2 && !data->online; attempt++) {
+        lapic_send_ipi(apic_id, LAPIC_ICR_STARTUP | (SMP_TRAMPOLINE_ADDR >> 12));
+        smp_delay_us(200);
+    }
+    
+    unsigned long long deadline = ktime_get_ns() + (unsigned long long)SMP_AP_TIMEOUT_MS * NSEC_PER_MSEC;
+    while (!data->online && ktime_get_ns() < deadline) {
+        __asm__ volatile ("pause");
+    }
+    
+    return data->online ? 0 : -1;
+}
+
+// AP的调度循环：与引导处理器的scheduler_loop相同，但空闲时只停机等待本地APIC的周期tick
+// 或调度IPI，不做无tick空闲和页帧预清零。进程在AP上使用的内核堆、虚拟内存和共享内存
+// 各自有锁（见memory.c、vm.c、shm.c）
+static void smp_ap_loop() {
+    while (1) {
+        scheduler_wake_waiting();
+    
+        struct process* next = scheduler_select_next();
+        if (next) {
+            switch_to_process(next);
+            continue;
+        }
+    
+        // 关中断后再检查一次，避免检查之后到达的调度IPI被停机错过
+        __asm__ volatile ("cli");
+        if (scheduler_has_ready()) {
+            __asm__ volatile ("sti");
+        } else {
+            __asm__ volatile ("sti; hlt");
+        }
+    }
+}
+
+// AP进入内核后的第一个C函数，运行在启动代码分配的栈上，不返回
+void smp_ap_entry(unsigned int cpu) {
+    smp_load_gdt(cpu);
+    context_ap_init();
+    clockevent_ap_init();
+    
+    cpu_table[cpu].online = 1;
+    __sync_fetch_and_add(&cpus_online, 1);
+    
+    __asm__ volatile ("sti");
+    smp_ap_loop();
+}
+
+// 尽早调用：装入内核GDT，引导处理器的GS指向cpu_table[0]，之后smp_processor_id()可用
+void smp_early_init() {
+    smp_gdt[0] = 0;
+    smp_gdt[1] = gdt_entry(0, 0xFFFFF, 0x9A, 0xC);  // 代码段：4KB粒度、32位
+    smp_gdt[2] = gdt_entry(0, 0xFFFFF, 0x92, 0xC);  // 数据段
+    
+    for (unsigned int i = 0; i < MAX_CPUS; i++) {
+        cpu_table[i].self = &cpu_table[i];
+        cpu_table[i].id = i;
+        cpu_table[i].apic_id = 0;
+        cpu_table[i].online = 0;
+        cpu_table[i].idle_stack = 0;
+        smp_gdt[3 + i] = gdt_entry((unsigned int)&cpu_table[i], sizeof(struct cpu_data) - 1, 0x92, 0x4);
+    }
+    
+    cpu_table[0].online = 1;
+    cpu_count = 1;
+    cpus_online = 1;
+    
+    smp_load_gdt(0);
+}
+
+// 通过ACPI MADT找出其余处理器并逐个启动；需要本地APIC和TSC时钟源（用于启动时序的延时）
+void smp_init() {
+    if (!lapic_available() || !clocksource_tsc_available()) {
+        LOG_INFO("SMP", "Local APIC or TSC unavailable, running on one CPU");
+        print_string("SMP: 1 CPU\n");
+        return;
+    }
+    
+    cpu_table[0].apic_id = lapic_read_register(LAPIC_REG_ID) >> 24;
+    
+    unsigned int apic_ids[MAX_CPUS * 4];
+    unsigned int found = acpi_find_cpus(apic_ids, MAX_CPUS * 4);
+    
+    if (found > 1) {
+        // 启动代码复制到低端内存（低4MB不交给页帧分配器）
+        unsigned int size = smp_trampoline_end - smp_trampoline_start;
+        unsigned char* dest = (unsigned char*)SMP_TRAMPOLINE_ADDR;
+        for (unsigned int i = 0; i < size; i++) {
+            dest[i] = smp_trampoline_start[i];
+        }
+    }
+    
+    for (unsigned int i = 0; i < found && cpu_count < MAX_CPUS; i++) {
+        if (apic_ids[i] == cpu_table[0].apic_id) {
+            continue;
+        }
+    
+        if (smp_boot_ap(cpu_count, apic_ids[i]) != 0) {
+            LOG_WARNING("SMP", "Application processor failed to start");
+        }
+    }
+    
+    char str[16];
+    print_string("SMP: ");
+    int_to_string(cpus_online, str);
+    print_string(str);
+    print_string(" CPU(s) online\n");
+}
+
+// 已分配的CPU号数量，遍历每CPU数据时以此为上界（其中个别CPU可能未上线）
+unsigned int smp_num_cpus() {
+    return cpu_count;
+}
+
+// 获取处理器的私有数据
+struct cpu_data* smp_get_cpu(unsigned int cpu) {
+    return cpu < MAX_CPUS ? &cpu_table[cpu] : 0;
+}
+
+// 处理器是否已上线
+int smp_cpu_online(unsigned int cpu) {
+    return cpu < cpu_count && cpu_table[cpu].online;
+}
+
+// 唤醒空闲的处理器，使它重新检查运行队列
+void smp_send_reschedule(unsigned int cpu) {
+    if (cpu == smp_processor_id() || !smp_cpu_online(cpu)) {
+        return;
+    }
+    lapic_send_ipi(cpu_table[cpu].apic_id, SMP_RESCHEDULE_VECTOR);
+}
+
+// 调度IPI：只用于把目标处理器从hlt中唤醒，应答即可
+void smp_reschedule_interrupt() {
+    lapic_write_register(LAPIC_REG_EOI, 0);
+}
+
+// 刷新本处理器TLB中请求的地址范围，并清除自己的待应答位
+static void smp_tlb_shootdown_ack() {
+    vm_flush_tlb_local(tlb_shootdown_addr, tlb_shootdown_pages);
+    __sync_fetch_and_and(&tlb_shootdown_pending, ~(1u << smp_processor_id()));
+}
+
+// 让cpu_mask中的其他处理器刷新TLB中从virtual_addr开始的pages页，等到它们都完成后返回。
+// 调用者已经修改了页表，返回后被撤销映射的页帧不会再被其他处理器通过旧的TLB条目访问，可以释放。
+// 同一时刻只有一个请求；等待请求锁时可能正在缺页处理中（关中断），因此一边等待一边代为处理发给自己的请求
+void smp_tlb_shootdown(unsigned int cpu_mask, unsigned int virtual_addr, unsigned int pages) {
+    unsigned int self = smp_processor_id();
+    unsigned int targets = 0;
+    for (unsigned int cpu = 0; cpu < cpu_count; cpu++) {
+        if (cpu != self && (cpu_mask & (1u << cpu)) && smp_cpu_online(cpu)) {
+            targets |= 1u << cpu;
+        }
+    }
+    if (!targets) {
+        return;
+    }
+    
+    while (!spin_trylock(&tlb_shootdown_lock)) {
+        if (tlb_shootdown_pending & (1u << self)) {
+            smp_tlb_shootdown_ack();
+        }
+        __asm__ volatile ("pause");
+    }
+    
+    // 参数先于待应答位写好，目标处理器收到IPI时读到的一定是本次请求
+    tlb_shootdown_addr = virtual_addr;
+    tlb_shootdown_pages = pages;
+    tlb_shootdown_pending = targets;
+    for (unsigned int cpu = 0; cpu < cpu_count; cpu++) {
+        if (targets & (1u << cpu)) {
+            lapic_send_ipi(cpu_table[cpu].apic_id, SMP_TLB_SHOOTDOWN_VECTOR);
+        }
+    }
+    
+    while (tlb_shootdown_pending) {
+        __asm__ volatile ("pause");
+    }
+    spin_unlock(&tlb_shootdown_lock);
+}
+
+// 关中断自旋等待其他锁时调用：有发给本处理器的TLB shootdown请求就代为处理，
+// 锁的持有者可能正在等本处理器应答
+void smp_tlb_shootdown_poll() {
+    if (tlb_shootdown_pending & (1u << smp_processor_id())) {
+        smp_tlb_shootdown_ack();
+    }
+}
+
+// TLB shootdown IPI：刷新后应答发起方
+void smp_tlb_shootdown_interrupt() {
+    smp_tlb_shootdown_ack();
+    lapic_write_register(LAPIC_REG_EOI, 0);
+}
+
+// 显示处理器信息
+void smp_print_info() {
+    print_string("=== SMP ===\n");
+    
+    char str[16];
+    print_string("CPUs online: ");
+    int_to_string(cpus_online, str);
+    print_string(str);
+    print_string("\n");
+    
+    for (unsigned int i = 0; i < cpu_count; i++) {
+        print_string("CPU ");
+        int_to_string(i, str);
+        print_string(str);
+        print_string(": APIC ID ");
+        int_to_string(cpu_table[i].apic_id, str);
+        print_string(str);
+        print_string(cpu_table[i].online ? ", online\n" : ", offline\n");
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef SMP_H
+#define SMP_H
+
+// 支持的最大处理器数
+#define MAX_CPUS 8
+
+// AP启动代码的物理地址（4KB对齐，低于1MB），SIPI向量为其页号
+#define SMP_TRAMPOLINE_ADDR 0x8000
+
+// 内核GDT中的段选择子：平坦代码段、平坦数据段，之后每个CPU一个以其cpu_data为基址的段（装入GS）
+#define SMP_KERNEL_CS 0x08
+#define SMP_KERNEL_DS 0x10
+#define SMP_PERCPU_SELECTOR(cpu) (0x18 + (cpu) * 8)
+#define SMP_GDT_ENTRIES (3 + MAX_CPUS)
+
+// 本地APIC中断命令寄存器
+#define LAPIC_REG_ID        0x020
+#define LAPIC_REG_ICR_LOW   0x300
+#define LAPIC_REG_ICR_HIGH  0x310
+#define LAPIC_ICR_INIT      0x00004500   // INIT，电平触发有效
+#define LAPIC_ICR_STARTUP   0x00004600   // Startup IPI，低8位为启动地址的页号
+#define LAPIC_ICR_PENDING   0x00001000   // 发送中
+
+// 调度IPI向量：唤醒空闲的处理器检查运行队列
+#define SMP_RESCHEDULE_VECTOR 0xF1
+
+// TLB shootdown IPI向量：让其他处理器刷新TLB中被修改的映射
+#define SMP_TLB_SHOOTDOWN_VECTOR 0xF2
+
+// 等待AP上线的时间（毫秒）
+#define SMP_AP_TIMEOUT_MS 100
+
+// 每个处理器的私有数据，GS段的基址指向它
+struct cpu_data {
+    struct cpu_data* self;      // 指向自身，用于从GS取得指针
+    unsigned int id;            // 逻辑CPU号（0为引导处理器）
+    unsigned int apic_id;       // 本地APIC ID
+    volatile unsigned int online; // 已完成初始化、开始调度
+    void* idle_stack;           // AP调度循环使用的栈（KERNEL_STACK_SIZE字节）
+};
+
+// 当前处理器的逻辑CPU号，必须在smp_early_init之后使用
+static inline unsigned int smp_processor_id() {
+    unsigned int id;
+    __asm__ volatile ("movl %%gs:%c1, %0" : "=r"(id) : "i"(__builtin_offsetof(struct cpu_data, id)));
+    return id;
+}
+
+// 函数声明
+void smp_early_init();
+void smp_init();
+unsigned int smp_num_cpus();
+struct cpu_data* smp_get_cpu(unsigned int cpu);
+int smp_cpu_online(unsigned int cpu);
+void smp_send_reschedule(unsigned int cpu);
+void smp_reschedule_interrupt();
+void smp_tlb_shootdown(unsigned int cpu_mask, unsigned int virtual_addr, unsigned int pages);
+void smp_tlb_shootdown_interrupt();
+void smp_tlb_shootdown_poll();
+void smp_print_info();
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+// 自旋锁：用xchg原子地置位，竞争时先只读自旋（pause），避免持续的总线锁定。
+// 只在调度循环和进程上下文中获取的锁用spin_lock，不需要关中断；
+// 中断处理程序也会获取的锁（如内核堆锁）用spin_lock_irqsave，否则持有者被本处理器的中断打断后会死锁
+typedef struct {
+    volatile unsigned int locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_lock_init(spinlock_t* lock) {
+    lock->locked = 0;
+}
+
+static inline void spin_lock(spinlock_t* lock) {
+    unsigned int value = 1;
+    while (1) {
+        __asm__ volatile ("xchgl %0, %1" : "+r"(value), "+m"(lock->locked) : : "memory");
+        if (value == 0) {
+            return;
+        }
+        while (lock->locked) {
+            __asm__ volatile ("pause");
+        }
+        value = 1;
+    }
+}
+
+// 尝试获取锁，成功返回1
+static inline int spin_trylock(spinlock_t* lock) {
+    unsigned int value = 1;
+    __asm__ volatile ("xchgl %0, %1" : "+r"(value), "+m"(lock->locked) : : "memory");
+    return value == 0;
+}
+
+// x86的存储不会与更早的读写重排，释放只需编译器屏障
+static inline void spin_unlock(spinlock_t* lock) {
+    __asm__ volatile ("" : : : "memory");
+    lock->locked = 0;
+}
+
+// 关中断后获取锁，返回原来的EFLAGS，交给spin_unlock_irqrestore恢复
+static inline unsigned int spin_lock_irqsave(spinlock_t* lock) {
+    unsigned int flags;
+    __asm__ volatile ("pushfl\n\tpopl %0\n\tcli" : "=r"(flags) : : "memory");
+    spin_lock(lock);
+    return flags;
+}
+
+// 释放锁，获取前中断是开启的（IF位）才重新开中断
+static inline void spin_unlock_irqrestore(spinlock_t* lock, unsigned int flags) {
+    spin_unlock(lock);
+    if (flags & 0x200) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include "process.h"
 #include "memory.h"
 #include "vm.h"
+#include "shm.h"
 #include "scheduler.h"
 #include "logger.h"
 #include "profiling.h"
@@ -52,7 +53,16 @@ syscall_t syscall_table[] = {
     (syscall_t)syscall_network_recv,     // 36
     (syscall_t)syscall_network_close,    // 37
     (syscall_t)syscall_gettimeofday,     // 38
-    (syscall_t)syscall_logger_log        // 39
+    (syscall_t)syscall_logger_log,       // 39
+    (syscall_t)syscall_heap_profile,     // 40
+    (syscall_t)syscall_mmap,             // 41
+    (syscall_t)syscall_munmap,           // 42
+    (syscall_t)syscall_shm_create,       // 43
+    (syscall_t)syscall_shm_attach,       // 44
+    (syscall_t)syscall_shm_detach,       // 45
+    (syscall_t)syscall_shm_unlink,       // 46
+    (syscall_t)syscall_sched_setattr,    // 47
+    (syscall_t)syscall_futex             // 48
 };
 
 // 系统调用处理函数
@@ -87,9 +97,15 @@ void syscall_handler(int syscall_num, unsigned int arg1, unsigned int arg2, unsi
             }
             break;
             
-        case SYSCALL_FORK:
-            syscall_fork();
+        case SYSCALL_FORK: {
+            // 父进程的返回值写回陷阱帧，子进程从陷阱帧的副本返回0
+            int pid = syscall_fork();
+            struct process* proc = get_current_process();
+            if (proc && proc->syscall_regs) {
+                proc->syscall_regs->eax = (unsigned int)pid;
+            }
             break;
+        }
             
         case SYSCALL_EXEC:
             // 增加空指针检查
@@ -283,6 +299,60 @@ void syscall_handler(int syscall_num, unsigned int arg1, unsigned int arg2, unsi
             syscall_logger_log((int)arg1, (const char*)arg2, (const char*)arg3);
             break;
             
+        case SYSCALL_HEAP_PROFILE: {
+            int count = syscall_heap_profile((struct heap_site_stats*)arg1, (unsigned int)arg2);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(count));
+            break;
+        }
+            
+        case SYSCALL_MMAP: {
+            void* addr = syscall_mmap((const struct mmap_args*)arg1);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(addr));
+            break;
+        }
+            
+        case SYSCALL_MUNMAP: {
+            int result = syscall_munmap((void*)arg1, (unsigned int)arg2);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(result));
+            break;
+        }
+            
+        case SYSCALL_SHM_CREATE: {
+            int result = syscall_shm_create((const char*)arg1, (unsigned int)arg2);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(result));
+            break;
+        }
+            
+        case SYSCALL_SHM_ATTACH: {
+            void* addr = syscall_shm_attach((const char*)arg1, (unsigned int)arg2);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(addr));
+            break;
+        }
+            
+        case SYSCALL_SHM_DETACH: {
+            int result = syscall_shm_detach((void*)arg1);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(result));
+            break;
+        }
+            
+        case SYSCALL_SHM_UNLINK: {
+            int result = syscall_shm_unlink((const char*)arg1);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(result));
+            break;
+        }
+            
+        case SYSCALL_SCHED_SETATTR: {
+            int result = syscall_sched_setattr((int)arg1, (const struct sched_attr*)arg2);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(result));
+            break;
+        }
+            
+        case SYSCALL_FUTEX: {
+            int result = syscall_futex((volatile unsigned int*)arg1, (int)arg2, arg3);
+            __asm__ volatile ("mov %0, %%eax" : : "r"(result));
+            break;
+        }
+            
         default:
             LOG_WARNING("SYSCALL", "Unhandled system call");
             print_string("Unhandled system call: ");
@@ -338,9 +408,13 @@ void syscall_exit(int status) {
 
 int syscall_fork() {
     LOG_INFO("PROCESS", "Fork system call called");
-    print_string("Fork system call called\n");
-    // 在实际实现中，这里会创建一个新进程
-    return 0;
+    
+    // 写时复制地址空间，子进程在自己的进程栈副本上从系统调用返回0
+    int pid = fork_process();
+    if (pid < 0) {
+        LOG_ERROR("PROCESS", "Fork failed");
+    }
+    return pid;
 }
 
 int syscall_exec(const char* path) {
@@ -647,6 +721,134 @@ void syscall_logger_log(int level, const char* module, const char* message) {
     logger_log(level, module, message);
 }
 
+int syscall_heap_profile(struct heap_site_stats* buf, unsigned int max_sites) {
+    LOG_DEBUG("MEMORY", "Heap profile system call called");
+    
+    if (!buf || max_sites == 0) {
+        return 0;
+    }
+    if (max_sites > MEMORY_PROFILE_SITES) {
+        max_sites = MEMORY_PROFILE_SITES;
+    }
+    
+    return memory_profile_snapshot(buf, max_sites);
+}
+
+// 获取当前进程的地址空间
+static page_directory_t* syscall_current_directory() {
+    struct process* proc = get_current_process();
+    if (proc && proc->page_dir) {
+        return proc->page_dir;
+    }
+    return vm_get_current_directory();
+}
+
+void* syscall_mmap(const struct mmap_args* args) {
+    if (!args || !args->node || args->length == 0) {
+        LOG_ERROR("SYSCALL", "mmap called with invalid arguments");
+        return 0;
+    }
+    
+    if (args->offset % PAGE_SIZE != 0) {
+        LOG_ERROR("SYSCALL", "mmap offset must be page aligned");
+        return 0;
+    }
+    
+    unsigned int flags = VM_REGION_USER;
+    if (args->prot & PROT_WRITE) {
+        flags |= VM_REGION_WRITE;
+    }
+    
+    // 页面在首次访问时才从文件读取
+    unsigned int addr = vm_map_file(syscall_current_directory(), args->node, args->offset, args->length, flags);
+    if (addr == 0) {
+        LOG_ERROR("MEMORY", "mmap failed");
+    }
+    return (void*)addr;
+}
+
+int syscall_munmap(void* addr, unsigned int length) {
+    if (!addr || length == 0) {
+        return -1;
+    }
+    
+    // 只支持解除整个映射
+    return vm_release_region(syscall_current_directory(), (unsigned int)addr);
+}
+
+int syscall_shm_create(const char* name, unsigned int size) {
+    if (name == NULL) {
+        LOG_ERROR("SYSCALL", "shm_create received NULL name");
+        return -1;
+    }
+    
+    return shm_create(name, size);
+}
+
+void* syscall_shm_attach(const char* name, unsigned int prot) {
+    if (name == NULL) {
+        LOG_ERROR("SYSCALL", "shm_attach received NULL name");
+        return 0;
+    }
+    
+    // 多个进程映射同一组页帧，数据无需经过内核复制
+    unsigned int addr = shm_attach(syscall_current_directory(), name, (prot & PROT_WRITE) != 0);
+    if (addr == 0) {
+        LOG_ERROR("MEMORY", "shm_attach failed");
+    }
+    return (void*)addr;
+}
+
+int syscall_shm_detach(void* addr) {
+    if (!addr) {
+        return -1;
+    }
+    
+    return shm_detach(syscall_current_directory(), (unsigned int)addr);
+}
+
+int syscall_shm_unlink(const char* name) {
+    if (name == NULL) {
+        return -1;
+    }
+    
+    return shm_unlink(name);
+}
+
+int syscall_sched_setattr(int pid, const struct sched_attr* attr) {
+    if (attr == NULL) {
+        LOG_ERROR("SYSCALL", "sched_setattr received NULL attributes");
+        return -1;
+    }
+    
+    // pid为0表示调用进程自身
+    struct process* proc = pid == 0 ? get_current_process() : get_process((unsigned int)pid);
+    if (!proc) {
+        return -1;
+    }
+    
+    // 截止时间类的准入失败时返回-1，进程保持原来的调度属性
+    int result = scheduler_setattr(proc, attr);
+    if (result != 0) {
+        LOG_WARNING("SYSCALL", "sched_setattr rejected");
+    }
+    return result;
+}
+
+// FUTEX_WAIT：*uaddr等于val时阻塞直到被唤醒，值已改变时返回FUTEX_EAGAIN；
+// FUTEX_WAKE：唤醒最多val个等待者，返回唤醒的个数
+int syscall_futex(volatile unsigned int* uaddr, int op, unsigned int val) {
+    switch (op) {
+        case FUTEX_WAIT:
+            return futex_wait(uaddr, val, 0);
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, val);
+        default:
+            LOG_ERROR("SYSCALL", "futex called with unknown operation");
+            return FUTEX_EINVAL;
+    }
+}
+
 // 整数转字符串辅助函数
 void int_to_string(int value, char* str) {
     if (!str) {
@@ -1,6 +1,10 @@
 #ifndef SYSCALL_H
 #define SYSCALL_H
 
+#include "memory.h"
+#include "scheduler.h"
+#include "futex.h"
+
 // 系统调用号定义
 #define SYSCALL_PUTCHAR          1
 #define SYSCALL_PRINT_STRING     2
@@ -41,6 +45,21 @@
 #define SYSCALL_NETWORK_CLOSE    37
 #define SYSCALL_GETTIMEOFDAY     38
 #define SYSCALL_LOGGER_LOG       39
+#define SYSCALL_HEAP_PROFILE     40
+#define SYSCALL_MMAP             41
+#define SYSCALL_MUNMAP           42
+#define SYSCALL_SHM_CREATE       43
+#define SYSCALL_SHM_ATTACH       44
+#define SYSCALL_SHM_DETACH       45
+#define SYSCALL_SHM_UNLINK       46
+#define SYSCALL_SCHED_SETATTR    47
+#define SYSCALL_FUTEX            48
+
+#define SYSCALL_MAX              49
+
+// 内存映射保护标志
+#define PROT_READ                0x1
+#define PROT_WRITE               0x2
 
 // 进程信息结构
 struct process_info {
@@ -80,6 +99,14 @@ struct timeval {
     unsigned int tv_usec;
 };
 
+// 内存映射参数（系统调用只有三个寄存器参数，通过结构体传递）
+struct mmap_args {
+    struct fs_node* node;   // 要映射的文件
+    unsigned int offset;    // 文件偏移，必须按页对齐
+    unsigned int length;    // 映射长度
+    unsigned int prot;      // PROT_*标志
+};
+
 // 系统调用处理函数声明
 void syscall_handler();
 void syscall_putchar(char c);
@@ -121,6 +148,15 @@ int syscall_network_recv(int sockfd, void* buf, unsigned int len, int flags);
 int syscall_network_close(int sockfd);
 int syscall_gettimeofday(struct timeval* tv, void* tz);
 void syscall_logger_log(int level, const char* module, const char* message);
+int syscall_heap_profile(struct heap_site_stats* buf, unsigned int max_sites);
+void* syscall_mmap(const struct mmap_args* args);
+int syscall_munmap(void* addr, unsigned int length);
+int syscall_shm_create(const char* name, unsigned int size);
+void* syscall_shm_attach(const char* name, unsigned int prot);
+int syscall_shm_detach(void* addr);
+int syscall_shm_unlink(const char* name);
+int syscall_sched_setattr(int pid, const struct sched_attr* attr);
+int syscall_futex(volatile unsigned int* uaddr, int op, unsigned int val);
 
 // 系统调用表
 typedef void (*syscall_t)();
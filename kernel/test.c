@@ -3,6 +3,13 @@
 #include "memory.h"
 #include "process.h"
 #include "vm.h"
+#include "shm.h"
+#include "syscall.h"
+#include "futex.h"
+#include "timer.h"
+#include "context.h"
+#include "clocksource.h"
+#include "../libs/ringbuf.h"
 #include "scheduler.h"
 #include "logger.h"
 #include "config.h"
@@ -10,6 +17,8 @@
 #include "power.h"
 #include "profiling.h"
 #include "security.h"
+#include "smp.h"
+#include "../drivers/filesystem.h"
 
 // 测试结果统计
 static struct test_stats global_test_stats = {0, 0, 0};
@@ -17,9 +26,26 @@ static struct test_stats global_test_stats = {0, 0, 0};
 // 测试用例数组
 static struct test_case test_cases[] = {
     {"Memory Allocation Test", test_memory_allocation},
+    {"Memory Size Class Test", test_memory_size_classes},
+    {"Heap Profiler Test", test_memory_heap_profile},
     {"Process Creation Test", test_process_creation},
+    {"Process Table Test", test_process_table},
     {"Virtual Memory Test", test_virtual_memory},
+    {"Buddy Allocator Test", test_buddy_allocator},
+    {"Bulk Frame Allocation Test", test_frame_bulk_allocation},
+    {"Demand-Zero Paging Test", test_demand_zero_paging},
+    {"Copy-on-Write Fork Test", test_cow_fork},
+    {"Mmap Page Cache Test", test_mmap_page_cache},
+    {"Page Reclaim Test", test_page_reclaim},
+    {"Zeroed Frame Pool Test", test_zero_pool},
+    {"Shared Memory Test", test_shared_memory},
     {"Scheduler Test", test_scheduler},
+    {"Priority Bitmap Scheduler Test", test_priority_scheduler},
+    {"Fair Scheduler Benchmark", test_fair_scheduler},
+    {"Deadline Scheduler Test", test_deadline_scheduler},
+    {"Timer Heap Test", test_timer_heap},
+    {"Context Switch Latency Benchmark", test_context_switch_latency},
+    {"Futex Test", test_futex},
     {"Logger Test", test_logger},
     {"Configuration Test", test_config},
     {"Exception Handler Test", test_exception_handler},
@@ -146,26 +172,182 @@ int test_memory_allocation() {
     return TEST_PASS;
 }
 
+// 测试小对象尺寸类别分配
+int test_memory_size_classes() {
+    initialize_memory();
+    
+    // 首次分配需要补充空闲链表
+    void* ptr1 = allocate_memory(20);
+    if (!ptr1) {
+        return TEST_FAIL;
+    }
+    
+    struct memory_stats stats;
+    get_memory_stats(&stats);
+    if (stats.class_misses[1] != 1) {
+        return TEST_FAIL;
+    }
+    
+    // 释放后同一类别的分配应复用该块并计为命中
+    free_memory(ptr1);
+    void* ptr2 = allocate_memory(32);
+    if (ptr2 != ptr1) {
+        return TEST_FAIL;
+    }
+    
+    get_memory_stats(&stats);
+    if (stats.class_hits[1] != 1) {
+        return TEST_FAIL;
+    }
+    
+    free_memory(ptr2);
+    
+    return check_memory_integrity() == 0 ? TEST_PASS : TEST_FAIL;
+}
+
+// 测试堆分析器按分配位置聚合
+int test_memory_heap_profile() {
+    initialize_memory();
+    
+    void* ptrs[4];
+    for (int i = 0; i < 4; i++) {
+        ptrs[i] = allocate_memory(100);
+        if (!ptrs[i]) {
+            return TEST_FAIL;
+        }
+    }
+    free_memory(ptrs[0]);
+    
+    struct heap_site_stats sites[4];
+    int count = memory_profile_snapshot(sites, 4);
+#ifdef MEMORY_DEBUG
+    // 同一行的4次分配应聚合为一个调用点，释放后剩余3块
+    if (count != 1 || sites[0].total_allocations != 4 || sites[0].live_count != 3) {
+        return TEST_FAIL;
+    }
+#else
+    if (count != 0) {
+        return TEST_FAIL;
+    }
+#endif
+    
+    for (int i = 1; i < 4; i++) {
+        free_memory(ptrs[i]);
+    }
+    
+    return TEST_PASS;
+}
+
+// 测试进程使用的空入口函数
+static void test_process_entry() {
+}
+
 // 测试进程创建功能
 int test_process_creation() {
     // 初始化进程管理
     initialize_processes();
     
     // 测试创建进程
-    struct process* proc = create_process("test_process", 0, 0);
-    if (!proc) {
+    int pid = create_process(test_process_entry);
+    if (pid <= 0) {
         return TEST_FAIL;
     }
     
-    // 检查进程属性
-    if (proc->state != PROCESS_READY) {
-        return TEST_FAIL;
+    // 检查进程属性：创建后已在就绪队列中
+    struct process* proc = get_process(pid);
+    int result = TEST_PASS;
+    if (!proc || proc->state != PROCESS_READY) {
+        result = TEST_FAIL;
     }
     
-    // 测试进程调度
-    scheduler_add_to_ready(proc);
+    if (proc) {
+        scheduler_add_to_terminated(proc);
+        process_reap();
+    }
+    return result;
+}
+
+// 进程表测试：创建超过旧上限（64）的进程，终止并回收一半后新进程复用回收的槽位
+#define PROCESS_TABLE_TEST_COUNT 256
+
+static int process_table_test_pids[PROCESS_TABLE_TEST_COUNT];
+
+static void process_table_test_entry() {
+}
+
+int test_process_table() {
+    scheduler_init();
+    initialize_processes();
     
-    return TEST_PASS;
+    int result = TEST_PASS;
+    for (int i = 0; i < PROCESS_TABLE_TEST_COUNT; i++) {
+        process_table_test_pids[i] = create_process(process_table_test_entry);
+        if (process_table_test_pids[i] <= 0) {
+            initialize_processes();
+            scheduler_init();
+            return TEST_FAIL;
+        }
+    }
+    
+    // 每个PID都能查到对应的进程，可运行进程数不需要扫描进程表
+    for (int i = 0; i < PROCESS_TABLE_TEST_COUNT; i++) {
+        struct process* proc = get_process(process_table_test_pids[i]);
+        if (!proc || proc->pid != (unsigned int)process_table_test_pids[i]) {
+            result = TEST_FAIL;
+        }
+    }
+    if (process_get_count() != PROCESS_TABLE_TEST_COUNT ||
+        scheduler_nr_runnable() != PROCESS_TABLE_TEST_COUNT || no_running_processes()) {
+        result = TEST_FAIL;
+    }
+    
+    // 新建的进程已经在就绪队列中，调度器能选中它（只检查选择，不真正切换过去）
+    struct process* next = scheduler_select_next();
+    if (!next || get_process(next->pid) != next || next->state != PROCESS_RUNNING) {
+        result = TEST_FAIL;
+    }
+    if (next) {
+        next->on_cpu = 0;
+    }
+    
+    // 终止偶数下标的进程：它们立即查不到，回收前仍占用槽位
+    struct process* last_terminated = 0;
+    for (int i = 0; i < PROCESS_TABLE_TEST_COUNT; i += 2) {
+        last_terminated = get_process(process_table_test_pids[i]);
+        scheduler_add_to_terminated(last_terminated);
+        if (get_process(process_table_test_pids[i])) {
+            result = TEST_FAIL;
+        }
+    }
+    if (scheduler_nr_runnable() != PROCESS_TABLE_TEST_COUNT / 2 ||
+        process_get_count() != PROCESS_TABLE_TEST_COUNT) {
+        result = TEST_FAIL;
+    }
+    
+    if (process_reap() != PROCESS_TABLE_TEST_COUNT / 2 ||
+        process_get_count() != PROCESS_TABLE_TEST_COUNT / 2) {
+        result = TEST_FAIL;
+    }
+    
+    // 新进程复用最后回收的槽位，并得到新的PID
+    int pid = create_process(process_table_test_entry);
+    struct process* proc = pid > 0 ? get_process(pid) : 0;
+    if (proc != last_terminated || pid <= process_table_test_pids[PROCESS_TABLE_TEST_COUNT - 1]) {
+        result = TEST_FAIL;
+    }
+    scheduler_add_to_terminated(proc);
+    
+    for (int i = 1; i < PROCESS_TABLE_TEST_COUNT; i += 2) {
+        scheduler_add_to_terminated(get_process(process_table_test_pids[i]));
+    }
+    process_reap();
+    if (process_get_count() != 0 || !no_running_processes()) {
+        result = TEST_FAIL;
+    }
+    
+    initialize_processes();
+    scheduler_init();
+    return result;
 }
 
 // 测试虚拟内存功能
@@ -185,32 +367,981 @@ int test_virtual_memory() {
     return TEST_PASS;
 }
 
+// 测试伙伴分配器的对齐、统计和合并
+int test_buddy_allocator() {
+    struct vm_stats* stats = vm_get_stats();
+    unsigned int free_before = stats->free_pages;
+    
+    // 分配的块应按块大小对齐
+    unsigned int block = alloc_pages(4);
+    if (block == 0 || (block & 15) != 0) {
+        return TEST_FAIL;
+    }
+    if (stats->free_pages != free_before - 16) {
+        return TEST_FAIL;
+    }
+    
+    unsigned int frame = vm_allocate_frame();
+    if (frame == 0) {
+        free_pages(block, 4);
+        return TEST_FAIL;
+    }
+    
+    // 全部释放后空闲页数应恢复
+    vm_free_frame(frame);
+    free_pages(block, 4);
+    
+    return stats->free_pages == free_before ? TEST_PASS : TEST_FAIL;
+}
+
+// 测试批量分配页帧
+int test_frame_bulk_allocation() {
+    struct vm_stats* stats = vm_get_stats();
+    unsigned int free_before = stats->free_pages;
+    unsigned int frames[37];
+    
+    if (vm_allocate_frames(37, frames) != 37) {
+        return TEST_FAIL;
+    }
+    
+    // 每个页帧都必须不同且可单独释放
+    for (int i = 0; i < 37; i++) {
+        for (int j = i + 1; j < 37; j++) {
+            if (frames[i] == frames[j]) {
+                return TEST_FAIL;
+            }
+        }
+    }
+    for (int i = 0; i < 37; i++) {
+        vm_free_frame(frames[i]);
+    }
+    
+    return stats->free_pages == free_before ? TEST_PASS : TEST_FAIL;
+}
+
+// 测试预留区域在首次访问时才分配并清零页帧
+int test_demand_zero_paging() {
+    page_directory_t* page_dir = vm_get_current_directory();
+    struct vm_stats* stats = vm_get_stats();
+    unsigned int region = 0x40000000;
+    unsigned int free_before = stats->free_pages;
+    
+    // 预留16页不应消耗页帧
+    if (vm_reserve_region(page_dir, region, 16 * PAGE_SIZE, VM_REGION_WRITE) != 0) {
+        return TEST_FAIL;
+    }
+    if (stats->free_pages != free_before) {
+        vm_release_region(page_dir, region);
+        return TEST_FAIL;
+    }
+    
+    // 模拟对第3页的写访问缺页
+    unsigned int minor_before = stats->minor_faults;
+    if (vm_handle_page_fault(region + 2 * PAGE_SIZE + 8, 0x2) != 0 ||
+        stats->minor_faults != minor_before + 1 || stats->free_pages != free_before - 1) {
+        vm_release_region(page_dir, region);
+        return TEST_FAIL;
+    }
+    
+    volatile unsigned int* page = (volatile unsigned int*)(region + 2 * PAGE_SIZE);
+    for (int i = 0; i < PAGE_SIZE / 4; i++) {
+        if (page[i] != 0) {
+            vm_release_region(page_dir, region);
+            return TEST_FAIL;
+        }
+    }
+    
+    // 区域外的地址不应被处理
+    if (vm_handle_page_fault(region + 16 * PAGE_SIZE, 0x2) == 0) {
+        vm_release_region(page_dir, region);
+        return TEST_FAIL;
+    }
+    
+    vm_release_region(page_dir, region);
+    return stats->free_pages == free_before ? TEST_PASS : TEST_FAIL;
+}
+
+// 取页表项（测试中页表已经建立）
+static page_table_entry_t* test_get_pte(page_directory_t* page_dir, unsigned int addr) {
+    page_table_t* table = (page_table_t*)(page_dir->entries[addr >> 22].frame << 12);
+    return &table->entries[(addr >> 12) & 1023];
+}
+
+// fork测试进程的返回值（父、子），以及子进程读到的进程栈上变量的值
+static volatile int fork_test_returns[2];
+static volatile unsigned int fork_test_child_value;
+
+// 经系统调用入口fork
+static int test_fork_syscall() {
+    int result;
+    __asm__ volatile ("int $0x80" : "=a"(result) : "a"(SYSCALL_FORK) : "memory");
+    return result;
+}
+
+// fork测试进程：父进程在fork之后修改栈上的变量，子进程的栈副本中应仍是fork时的值
+static void test_fork_entry() {
+    volatile unsigned int value = 0x1111;
+    int pid = test_fork_syscall();
+    if (pid == 0) {
+        fork_test_returns[1] = pid;
+        fork_test_child_value = value;
+    } else {
+        fork_test_returns[0] = pid;
+        value = 0x2222;
+    }
+}
+
+// 测试写时复制fork：克隆后一侧写入得到私有副本，另一侧的页帧、内容和引用计数不受影响；
+// 经系统调用fork时父进程得到子进程的PID，子进程在自己的进程栈副本上从同一处返回0
+int test_cow_fork() {
+    page_directory_t* saved_dir = vm_get_current_directory();
+    struct vm_stats* stats = vm_get_stats();
+    unsigned int region = 0x40800000;
+    unsigned int free_before = stats->free_pages;
+    
+    // 内核页目录中的页表在克隆时直接共享，需要在独立的地址空间中测试，
+    // 且区域不能落在其他测试已在内核页目录中建立页表的4MB范围内
+    page_directory_t* parent = vm_create_address_space();
+    if (!parent) {
+        return TEST_FAIL;
+    }
+    vm_switch_address_space(parent);
+    
+    volatile unsigned int* page = (volatile unsigned int*)region;
+    if (vm_reserve_region(parent, region, PAGE_SIZE, VM_REGION_WRITE) != 0 ||
+        vm_handle_page_fault(region, 0x2) != 0) {
+        vm_switch_address_space(saved_dir);
+        vm_destroy_directory(parent);
+        return TEST_FAIL;
+    }
+    page[0] = 0x1111;
+    
+    page_directory_t* child = vm_clone_directory(parent);
+    if (!child) {
+        vm_switch_address_space(saved_dir);
+        vm_destroy_directory(parent);
+        return TEST_FAIL;
+    }
+    
+    // 克隆后双方共享同一页帧，且都是只读的
+    int result = TEST_PASS;
+    unsigned int shared_frame = test_get_pte(child, region)->frame;
+    if (test_get_pte(parent, region)->frame != shared_frame || vm_frame_refcount(shared_frame) != 2 ||
+        test_get_pte(parent, region)->rw || test_get_pte(child, region)->rw) {
+        result = TEST_FAIL;
+    }
+    
+    // 父进程一侧的写保护缺页复制出私有页帧，子进程仍然使用原来的页帧和内容
+    unsigned int copies_before = stats->cow_copies;
+    if (vm_handle_page_fault(region, 0x3) != 0 || stats->cow_copies != copies_before + 1) {
+        result = TEST_FAIL;
+    }
+    page[0] = 0x2222;
+    
+    unsigned int parent_frame = test_get_pte(parent, region)->frame;
+    if (parent_frame == shared_frame || test_get_pte(child, region)->frame != shared_frame ||
+        vm_frame_refcount(shared_frame) != 1 || vm_frame_refcount(parent_frame) != 1 ||
+        *(volatile unsigned int*)(shared_frame << 12) != 0x1111 || page[0] != 0x2222) {
+        result = TEST_FAIL;
+    }
+    
+    vm_switch_address_space(saved_dir);
+    vm_destroy_directory(child);
+    vm_destroy_directory(parent);
+    if (stats->free_pages != free_before) {
+        result = TEST_FAIL;
+    }
+    
+    // 以下要从引导上下文切换到测试进程
+    if (context_get_current() != 0) {
+        return result;
+    }
+    
+    fork_test_returns[0] = -1;
+    fork_test_returns[1] = -1;
+    fork_test_child_value = 0;
+    int parent_pid = create_process(test_fork_entry);
+    struct process* proc = parent_pid > 0 ? get_process(parent_pid) : 0;
+    if (!proc) {
+        return TEST_FAIL;
+    }
+    
+    // 父进程运行到入口函数返回，子进程此时已在就绪队列中
+    scheduler_dequeue(proc);
+    switch_to_process(proc);
+    struct process* forked = fork_test_returns[0] > 0 ? get_process(fork_test_returns[0]) : 0;
+    if (forked) {
+        scheduler_dequeue(forked);
+        switch_to_process(forked);
+    }
+    
+    if (!forked || forked->parent_pid != (unsigned int)parent_pid || fork_test_returns[1] != 0 ||
+        fork_test_child_value != 0x1111) {
+        result = TEST_FAIL;
+    }
+    process_reap();
+    return result;
+}
+
+// mmap测试用的文件：内容由偏移算出，最后一页不满
+#define MMAP_TEST_FILE_SIZE (PAGE_SIZE + 512)
+
+static unsigned int mmap_test_read(struct fs_node* node, unsigned int offset, unsigned int size, unsigned char* buffer) {
+    (void)node;
+    for (unsigned int i = 0; i < size; i++) {
+        buffer[i] = (unsigned char)((offset + i) * 7 + 1);
+    }
+    return size;
+}
+
+static struct fs_node mmap_test_node;
+
+// 测试文件映射：同一文件的两个只读映射通过页缓存共享页帧，内容与read一致，munmap后归还页帧
+int test_mmap_page_cache() {
+    page_directory_t* page_dir = vm_get_current_directory();
+    struct vm_stats* stats = vm_get_stats();
+    
+    mmap_test_node.size = MMAP_TEST_FILE_SIZE;
+    mmap_test_node.read = mmap_test_read;
+    
+    struct mmap_args args;
+    args.node = &mmap_test_node;
+    args.offset = 0;
+    args.length = MMAP_TEST_FILE_SIZE;
+    args.prot = PROT_READ;
+    
+    unsigned int first = (unsigned int)syscall_mmap(&args);
+    unsigned int second = (unsigned int)syscall_mmap(&args);
+    if (first == 0 || second == 0 || first == second) {
+        if (first) {
+            syscall_munmap((void*)first, MMAP_TEST_FILE_SIZE);
+        }
+        if (second) {
+            syscall_munmap((void*)second, MMAP_TEST_FILE_SIZE);
+        }
+        return TEST_FAIL;
+    }
+    
+    // 两个映射各自缺页，第二次命中页缓存
+    int result = TEST_PASS;
+    unsigned int hits_before = stats->page_cache_hits;
+    for (unsigned int page = 0; page < 2; page++) {
+        if (vm_handle_page_fault(first + page * PAGE_SIZE, 0x4) != 0 ||
+            vm_handle_page_fault(second + page * PAGE_SIZE, 0x4) != 0) {
+            result = TEST_FAIL;
+        }
+    }
+    if (stats->page_cache_hits != hits_before + 2) {
+        result = TEST_FAIL;
+    }
+    
+    // 两个映射共享同一页帧（页缓存另持有一个引用），且都是只读的
+    unsigned int frames[2];
+    for (unsigned int page = 0; page < 2 && result == TEST_PASS; page++) {
+        page_table_entry_t* a = test_get_pte(page_dir, first + page * PAGE_SIZE);
+        page_table_entry_t* b = test_get_pte(page_dir, second + page * PAGE_SIZE);
+        frames[page] = a->frame;
+        if (!a->present || !b->present || a->frame != b->frame || a->rw || b->rw ||
+            vm_frame_refcount(a->frame) != 3) {
+            result = TEST_FAIL;
+        }
+    }
+    
+    // 内容与read读出的一致，文件末尾之后为0
+    static unsigned char expected[MMAP_TEST_FILE_SIZE];
+    mmap_test_read(&mmap_test_node, 0, MMAP_TEST_FILE_SIZE, expected);
+    const unsigned char* a = (const unsigned char*)first;
+    const unsigned char* b = (const unsigned char*)second;
+    for (unsigned int i = 0; i < 2 * PAGE_SIZE && result == TEST_PASS; i++) {
+        unsigned char value = i < MMAP_TEST_FILE_SIZE ? expected[i] : 0;
+        if (a[i] != value || b[i] != value) {
+            result = TEST_FAIL;
+        }
+    }
+    
+    // 解除映射后只剩页缓存的引用，丢弃缓存后页帧回到空闲状态
+    unsigned int free_mapped = stats->free_pages;
+    if (syscall_munmap((void*)first, MMAP_TEST_FILE_SIZE) != 0 ||
+        syscall_munmap((void*)second, MMAP_TEST_FILE_SIZE) != 0) {
+        result = TEST_FAIL;
+    }
+    if (result == TEST_PASS && (vm_frame_refcount(frames[0]) != 1 || vm_frame_refcount(frames[1]) != 1)) {
+        result = TEST_FAIL;
+    }
+    vm_page_cache_invalidate(&mmap_test_node);
+    if (result == TEST_PASS && stats->free_pages != free_mapped + 2) {
+        result = TEST_FAIL;
+    }
+    return result;
+}
+
+// 测试页回收：冷页换出到压缩存储后再次访问时恢复原内容
+int test_page_reclaim() {
+    page_directory_t* page_dir = vm_get_current_directory();
+    struct vm_stats* stats = vm_get_stats();
+    unsigned int region = 0x40100000;
+    unsigned int zswap_before = stats->zswap_pages;
+    
+    if (vm_reserve_region(page_dir, region, 8 * PAGE_SIZE, VM_REGION_WRITE) != 0) {
+        return TEST_FAIL;
+    }
+    
+    // 前6页写入可压缩的内容，后2页只读取（保持全0，回收时直接丢弃）
+    for (int i = 0; i < 8; i++) {
+        volatile unsigned int* page = (volatile unsigned int*)(region + i * PAGE_SIZE);
+        if (i < 6) {
+            for (int j = 0; j < PAGE_SIZE / 4; j++) {
+                page[j] = (j % 16 == 0) ? (unsigned int)(i * 1000 + j) : 0;
+            }
+        } else if (page[0] != 0) {
+            vm_release_region(page_dir, region);
+            return TEST_FAIL;
+        }
+    }
+    
+    // 时钟算法第一圈只清除访问位，连续回收直到这些页被换出
+    unsigned int reclaimed_before = stats->reclaimed_pages;
+    vm_reclaim_pages(16);
+    vm_reclaim_pages(16);
+    if (stats->reclaimed_pages == reclaimed_before) {
+        vm_release_region(page_dir, region);
+        return TEST_FAIL;
+    }
+    
+    // 再次访问时通过缺页恢复
+    for (int i = 0; i < 8; i++) {
+        volatile unsigned int* page = (volatile unsigned int*)(region + i * PAGE_SIZE);
+        for (int j = 0; j < PAGE_SIZE / 4; j++) {
+            unsigned int expected = (i < 6 && j % 16 == 0) ? (unsigned int)(i * 1000 + j) : 0;
+            if (page[j] != expected) {
+                vm_release_region(page_dir, region);
+                return TEST_FAIL;
+            }
+        }
+    }
+    
+    vm_release_region(page_dir, region);
+    return stats->zswap_pages == zswap_before ? TEST_PASS : TEST_FAIL;
+}
+
+// 测试预清零页帧池：空闲时补充，分配时命中并返回全0的页帧
+int test_zero_pool() {
+    struct vm_stats* vm = vm_get_stats();
+    struct system_stats* stats = profiling_get_system_stats();
+    
+    vm_refill_zero_pool();
+    if (vm->zero_pool_frames == 0) {
+        return TEST_FAIL;
+    }
+    
+    unsigned long long hits_before = stats->zero_pool_hits;
+    unsigned int frame = vm_allocate_zeroed_frame();
+    if (frame == 0 || stats->zero_pool_hits != hits_before + 1) {
+        return TEST_FAIL;
+    }
+    
+    unsigned int* page = (unsigned int*)(frame << 12);
+    int result = TEST_PASS;
+    for (int i = 0; i < PAGE_SIZE / 4; i++) {
+        if (page[i] != 0) {
+            result = TEST_FAIL;
+            break;
+        }
+    }
+    
+    vm_free_frame(frame);
+    return result;
+}
+
+// 测试共享内存：同一段的两个映射看到相同的数据，环形缓冲区可以跨映射传递消息
+int test_shared_memory() {
+    page_directory_t* page_dir = vm_get_current_directory();
+    struct shm_stats* stats = shm_get_stats();
+    unsigned int segments_before = stats->segments;
+    
+    if (shm_create("test-shm", 2 * PAGE_SIZE) != 0) {
+        return TEST_FAIL;
+    }
+    if (shm_create("test-shm", PAGE_SIZE) == 0) {
+        shm_unlink("test-shm");
+        return TEST_FAIL;
+    }
+    
+    unsigned int producer = shm_attach(page_dir, "test-shm", 1);
+    unsigned int consumer = shm_attach(page_dir, "test-shm", 0);
+    if (producer == 0 || consumer == 0 || producer == consumer) {
+        shm_unlink("test-shm");
+        return TEST_FAIL;
+    }
+    
+    int result = TEST_PASS;
+    struct ring_buffer* tx = ring_init((void*)producer, 2 * PAGE_SIZE);
+    struct ring_buffer* rx = ring_attach((void*)consumer);
+    char message[] = "hello";
+    char buffer[16];
+    if (!tx || !rx || ring_send(tx, message, sizeof(message)) != 0 ||
+        ring_receive(rx, buffer, sizeof(buffer)) != (int)sizeof(message) ||
+        buffer[0] != 'h' || buffer[4] != 'o' || ring_used(rx) != 0) {
+        result = TEST_FAIL;
+    }
+    
+    // 删除名称后已有映射仍然有效
+    if (shm_unlink("test-shm") != 0 || shm_attach(page_dir, "test-shm", 0) != 0) {
+        result = TEST_FAIL;
+    }
+    
+    shm_detach(page_dir, producer);
+    shm_detach(page_dir, consumer);
+    
+    if (stats->segments != segments_before) {
+        result = TEST_FAIL;
+    }
+    return result;
+}
+
 // 测试调度器功能
 int test_scheduler() {
     // 初始化调度器
     scheduler_init();
     
-    // 创建测试进程
-    struct process* proc1 = create_process("test1", 0, 0);
-    struct process* proc2 = create_process("test2", 0, 0);
+    // 创建测试进程，创建时已加入就绪队列
+    int pid1 = create_process(test_process_entry);
+    int pid2 = create_process(test_process_entry);
+    struct process* proc1 = pid1 > 0 ? get_process(pid1) : 0;
+    struct process* proc2 = pid2 > 0 ? get_process(pid2) : 0;
+    
+    // 测试选择下一个进程：应是刚创建的进程之一
+    int result = TEST_PASS;
+    struct process* next = scheduler_select_next();
+    if (!proc1 || !proc2 || (next != proc1 && next != proc2)) {
+        result = TEST_FAIL;
+    }
+    if (next) {
+        next->on_cpu = 0;
+    }
+    
+    if (proc1) {
+        scheduler_add_to_terminated(proc1);
+    }
+    if (proc2) {
+        scheduler_add_to_terminated(proc2);
+    }
+    process_reap();
+    scheduler_init();
+    return result;
+}
+
+// 测试就绪位图调度：高优先级先出队，同优先级先进先出，可从队列中间摘除进程
+int test_priority_scheduler() {
+    scheduler_init();
+    
+    static struct process procs[5];
+    unsigned int priorities[5] = {MAX_PRIORITY_LEVELS - 1, 40, 5, 40, 100};
+    for (int i = 0; i < 5; i++) {
+        procs[i].pid = 100 + i;
+        procs[i].priority = priorities[i];
+        scheduler_add_to_ready(&procs[i]);
+    }
+    
+    // 摘除优先级100的进程后，出队顺序应为5、40、40（先入队的在前）、139
+    scheduler_dequeue(&procs[4]);
+    
+    struct process* expected[4] = {&procs[2], &procs[1], &procs[3], &procs[0]};
+    for (int i = 0; i < 4; i++) {
+        if (scheduler_remove_from_ready() != expected[i]) {
+            return TEST_FAIL;
+        }
+    }
     
-    if (!proc1 || !proc2) {
+    if (scheduler_remove_from_ready() != 0) {
         return TEST_FAIL;
     }
     
-    // 添加到就绪队列
-    scheduler_add_to_ready(proc1);
-    scheduler_add_to_ready(proc2);
+    return TEST_PASS;
+}
+
+// 公平调度基准测试：虚拟时钟每次选择前推进的纳秒数，以及运行的调度周期数
+#define FAIR_BENCH_STEP_NS 100000
+#define FAIR_BENCH_PERIODS 20
+
+// 按权重归一化的运行时间允许的最大偏差（相对平均值的千分比）
+#define FAIR_BENCH_MAX_SPREAD 150
+
+// 调度器测试使用的虚拟时钟（纳秒）
+static unsigned long long sched_test_now;
+
+static unsigned long long sched_test_clock() {
+    return sched_test_now;
+}
+
+// 运行一轮公平调度基准：nr_tasks个nice值为-5、0、5交替的进程一直可运行，虚拟时钟每次选择推进一个步长。
+// 完全公平时每个进程按权重归一化的运行时间（运行时间 * 1024 / 权重）相等，
+// *spread返回其最大值与最小值之差相对于平均值的千分比，*pick_ns返回每次选择的实际耗时
+static int fair_bench_run(unsigned int nr_tasks, unsigned int* spread, unsigned int* pick_ns) {
+    static const int nices[3] = {-5, 0, 5};
     
-    // 测试选择下一个进程
-    struct process* next = scheduler_select_next();
-    if (!next) {
+    struct process* procs = allocate_memory(sizeof(struct process) * nr_tasks);
+    if (!procs) {
+        return -1;
+    }
+    
+    scheduler_init();
+    sched_test_now = 0;
+    for (unsigned int i = 0; i < nr_tasks; i++) {
+        procs[i].pid = 1000 + i;
+        procs[i].cpu = smp_processor_id();
+        procs[i].on_cpu = 0;
+        scheduler_init_task(&procs[i], 0);
+        scheduler_setscheduler(&procs[i], SCHED_CLASS_FAIR, nices[i % 3]);
+        scheduler_add_to_ready(&procs[i]);
+    }
+    
+    unsigned long long period = SCHED_LATENCY_NS;
+    if (nr_tasks > SCHED_NR_LATENCY) {
+        period = nr_tasks * SCHED_MIN_GRANULARITY_NS;
+    }
+    unsigned int picks = (unsigned int)div_u64_u32(period * FAIR_BENCH_PERIODS, FAIR_BENCH_STEP_NS);
+    
+    int result = 0;
+    unsigned long long start = ktime_get_ns();
+    for (unsigned int i = 0; i < picks; i++) {
+        struct process* next = scheduler_select_next();
+        if (!next) {
+            result = -1;
+            break;
+        }
+        // 相当于进程运行了一个步长后回到调度循环
+        next->on_cpu = 0;
+        sched_test_now += FAIR_BENCH_STEP_NS;
+    }
+    unsigned long long elapsed = ktime_get_ns() - start;
+    
+    // 结算最后一个进程的运行时间
+    scheduler_select_next();
+    
+    unsigned long long min_share = ~0ULL;
+    unsigned long long max_share = 0;
+    unsigned long long total_share = 0;
+    for (unsigned int i = 0; i < nr_tasks; i++) {
+        unsigned long long share = div_u64_u32(procs[i].sum_exec_runtime * SCHED_NICE_0_WEIGHT, procs[i].weight);
+        if (share < min_share) min_share = share;
+        if (share > max_share) max_share = share;
+        total_share += share;
+    }
+    
+    unsigned int mean = (unsigned int)div_u64_u32(total_share, nr_tasks);
+    *spread = mean ? (unsigned int)div_u64_u32((max_share - min_share) * 1000, mean) : 1000;
+    *pick_ns = (unsigned int)div_u64_u32(elapsed, picks);
+    
+    // 运行队列不能再引用即将释放的进程
+    scheduler_init();
+    free_memory(procs);
+    return result;
+}
+
+// 测试公平调度类：10到1000个一直可运行的进程按权重分享处理器，输出归一化运行时间的偏差和每次选择的耗时；
+// 实时类进程就绪后立即抢占公平类进程
+int test_fair_scheduler() {
+    static const unsigned int task_counts[3] = {10, 100, 1000};
+    
+    scheduler_set_clock(sched_test_clock);
+    
+    int result = TEST_PASS;
+    unsigned int spread[3];
+    unsigned int pick_ns[3];
+    for (int i = 0; i < 3; i++) {
+        if (fair_bench_run(task_counts[i], &spread[i], &pick_ns[i]) != 0 ||
+            spread[i] > FAIR_BENCH_MAX_SPREAD) {
+            result = TEST_FAIL;
+        }
+    }
+    
+    char buffer[24];
+    print_string("(");
+    for (int i = 0; i < 3; i++) {
+        if (i > 0) print_string("; ");
+        int_to_string(task_counts[i], buffer);
+        print_string(buffer);
+        print_string(" tasks: spread ");
+        int_to_string(spread[i] / 10, buffer);
+        print_string(buffer);
+        print_string(".");
+        int_to_string(spread[i] % 10, buffer);
+        print_string(buffer);
+        print_string("%, ");
+        int_to_string(pick_ns[i], buffer);
+        print_string(buffer);
+        print_string(" ns/pick");
+    }
+    print_string(") ");
+    
+    static struct process fair_proc;
+    static struct process rt_proc;
+    scheduler_init();
+    fair_proc.cpu = smp_processor_id();
+    scheduler_init_task(&fair_proc, 0);
+    scheduler_add_to_ready(&fair_proc);
+    if (scheduler_select_next() != &fair_proc) {
+        result = TEST_FAIL;
+    }
+    fair_proc.on_cpu = 0;
+    
+    rt_proc.cpu = smp_processor_id();
+    rt_proc.priority = 10;
+    scheduler_add_to_ready(&rt_proc);
+    if (scheduler_select_next() != &rt_proc) {
+        result = TEST_FAIL;
+    }
+    
+    scheduler_init();
+    scheduler_set_clock(0);
+    return result;
+}
+
+// 设置截止时间类参数（毫秒）
+static int deadline_test_admit(struct process* proc, unsigned int runtime_ms, unsigned int deadline_ms,
+                               unsigned int period_ms) {
+    struct sched_attr attr;
+    attr.sched_policy = SCHED_CLASS_DEADLINE;
+    attr.sched_nice = 0;
+    attr.sched_priority = 0;
+    attr.sched_runtime = (unsigned long long)runtime_ms * NSEC_PER_MSEC;
+    attr.sched_deadline = (unsigned long long)deadline_ms * NSEC_PER_MSEC;
+    attr.sched_period = (unsigned long long)period_ms * NSEC_PER_MSEC;
+    return scheduler_setattr(proc, &attr);
+}
+
+// 测试截止时间类：带宽准入控制，最早截止时间优先并先于实时类和公平类，
+// 预算用完后限流到下个周期，错过截止时间的次数和最大延迟
+int test_deadline_scheduler() {
+    static struct process dl_procs[3];
+    static struct process rt_proc;
+    static struct process fair_proc;
+    int result = TEST_PASS;
+    
+    scheduler_init();
+    scheduler_set_clock(sched_test_clock);
+    sched_test_now = 0;
+    
+    // 20% + 30%之后再申请50%超过95%的上限，被拒绝；40%可以准入
+    if (deadline_test_admit(&dl_procs[0], 2, 10, 10) != 0 ||
+        deadline_test_admit(&dl_procs[1], 3, 5, 10) != 0 ||
+        deadline_test_admit(&dl_procs[2], 5, 10, 10) == 0 ||
+        deadline_test_admit(&dl_procs[2], 4, 10, 10) != 0) {
+        result = TEST_FAIL;
+    }
+    if (scheduler_get_stats()->dl_rejected != 1 || deadline_test_admit(&dl_procs[2], 2, 3, 2) == 0) {
+        result = TEST_FAIL;
+    }
+    
+    // 截止时间类先于实时类和公平类，截止时间5ms的进程先于10ms的进程
+    rt_proc.priority = 0;
+    fair_proc.cpu = smp_processor_id();
+    scheduler_init_task(&fair_proc, 0);
+    scheduler_add_to_ready(&fair_proc);
+    scheduler_add_to_ready(&rt_proc);
+    scheduler_add_to_ready(&dl_procs[0]);
+    scheduler_add_to_ready(&dl_procs[1]);
+    
+    struct process* expected[5] = {&dl_procs[1], &dl_procs[1], &dl_procs[1], &dl_procs[0], &dl_procs[0]};
+    for (int i = 0; i < 5; i++) {
+        struct process* next = scheduler_select_next();
+        if (next != expected[i]) {
+            result = TEST_FAIL;
+        }
+        if (next) {
+            next->on_cpu = 0;
+        }
+        sched_test_now += NSEC_PER_MSEC;
+    }
+    
+    // 两个进程都用完了预算，轮到实时类进程；截止时间都没有错过
+    struct sched_cpu_stats* stats = scheduler_get_cpu_stats(smp_processor_id());
+    if (scheduler_select_next() != &rt_proc || stats->dl_throttles != 2 || stats->dl_deadline_misses != 0 ||
+        !timer_pending(&dl_procs[0].dl_timer) || !timer_pending(&dl_procs[1].dl_timer)) {
+        result = TEST_FAIL;
+    }
+    
+    // 下个周期补充预算后，截止时间类进程重新抢占实时类进程
+    sched_test_now = 10 * NSEC_PER_MSEC;
+    unsigned int expires = dl_procs[0].dl_timer.expires;
+    if ((int)(dl_procs[1].dl_timer.expires - expires) > 0) {
+        expires = dl_procs[1].dl_timer.expires;
+    }
+    timer_run_expired(expires);
+    rt_proc.on_cpu = 0;
+    if (dl_procs[1].dl_throttled || scheduler_select_next() != &dl_procs[1]) {
+        result = TEST_FAIL;
+    }
+    
+    // 截止时间4ms和5ms、各需4ms的两个进程：后者在8ms时才用完预算，错过截止时间，最大延迟3ms
+    for (int i = 0; i < 3; i++) {
+        scheduler_setscheduler(&dl_procs[i], SCHED_CLASS_FAIR, 0);
+        scheduler_dequeue(&dl_procs[i]);
+    }
+    scheduler_init();
+    sched_test_now = 0;
+    deadline_test_admit(&dl_procs[0], 4, 4, 20);
+    deadline_test_admit(&dl_procs[1], 4, 5, 20);
+    scheduler_add_to_ready(&dl_procs[0]);
+    scheduler_add_to_ready(&dl_procs[1]);
+    for (int i = 0; i < 9; i++) {
+        struct process* next = scheduler_select_next();
+        if (next) {
+            next->on_cpu = 0;
+        }
+        sched_test_now += NSEC_PER_MSEC;
+    }
+    
+    struct scheduler_stats* sched_stats = scheduler_get_stats();
+    if (sched_stats->dl_deadline_misses != 1 || sched_stats->dl_max_lateness != 3 * NSEC_PER_MSEC) {
+        result = TEST_FAIL;
+    }
+    
+    // 恢复为公平类，释放带宽并取消尚未到期的预算补充
+    for (int i = 0; i < 3; i++) {
+        scheduler_setscheduler(&dl_procs[i], SCHED_CLASS_FAIR, 0);
+        if (timer_pending(&dl_procs[i].dl_timer)) {
+            result = TEST_FAIL;
+        }
+    }
+    
+    scheduler_init();
+    scheduler_set_clock(0);
+    return result;
+}
+
+// 测试定时器堆的回调
+static unsigned int timer_test_order[4];
+static unsigned int timer_test_fired;
+
+static void timer_test_callback(void* data) {
+    timer_test_order[timer_test_fired++] = (unsigned int)data;
+}
+
+// 测试定时器堆：按到期时间触发，可修改到期时间和取消，只触发已到期的定时器
+int test_timer_heap() {
+    timer_init();
+    
+    static struct timer timers[4];
+    unsigned int expires[4] = {300, 100, 200, 400};
+    for (unsigned int i = 0; i < 4; i++) {
+        timer_setup(&timers[i], timer_test_callback, (void*)i);
+        if (timer_add(&timers[i], expires[i]) != 0) {
+            return TEST_FAIL;
+        }
+    }
+    
+    // 最近的截止时间可以直接读取
+    if (timer_next_expiry() != 100) {
+        return TEST_FAIL;
+    }
+    
+    // 取消100，把400提前到50
+    timer_cancel(&timers[1]);
+    timer_add(&timers[3], 50);
+    if (timer_pending(&timers[1]) || timer_next_expiry() != 50) {
+        return TEST_FAIL;
+    }
+    
+    // 250时刻只有50和200到期
+    timer_test_fired = 0;
+    if (timer_run_expired(250) != 2 || timer_test_order[0] != 3 || timer_test_order[1] != 2) {
+        return TEST_FAIL;
+    }
+    
+    if (timer_run_expired(1000) != 1 || timer_test_order[2] != 0) {
+        return TEST_FAIL;
+    }
+    
+    if (timer_next_expiry() != TIMER_NO_DEADLINE) {
         return TEST_FAIL;
     }
     
     return TEST_PASS;
 }
 
+// 上下文切换基准测试的往返次数
+#define CONTEXT_BENCH_ROUNDS 10000
+
+// 基准测试的对端进程：每次被切换到后立即切回引导上下文
+static struct process context_bench_proc;
+
+static void context_bench_worker() {
+    while (1) {
+        context_switch_to(0);
+    }
+}
+
+// 测试上下文切换延迟：在引导上下文和一个内核线程之间来回切换，输出平均每次切换的耗时
+int test_context_switch_latency() {
+    if (context_get_current() != 0) {
+        return TEST_SKIP;
+    }
+    
+    if (context_create(&context_bench_proc, context_bench_worker) != 0) {
+        return TEST_FAIL;
+    }
+    context_bench_proc.pid = 0;
+    
+    // 第一次切换进入入口函数，不计入
+    context_switch_to(&context_bench_proc);
+    
+    struct context_stats* stats = context_get_stats();
+    unsigned int switches_before = stats->switches;
+    
+    unsigned long long start = profiling_get_timestamp();
+    for (int i = 0; i < CONTEXT_BENCH_ROUNDS; i++) {
+        context_switch_to(&context_bench_proc);
+    }
+    unsigned long long elapsed = profiling_get_timestamp() - start;
+    
+    unsigned int switches = stats->switches - switches_before;
+    context_destroy(&context_bench_proc);
+    
+    // 每轮往返包含两次切换
+    if (switches != CONTEXT_BENCH_ROUNDS * 2) {
+        return TEST_FAIL;
+    }
+    
+    char buffer[24];
+    print_string("(");
+    long_long_to_string(div_u64_u32(profiling_cycles_to_ns(elapsed), switches), buffer);
+    print_string(buffer);
+    print_string(" ns/switch) ");
+    
+    return TEST_PASS;
+}
+
+// futex测试：两个内核线程在同一个futex上阻塞，由引导上下文按到达顺序唤醒，再验证超时返回，
+// 以及通过同一共享页的另一个映射地址唤醒
+static struct process futex_test_procs[2];
+static volatile unsigned int futex_test_word;
+static volatile unsigned int* volatile futex_test_addr;
+static volatile unsigned int futex_test_other;
+static volatile unsigned int futex_test_timeout;
+static volatile int futex_test_results[2];
+
+// 每次被切换进来就在futex上等待一次，记录结果后回到引导上下文
+static void futex_test_worker() {
+    int index = context_get_current() - futex_test_procs;
+    while (1) {
+        futex_test_results[index] = futex_wait(futex_test_addr, 0, futex_test_timeout);
+        context_switch_to(0);
+    }
+}
+
+int test_futex() {
+    if (context_get_current() != 0) {
+        return TEST_SKIP;
+    }
+    
+    scheduler_init();
+    futex_test_word = 0;
+    futex_test_addr = &futex_test_word;
+    futex_test_timeout = 0;
+    struct futex_stats* stats = futex_get_stats();
+    unsigned int waits = stats->waits;
+    unsigned int timeouts = stats->timeouts;
+    
+    for (int i = 0; i < 2; i++) {
+        if (context_create(&futex_test_procs[i], futex_test_worker) != 0) {
+            if (i > 0) {
+                context_destroy(&futex_test_procs[0]);
+            }
+            return TEST_FAIL;
+        }
+        futex_test_procs[i].pid = 200 + i;
+        futex_test_procs[i].cpu = smp_processor_id();
+        futex_test_procs[i].last_cpu = -1;
+        futex_test_results[i] = 1;
+        scheduler_init_task(&futex_test_procs[i], 0);
+    
+        // 进入后在futex上阻塞，让出处理器回到这里
+        context_switch_to(&futex_test_procs[i]);
+    }
+    
+    int result = TEST_PASS;
+    if (futex_test_procs[0].state != PROCESS_WAITING || futex_test_procs[1].state != PROCESS_WAITING ||
+        stats->waits != waits + 2) {
+        result = TEST_FAIL;
+    }
+    
+    // 值已改变时不阻塞；引导上下文不能阻塞；未对齐的地址被拒绝；其他地址上没有等待者
+    if (futex_wait(&futex_test_word, 1, 0) != FUTEX_EAGAIN ||
+        futex_wait(&futex_test_word, 0, 0) != FUTEX_EAGAIN ||
+        futex_wait((volatile unsigned int*)((unsigned int)&futex_test_word + 1), 0, 0) != FUTEX_EINVAL ||
+        futex_wake(&futex_test_other, WAIT_ALL) != 0) {
+        result = TEST_FAIL;
+    }
+    
+    // 先到的先被唤醒
+    futex_test_word = 1;
+    if (futex_wake(&futex_test_word, 1) != 1 ||
+        futex_test_procs[0].state != PROCESS_READY || futex_test_procs[1].state != PROCESS_WAITING) {
+        result = TEST_FAIL;
+    }
+    if (futex_wake(&futex_test_word, WAIT_ALL) != 1 || futex_test_procs[1].state != PROCESS_READY) {
+        result = TEST_FAIL;
+    }
+    for (int i = 0; i < 2; i++) {
+        scheduler_dequeue(&futex_test_procs[i]);
+        context_switch_to(&futex_test_procs[i]);
+        if (futex_test_results[i] != FUTEX_OK) {
+            result = TEST_FAIL;
+        }
+    }
+    
+    // 没有人唤醒时由睡眠定时器在超时后唤醒
+    futex_test_word = 0;
+    futex_test_timeout = 1;
+    context_switch_to(&futex_test_procs[0]);
+    timer_run_expired(get_current_tick() + 1);
+    scheduler_dequeue(&futex_test_procs[0]);
+    context_switch_to(&futex_test_procs[0]);
+    if (futex_test_results[0] != FUTEX_ETIMEDOUT || stats->timeouts != timeouts + 1 ||
+        futex_wake(&futex_test_word, WAIT_ALL) != 0) {
+        result = TEST_FAIL;
+    }
+    
+    // 同一页帧映射到两个地址（相当于两个进程映射同一共享内存段）：在一个地址上等待，从另一个地址唤醒
+    page_directory_t* page_dir = vm_get_current_directory();
+    unsigned int frame = vm_allocate_zeroed_frame();
+    unsigned int first = frame ? vm_map_shared(page_dir, &frame, 1, VM_REGION_WRITE) : 0;
+    unsigned int second = first ? vm_map_shared(page_dir, &frame, 1, VM_REGION_WRITE) : 0;
+    if (second) {
+        futex_test_addr = (volatile unsigned int*)(first + 64);
+        futex_test_timeout = 0;
+        context_switch_to(&futex_test_procs[1]);
+        if (futex_wake((volatile unsigned int*)(second + 64), 1) != 1 ||
+            futex_test_procs[1].state != PROCESS_READY) {
+            result = TEST_FAIL;
+        }
+        scheduler_dequeue(&futex_test_procs[1]);
+        context_switch_to(&futex_test_procs[1]);
+        if (futex_test_results[1] != FUTEX_OK) {
+            result = TEST_FAIL;
+        }
+    } else {
+        result = TEST_FAIL;
+    }
+    if (first) {
+        vm_release_region(page_dir, first);
+    }
+    if (second) {
+        vm_release_region(page_dir, second);
+    }
+    if (frame) {
+        vm_free_frame(frame);
+    }
+    
+    for (int i = 0; i < 2; i++) {
+        context_destroy(&futex_test_procs[i]);
+    }
+    scheduler_init();
+    return result;
+}
+
 // 测试日志功能
 int test_logger() {
     // 初始化日志系统
@@ -30,9 +30,26 @@ void test_print_summary();
 
 // 各个模块的测试函数
 int test_memory_allocation();
+int test_memory_size_classes();
+int test_memory_heap_profile();
 int test_process_creation();
+int test_process_table();
 int test_virtual_memory();
+int test_buddy_allocator();
+int test_frame_bulk_allocation();
+int test_demand_zero_paging();
+int test_cow_fork();
+int test_mmap_page_cache();
+int test_page_reclaim();
+int test_zero_pool();
+int test_shared_memory();
 int test_scheduler();
+int test_priority_scheduler();
+int test_fair_scheduler();
+int test_deadline_scheduler();
+int test_timer_heap();
+int test_context_switch_latency();
+int test_futex();
 int test_logger();
 int test_config();
 int test_exception_handler();
@@ -0,0 +1,249 @@
+#include "timer.h"
+#include "kernel.h"
+#include "spinlock.h"
+
+// 所有挂起的定时器按到期时间组成最小堆：堆顶即最近的截止时间，读取为O(1)；
+// 添加和取消为O(log n)，处理到期定时器只访问已到期的那些，未到期时只比较一次堆顶
+static struct timer* timer_heap[TIMER_HEAP_CAPACITY];
+static unsigned int timer_count = 0;
+
+// 保护定时器堆，多个处理器都可能添加、取消和处理定时器
+static spinlock_t timer_lock = SPINLOCK_INIT;
+
+// 定时器统计
+static struct timer_stats timer_statistics;
+
+// 比较两个tick，允许计数回绕（两者相差不超过2^31）
+static inline int tick_before(unsigned int a, unsigned int b) {
+    return (int)(a - b) < 0;
+}
+
+// 定时器是否在堆中（同时核对堆中的指针，未经timer_setup的清零结构不会被误认为挂起）
+static inline int timer_in_heap(const struct timer* timer) {
+    return timer->heap_index >= 0 && (unsigned int)timer->heap_index < timer_count &&
+           timer_heap[timer->heap_index] == timer;
+}
+
+// 将定时器放到堆的index处并记录位置
+static inline void heap_place(struct timer* timer, unsigned int index) {
+    timer_heap[index] = timer;
+    timer->heap_index = (int)index;
+}
+
+// 从index处向上调整
+static void heap_sift_up(unsigned int index) {
+    struct timer* timer = timer_heap[index];
+    
+    while (index > 0) {
+        unsigned int parent = (index - 1) / 2;
+        if (!tick_before(timer->expires, timer_heap[parent]->expires)) {
+            break;
+        }
+        heap_place(timer_heap[parent], index);
+        index = parent;
+    }
+    
+    heap_place(timer, index);
+}
+
+// 从index处向下调整
+static void heap_sift_down(unsigned int index) {
+    struct timer* timer = timer_heap[index];
+    
+    while (1) {
+        unsigned int child = index * 2 + 1;
+        if (child >= timer_count) {
+            break;
+        }
+        if (child + 1 < timer_count &&
+            tick_before(timer_heap[child + 1]->expires, timer_heap[child]->expires)) {
+            child++;
+        }
+        if (!tick_before(timer_heap[child]->expires, timer->expires)) {
+            break;
+        }
+        heap_place(timer_heap[child], index);
+        index = child;
+    }
+    
+    heap_place(timer, index);
+}
+
+// 从堆中删除index处的定时器
+static void heap_remove(unsigned int index) {
+    struct timer* removed = timer_heap[index];
+    removed->heap_index = -1;
+    timer_count--;
+    
+    if (index == timer_count) {
+        return;
+    }
+    
+    // 用最后一个元素填补空位，它可能需要向上或向下调整
+    heap_place(timer_heap[timer_count], index);
+    if (index > 0 && tick_before(timer_heap[index]->expires, timer_heap[(index - 1) / 2]->expires)) {
+        heap_sift_up(index);
+    } else {
+        heap_sift_down(index);
+    }
+}
+
+// 初始化定时器子系统
+void timer_init() {
+    spin_lock_init(&timer_lock);
+    timer_count = 0;
+    
+    timer_statistics.active = 0;
+    timer_statistics.max_active = 0;
+    timer_statistics.fired = 0;
+    timer_statistics.cancelled = 0;
+    timer_statistics.overflows = 0;
+    
+    print_string("Timer heap initialized\n");
+}
+
+// 初始化定时器，使用前必须调用一次
+void timer_setup(struct timer* timer, void (*callback)(void* data), void* data) {
+    timer->expires = 0;
+    timer->heap_index = -1;
+    timer->callback = callback;
+    timer->data = data;
+}
+
+// 在expires时刻触发定时器，已挂起的定时器改为新的到期时间；堆满时返回-1
+int timer_add(struct timer* timer, unsigned int expires) {
+    if (!timer) {
+        return -1;
+    }
+    
+    spin_lock(&timer_lock);
+    
+    if (timer_in_heap(timer)) {
+        // 修改已挂起定时器的到期时间
+        unsigned int index = (unsigned int)timer->heap_index;
+        int earlier = tick_before(expires, timer->expires);
+        timer->expires = expires;
+        if (earlier) {
+            heap_sift_up(index);
+        } else {
+            heap_sift_down(index);
+        }
+        spin_unlock(&timer_lock);
+        return 0;
+    }
+    
+    if (timer_count >= TIMER_HEAP_CAPACITY) {
+        timer_statistics.overflows++;
+        spin_unlock(&timer_lock);
+        return -1;
+    }
+    
+    timer->expires = expires;
+    heap_place(timer, timer_count);
+    timer_count++;
+    heap_sift_up(timer_count - 1);
+    
+    timer_statistics.active = timer_count;
+    if (timer_count > timer_statistics.max_active) {
+        timer_statistics.max_active = timer_count;
+    }
+    spin_unlock(&timer_lock);
+    return 0;
+}
+
+// 取消挂起的定时器，返回1表示定时器原本处于挂起状态
+int timer_cancel(struct timer* timer) {
+    if (!timer) {
+        return 0;
+    }
+    
+    spin_lock(&timer_lock);
+    if (!timer_in_heap(timer)) {
+        spin_unlock(&timer_lock);
+        return 0;
+    }
+    
+    heap_remove((unsigned int)timer->heap_index);
+    
+    timer_statistics.active = timer_count;
+    timer_statistics.cancelled++;
+    spin_unlock(&timer_lock);
+    return 1;
+}
+
+// 定时器是否挂起
+int timer_pending(const struct timer* timer) {
+    return timer && timer_in_heap(timer);
+}
+
+// 最近的到期时间，没有挂起的定时器时返回TIMER_NO_DEADLINE
+unsigned int timer_next_expiry() {
+    spin_lock(&timer_lock);
+    unsigned int expires = timer_count ? timer_heap[0]->expires : TIMER_NO_DEADLINE;
+    spin_unlock(&timer_lock);
+    return expires;
+}
+
+// 触发所有在now之前（含）到期的定时器，返回触发的数量；
+// 回调可以重新添加定时器，到期时间不晚于now的会在本轮继续触发。
+// 回调在释放锁之后调用，多个处理器同时处理时每个定时器只会被其中一个取走
+unsigned int timer_run_expired(unsigned int now) {
+    unsigned int fired = 0;
+    
+    spin_lock(&timer_lock);
+    while (timer_count && !tick_before(now, timer_heap[0]->expires)) {
+        struct timer* timer = timer_heap[0];
+        heap_remove(0);
+        timer_statistics.active = timer_count;
+        timer_statistics.fired++;
+        spin_unlock(&timer_lock);
+        
+        fired++;
+        timer->callback(timer->data);
+        
+        spin_lock(&timer_lock);
+    }
+    spin_unlock(&timer_lock);
+    
+    return fired;
+}
+
+// 获取定时器统计信息
+struct timer_stats* timer_get_stats() {
+    return &timer_statistics;
+}
+
+// 显示定时器统计信息
+void timer_print_stats() {
+    print_string("=== Timer Statistics ===\n");
+    
+    char stat_str[16];
+    
+    print_string("Active timers: ");
+    int_to_string(timer_statistics.active, stat_str);
+    print_string(stat_str);
+    print_string(", max active: ");
+    int_to_string(timer_statistics.max_active, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Fired: ");
+    int_to_string(timer_statistics.fired, stat_str);
+    print_string(stat_str);
+    print_string(", cancelled: ");
+    int_to_string(timer_statistics.cancelled, stat_str);
+    print_string(stat_str);
+    print_string(", overflows: ");
+    int_to_string(timer_statistics.overflows, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Next expiry: ");
+    if (timer_count) {
+        int_to_string(timer_heap[0]->expires, stat_str);
+        print_string(stat_str);
+    } else {
+        print_string("none");
+    }
+    print_string("\n");
+}
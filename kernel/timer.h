@@ -0,0 +1,42 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// 定时器堆容量（同时挂起的定时器数上限）
+#define TIMER_HEAP_CAPACITY 4096
+
+// 没有挂起的定时器时timer_next_expiry的返回值
+#define TIMER_NO_DEADLINE 0xFFFFFFFF
+
+// 定时器：嵌入在使用者的结构中（如进程控制块、TCP连接），到期时在内核主循环中调用callback
+struct timer {
+    unsigned int expires;               // 到期tick（绝对时间）
+    int heap_index;                     // 在最小堆中的位置，-1表示未挂起
+    void (*callback)(void* data);       // 到期回调
+    void* data;                         // 回调参数
+};
+
+// 定时器统计结构
+struct timer_stats {
+    unsigned int active;                // 当前挂起的定时器数
+    unsigned int max_active;            // 同时挂起的最大数量
+    unsigned int fired;                 // 已到期触发的定时器数
+    unsigned int cancelled;             // 到期前被取消的定时器数
+    unsigned int overflows;             // 堆满导致添加失败的次数
+};
+
+// 函数声明
+void timer_init();
+void timer_setup(struct timer* timer, void (*callback)(void* data), void* data);
+int timer_add(struct timer* timer, unsigned int expires);
+int timer_cancel(struct timer* timer);
+int timer_pending(const struct timer* timer);
+unsigned int timer_next_expiry();
+unsigned int timer_run_expired(unsigned int now);
+struct timer_stats* timer_get_stats();
+void timer_print_stats();
+
+// 辅助函数
+unsigned int get_current_tick();
+void int_to_string(int value, char* str);
+
+#endif
@@ -2,242 +2,2111 @@
 #include "kernel.h"
 #include "memory.h"
 #include "process.h"
+#include "profiling.h"
+#include "clocksource.h"
+#include "config.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "../drivers/filesystem.h"
 
 // 页目录和页表
 static page_directory_t* kernel_page_directory = 0;
-static page_table_t page_tables[MAX_PAGE_TABLES];
 
-// 页帧位图
-static unsigned char page_frame_bitmap[PAGE_FRAME_BITMAP_SIZE];
+// 每个处理器当前加载的页目录
+static page_directory_t* current_page_directory[MAX_CPUS];
+
+// 两级页帧位图：frame_bitmap每位为1表示页帧空闲，
+// frame_summary每位为1表示frame_bitmap中对应的字不为0
+static unsigned int frame_bitmap[FRAME_BITMAP_WORDS];
+static unsigned int frame_summary[FRAME_SUMMARY_WORDS];
+
+// 下一次单页帧分配开始查找的位置
+static unsigned int next_free_hint = 0;
 
 // 虚拟内存统计
 static struct vm_stats vm_statistics;
 
-// 初始化虚拟内存管理
-void vm_init() {
-    // 初始化页帧位图
-    for (int i = 0; i < PAGE_FRAME_BITMAP_SIZE; i++) {
-        page_frame_bitmap[i] = 0;
+// 虚拟内存锁：保护伙伴空闲链表、页帧位图和引用计数、预清零池、页缓存、压缩存储、区域表、
+// 回收时钟指针和统计，以及对各地址空间页表的修改。公开接口之间相互调用，同一处理器可以重复获取。
+// 中断处理程序不获取它（TLB shootdown IPI只刷新本地TLB），持有期间不关中断、不切换上下文
+// （文件映射缺页时在持有期间调用文件的read，它不能阻塞），
+// 因此等待它的处理器仍能应答持有者发出的TLB shootdown；缺页处理是在关中断时获取的，
+// 自旋期间代为处理发给本处理器的shootdown请求。持有期间访问的都是恒等映射的内核内存，
+// 不会因缺页而重入。获取顺序：共享内存段表锁、虚拟内存锁、内核堆锁
+static spinlock_t vm_spinlock = SPINLOCK_INIT;
+static volatile int vm_lock_owner = -1;
+static unsigned int vm_lock_depth = 0;
+
+static void vm_lock() {
+    int cpu = (int)smp_processor_id();
+    if (vm_lock_owner == cpu) {
+        vm_lock_depth++;
+        return;
+    }
+    
+    while (!spin_trylock(&vm_spinlock)) {
+        smp_tlb_shootdown_poll();
+        __asm__ volatile ("pause");
+    }
+    vm_lock_owner = cpu;
+    vm_lock_depth = 1;
+}
+
+static void vm_unlock() {
+    if (--vm_lock_depth == 0) {
+        vm_lock_owner = -1;
+        spin_unlock(&vm_spinlock);
+    }
+}
+
+// 按需分配的虚拟内存区域，page_dir为0表示空槽
+struct vm_region {
+    page_directory_t* page_dir;  // 所属地址空间
+    unsigned int start;          // 起始地址（页对齐）
+    unsigned int end;            // 结束地址（不含）
+    unsigned int flags;          // VM_REGION_*标志
+    struct fs_node* file;        // 文件映射的文件，匿名区域为0
+    unsigned int file_offset;    // 区域起始处对应的文件偏移（页对齐）
+};
+
+static struct vm_region vm_regions[MAX_VM_REGIONS];
+
+// 文件页缓存项，缓存本身持有页帧的一个引用
+struct page_cache_entry {
+    struct fs_node* node;        // 0表示空项
+    unsigned int index;          // 文件内页号
+    unsigned int frame;
+};
+
+static struct page_cache_entry page_cache[VM_PAGE_CACHE_SETS][VM_PAGE_CACHE_WAYS];
+
+// 压缩存储槽：length为0表示整页为同一个32位值data，否则data为存放压缩数据的页帧，
+// 数据位于该页帧的offset处；空闲槽通过data串成链表
+struct zswap_slot {
+    unsigned int data;
+    unsigned short offset;
+    unsigned short length;
+    unsigned short refs;         // 引用该槽的页表项数（fork后父子共享），0表示空闲
+};
+
+static struct zswap_slot zswap_slots[VM_ZSWAP_SLOTS];
+static unsigned int zswap_free_slot = 0;   // 空闲槽链表头，0表示没有空闲槽（0号槽不使用）
+
+// 正在追加压缩数据的存储页帧及下一个写入位置。存储页帧的引用计数为
+// 其中有效数据块数加上作为当前写入页帧的一个引用，最后一块数据释放时页帧归还
+static unsigned int zswap_frame = 0;
+static unsigned int zswap_offset = 0;
+
+// 压缩输出缓冲区
+static unsigned char zswap_buffer[VM_ZSWAP_MAX_SIZE];
+
+// LZ压缩使用的哈希表：4字节前缀的哈希 -> 页内最近出现的位置
+#define LZ_HASH_BITS 10
+#define LZ_MIN_MATCH 4
+#define LZ_NO_POS    0xFFFF
+static unsigned short lz_hash_table[1 << LZ_HASH_BITS];
+
+// 预清零页帧池（栈），池中的页帧已从伙伴系统取出，由池持有
+static unsigned int zero_pool[VM_ZERO_POOL_MAX];
+static unsigned int zero_pool_count = 0;
+static unsigned int zero_pool_watermark = 0;
+
+// 时钟指针：当前扫描的区域和地址
+static unsigned int clock_region = 0;
+static unsigned int clock_addr = 0;
+
+// 页帧状态
+#define FRAME_RESERVED  0   // 保留（内核占用），不参与伙伴分配
+#define FRAME_FREE      1   // 空闲块的首帧
+#define FRAME_ALLOCATED 2   // 已分配块的首帧
+#define FRAME_TAIL      3   // 块内的非首帧
+
+// 空闲链表结束标记
+#define FRAME_NONE 0xFFFF
+
+// 每个物理页帧的元数据，空闲链表通过帧号串联，不需要访问物理页内容
+struct page_frame {
+    unsigned short next;   // 同阶空闲链表中的下一个块
+    unsigned short prev;   // 同阶空闲链表中的上一个块
+    unsigned char order;   // 块的阶数（仅首帧有效）
+    unsigned char state;   // 页帧状态
+    unsigned short refcount; // 引用计数（已分配的单页帧被多个地址空间共享时大于1）
+};
+
+// 页表项可用位中的写时复制标志
+#define PTE_COW 0x1
+
+// 页表项可用位中的换出标志：页不存在，frame字段保存压缩存储的槽号
+#define PTE_SWAPPED 0x2
+
+// 页表项可用位中的共享内存标志：复制地址空间时保持共享
+#define PTE_SHARED 0x4
+
+static struct page_frame page_frames[TOTAL_PHYSICAL_PAGES];
+
+// 各阶空闲链表头
+static unsigned int free_area[BUDDY_MAX_ORDER + 1];
+
+// 返回最低的置位位序号（value不能为0）
+static inline unsigned int bit_scan_forward(unsigned int value) {
+    unsigned int index;
+    __asm__ ("bsf %1, %0" : "=r"(index) : "rm"(value));
+    return index;
+}
+
+// 根据位图字是否为0更新摘要位
+static inline void summary_update(unsigned int word) {
+    if (frame_bitmap[word]) {
+        frame_summary[word / 32] |= (1u << (word % 32));
+    } else {
+        frame_summary[word / 32] &= ~(1u << (word % 32));
+    }
+}
+
+// 设置页帧位图中一段连续页帧的使用标志
+static void bitmap_set_range(unsigned int frame, unsigned int count, int used) {
+    while (count > 0) {
+        unsigned int word = frame / 32;
+        
+        // 按字对齐时整字设置
+        if (frame % 32 == 0 && count >= 32) {
+            frame_bitmap[word] = used ? 0 : 0xFFFFFFFF;
+            frame += 32;
+            count -= 32;
+        } else {
+            if (used) {
+                frame_bitmap[word] &= ~(1u << (frame % 32));
+            } else {
+                frame_bitmap[word] |= (1u << (frame % 32));
+            }
+            frame++;
+            count--;
+        }
+        
+        summary_update(word);
+    }
+}
+
+// 从start开始（到末尾后回绕）查找空闲页帧，先查起始字，再按摘要位图逐字跳过已满区域
+static unsigned int bitmap_find_free(unsigned int start) {
+    unsigned int word = start / 32;
+    unsigned int bits = frame_bitmap[word] & (0xFFFFFFFF << (start % 32));
+    if (bits) {
+        return word * 32 + bit_scan_forward(bits);
+    }
+    
+    // 起始字之后的摘要位
+    unsigned int index = word / 32;
+    unsigned int summary = (word % 32 == 31) ? 0 : frame_summary[index] & (0xFFFFFFFF << (word % 32 + 1));
+    
+    // 多查一轮以覆盖回绕后起始摘要字中较低的部分
+    for (int i = 0; i <= FRAME_SUMMARY_WORDS; i++) {
+        if (summary) {
+            word = index * 32 + bit_scan_forward(summary);
+            return word * 32 + bit_scan_forward(frame_bitmap[word]);
+        }
+        index = (index + 1) % FRAME_SUMMARY_WORDS;
+        summary = frame_summary[index];
+    }
+    
+    // 没有空闲页帧（页帧0属于内核，可作为失败标记）
+    return 0;
+}
+
+// 将空闲块插入对应阶的链表头部
+static void buddy_insert(unsigned int frame, unsigned int order) {
+    page_frames[frame].state = FRAME_FREE;
+    page_frames[frame].order = order;
+    page_frames[frame].prev = FRAME_NONE;
+    page_frames[frame].next = free_area[order];
+    if (free_area[order] != FRAME_NONE) {
+        page_frames[free_area[order]].prev = frame;
+    }
+    free_area[order] = frame;
+    vm_statistics.buddy_free_blocks[order]++;
+}
+
+// 从对应阶的链表中摘除空闲块
+static void buddy_remove(unsigned int frame, unsigned int order) {
+    struct page_frame* info = &page_frames[frame];
+    
+    if (info->prev != FRAME_NONE) {
+        page_frames[info->prev].next = info->next;
+    } else {
+        free_area[order] = info->next;
+    }
+    if (info->next != FRAME_NONE) {
+        page_frames[info->next].prev = info->prev;
+    }
+    info->state = FRAME_TAIL;
+    vm_statistics.buddy_free_blocks[order]--;
+}
+
+// 将块标记为已分配，同步位图和统计信息
+static void buddy_mark_allocated(unsigned int frame, unsigned int order) {
+    page_frames[frame].state = FRAME_ALLOCATED;
+    page_frames[frame].order = order;
+    page_frames[frame].refcount = 1;
+    bitmap_set_range(frame, 1 << order, 1);
+    
+    vm_statistics.used_pages += 1 << order;
+    vm_statistics.free_pages -= 1 << order;
+}
+
+// 将一段空闲页帧按最大对齐块加入伙伴系统
+static void buddy_add_range(unsigned int start, unsigned int end) {
+    while (start < end) {
+        unsigned int order = BUDDY_MAX_ORDER;
+        while (order > 0 && ((start & ((1 << order) - 1)) != 0 || start + (1 << order) > end)) {
+            order--;
+        }
+        buddy_insert(start, order);
+        start += 1 << order;
+    }
+}
+
+// 初始化伙伴分配器，first_free之前的页帧保留给内核
+static void buddy_init(unsigned int first_free) {
+    for (int i = 0; i <= BUDDY_MAX_ORDER; i++) {
+        free_area[i] = FRAME_NONE;
+        vm_statistics.buddy_free_blocks[i] = 0;
+    }
+    vm_statistics.buddy_splits = 0;
+    vm_statistics.buddy_merges = 0;
+    
+    for (unsigned int i = 0; i < TOTAL_PHYSICAL_PAGES; i++) {
+        page_frames[i].state = i < first_free ? FRAME_RESERVED : FRAME_TAIL;
+        page_frames[i].order = 0;
+    }
+    
+    buddy_add_range(first_free, TOTAL_PHYSICAL_PAGES);
+    bitmap_set_range(first_free, TOTAL_PHYSICAL_PAGES - first_free, 0);
+    next_free_hint = first_free;
+}
+
+// 分配2^order个物理连续且按块大小对齐的页帧，返回首帧号，失败返回0
+static unsigned int alloc_pages_locked(unsigned int order) {
+    if (order > BUDDY_MAX_ORDER) {
+        return 0;
+    }
+    
+    // 找到满足要求的最小阶空闲块
+    unsigned int current = order;
+    while (current <= BUDDY_MAX_ORDER && free_area[current] == FRAME_NONE) {
+        current++;
+    }
+    if (current > BUDDY_MAX_ORDER) {
+        return 0;
+    }
+    
+    unsigned int frame = free_area[current];
+    buddy_remove(frame, current);
+    
+    // 逐级分裂，把后一半放回低一阶的链表
+    while (current > order) {
+        current--;
+        buddy_insert(frame + (1 << current), current);
+        vm_statistics.buddy_splits++;
+    }
+    
+    buddy_mark_allocated(frame, order);
+    return frame;
+}
+
+// 释放alloc_pages分配的块，并与空闲的伙伴块逐级合并
+static void free_pages_locked(unsigned int frame, unsigned int order) {
+    if (frame >= TOTAL_PHYSICAL_PAGES || order > BUDDY_MAX_ORDER) {
+        return;
+    }
+    
+    if (page_frames[frame].state != FRAME_ALLOCATED || page_frames[frame].order != order) {
+        print_string("Warning: free_pages called on a frame that is not an allocated block\n");
+        return;
+    }
+    
+    bitmap_set_range(frame, 1 << order, 0);
+    vm_statistics.used_pages -= 1 << order;
+    vm_statistics.free_pages += 1 << order;
+    page_frames[frame].state = FRAME_TAIL;
+    
+    while (order < BUDDY_MAX_ORDER) {
+        unsigned int buddy = frame ^ (1 << order);
+        if (buddy >= TOTAL_PHYSICAL_PAGES ||
+            page_frames[buddy].state != FRAME_FREE || page_frames[buddy].order != order) {
+            break;
+        }
+        buddy_remove(buddy, order);
+        if (buddy < frame) {
+            frame = buddy;
+        }
+        order++;
+        vm_statistics.buddy_merges++;
+    }
+    
+    buddy_insert(frame, order);
+}
+
+// 从伙伴系统中取出指定的单个空闲页帧：找到包含它的空闲块，
+// 把不含该帧的一半逐级放回空闲链表
+static void buddy_claim_frame(unsigned int frame) {
+    unsigned int order = 0;
+    unsigned int block = frame;
+    
+    while (order <= BUDDY_MAX_ORDER) {
+        block = frame & ~((1 << order) - 1);
+        if (page_frames[block].state == FRAME_FREE && page_frames[block].order == order) {
+            break;
+        }
+        order++;
+    }
+    if (order > BUDDY_MAX_ORDER) {
+        return;
+    }
+    
+    buddy_remove(block, order);
+    while (order > 0) {
+        order--;
+        unsigned int half = 1 << order;
+        if (frame < block + half) {
+            buddy_insert(block + half, order);
+        } else {
+            buddy_insert(block, order);
+            block += half;
+        }
+        vm_statistics.buddy_splits++;
+    }
+    
+    buddy_mark_allocated(frame, 0);
+}
+
+// 用字写清零一页
+static void zero_page(void* page) {
+    unsigned int words = PAGE_SIZE / 4;
+    
+    __asm__ volatile (
+        "cld\n\t"
+        "rep stosl"
+        : "+D"(page), "+c"(words)
+        : "a"(0)
+        : "memory"
+    );
+}
+
+// 复制一页内容
+static void copy_page(void* dest, const void* src) {
+    unsigned int words = PAGE_SIZE / 4;
+    
+    __asm__ volatile (
+        "cld\n\t"
+        "rep movsl"
+        : "+D"(dest), "+S"(src), "+c"(words)
+        :
+        : "memory"
+    );
+}
+
+// 分配一个清零的页帧用作页目录或页表（物理内存按恒等映射访问）
+static void* vm_allocate_table_frame() {
+    unsigned int frame = vm_allocate_zeroed_frame();
+    if (frame == 0) {
+        return 0;
+    }
+    
+    vm_statistics.page_table_frames++;
+    return (void*)(frame << 12);
+}
+
+// 初始化虚拟内存管理
+void vm_init() {
+    // 初始化页帧位图，全部标记为已使用，空闲页帧由伙伴分配器初始化时标记
+    for (int i = 0; i < FRAME_BITMAP_WORDS; i++) {
+        frame_bitmap[i] = 0;
+    }
+    for (int i = 0; i < FRAME_SUMMARY_WORDS; i++) {
+        frame_summary[i] = 0;
+    }
+    
+    // 初始化虚拟内存统计
+    vm_statistics.total_pages = TOTAL_PHYSICAL_PAGES;
+    vm_statistics.used_pages = 1024; // 内核占用的页
+    vm_statistics.free_pages = TOTAL_PHYSICAL_PAGES - 1024;
+    vm_statistics.page_faults = 0;
+    vm_statistics.minor_faults = 0;
+    vm_statistics.minor_fault_time = 0;
+    vm_statistics.minor_fault_time_max = 0;
+    vm_statistics.cow_faults = 0;
+    vm_statistics.cow_copies = 0;
+    vm_statistics.page_table_frames = 0;
+    vm_statistics.large_pages = 0;
+    vm_statistics.tlb_page_flushes = 0;
+    vm_statistics.tlb_full_flushes = 0;
+    vm_statistics.tlb_shootdowns = 0;
+    vm_statistics.address_space_switches = 0;
+    vm_statistics.file_faults = 0;
+    vm_statistics.page_cache_hits = 0;
+    vm_statistics.reclaim_scanned = 0;
+    vm_statistics.reclaimed_pages = 0;
+    vm_statistics.reclaim_dropped = 0;
+    vm_statistics.zswap_rejected = 0;
+    vm_statistics.swap_ins = 0;
+    vm_statistics.zswap_pages = 0;
+    vm_statistics.zswap_same_filled = 0;
+    vm_statistics.zswap_bytes = 0;
+    vm_statistics.zswap_frames = 0;
+    vm_statistics.zero_pool_frames = 0;
+    
+    for (int i = 0; i < MAX_VM_REGIONS; i++) {
+        vm_regions[i].page_dir = 0;
+    }
+    for (int i = 0; i < VM_PAGE_CACHE_SETS; i++) {
+        for (int j = 0; j < VM_PAGE_CACHE_WAYS; j++) {
+            page_cache[i][j].node = 0;
+        }
+    }
+    
+    // 压缩存储槽全部空闲（0号槽保留表示“无”）
+    for (unsigned int i = 1; i < VM_ZSWAP_SLOTS; i++) {
+        zswap_slots[i].data = (i + 1 < VM_ZSWAP_SLOTS) ? i + 1 : 0;
+        zswap_slots[i].refs = 0;
+    }
+    zswap_free_slot = 1;
+    zswap_frame = 0;
+    zswap_offset = 0;
+    
+    // 预清零页帧池在空闲时才开始补充
+    zero_pool_count = 0;
+    vm_set_zero_pool_watermark(config_get_zero_pool_watermark());
+    
+    // 其余页帧交给伙伴分配器管理
+    buddy_init(1024);
+    
+    // 创建内核页目录（页对齐的清零页帧）
+    kernel_page_directory = (page_directory_t*)vm_allocate_table_frame();
+    if (!kernel_page_directory) {
+        print_string("Error: Failed to allocate kernel page directory\n");
+        return;
+    }
+    
+    // 用4MB大页恒等映射全部物理内存：内核映像和页表都能按物理地址直接访问，
+    // 只占用页目录项而不需要页表，且标记为全局页在切换地址空间时保留TLB项
+    for (unsigned int addr = 0; addr < PHYSICAL_MEMORY_SIZE; addr += LARGE_PAGE_SIZE) {
+        vm_map_large_page(kernel_page_directory, addr, addr, 0, 1);
+        kernel_page_directory->entries[addr >> 22].global = 1;
+    }
+    
+    // 预先建好内核高端窗口的全部页表，新建的地址空间复制这些页目录项后就能看到以后加入的设备映射
+    for (unsigned int i = VM_KERNEL_HIGH_BASE >> 22; i < 1024; i++) {
+        page_table_t* table = vm_create_page_table();
+        if (!table) {
+            print_string("Error: Failed to allocate kernel page tables\n");
+            return;
+        }
+        kernel_page_directory->entries[i].present = 1;
+        kernel_page_directory->entries[i].rw = 1;
+        kernel_page_directory->entries[i].frame = ((unsigned int)table) >> 12;
+    }
+    
+    // 启用4MB页和全局页
+    enable_large_pages();
+    
+    // 加载页目录到CR3寄存器
+    load_page_directory(kernel_page_directory);
+    
+    // 启用分页
+    enable_paging();
+    
+    print_string("Virtual memory management initialized\n");
+    print_string("Total pages: ");
+    char pages_str[16];
+    int_to_string(vm_statistics.total_pages, pages_str);
+    print_string(pages_str);
+    print_string("\n");
+}
+
+// 分配一个空闲页帧，不触发回收
+static unsigned int vm_take_free_frame() {
+    // 从上次分配的位置继续查找空闲页帧
+    unsigned int frame = bitmap_find_free(next_free_hint);
+    if (frame == 0) {
+        // 没有空闲页帧
+        return 0;
+    }
+    
+    // 从伙伴系统中取出该页帧（同时更新位图和统计信息）
+    buddy_claim_frame(frame);
+    next_free_hint = (frame + 1) % TOTAL_PHYSICAL_PAGES;
+    
+    // 返回页帧号
+    return frame;
+}
+
+// 分配页帧，没有空闲页帧时先动用预清零页帧池，再回收一批冷页后重试
+static unsigned int vm_allocate_frame_locked() {
+    unsigned int frame = vm_take_free_frame();
+    if (frame == 0 && zero_pool_count > 0) {
+        frame = zero_pool[--zero_pool_count];
+        vm_statistics.zero_pool_frames = zero_pool_count;
+    }
+    if (frame == 0 && vm_reclaim_pages(VM_RECLAIM_BATCH) > 0) {
+        frame = vm_take_free_frame();
+    }
+    return frame;
+}
+
+// 分配一个内容全为0的页帧，优先从预清零页帧池中取，池为空时当场清零
+static unsigned int vm_allocate_zeroed_frame_locked() {
+    if (zero_pool_count > 0) {
+        unsigned int frame = zero_pool[--zero_pool_count];
+        vm_statistics.zero_pool_frames = zero_pool_count;
+        profiling_zero_pool_hit();
+        return frame;
+    }
+    
+    unsigned int frame = vm_allocate_frame();
+    if (frame != 0) {
+        zero_page((void*)(frame << 12));
+        profiling_zero_pool_miss();
+    }
+    return frame;
+}
+
+// 在空闲时补充预清零页帧池，每次最多清零VM_ZERO_POOL_REFILL_BATCH个页帧；
+// 空闲页帧不多时不补充，避免池与页回收争抢内存
+static void vm_refill_zero_pool_locked() {
+    if (zero_pool_count >= zero_pool_watermark) {
+        return;
+    }
+    
+    unsigned long long start_time = profiling_get_timestamp();
+    unsigned int refilled = 0;
+    
+    while (zero_pool_count < zero_pool_watermark && refilled < VM_ZERO_POOL_REFILL_BATCH &&
+           vm_statistics.free_pages > VM_RECLAIM_BATCH) {
+        unsigned int frame = vm_take_free_frame();
+        if (frame == 0) {
+            break;
+        }
+        zero_page((void*)(frame << 12));
+        zero_pool[zero_pool_count++] = frame;
+        refilled++;
+    }
+    
+    vm_statistics.zero_pool_frames = zero_pool_count;
+    if (refilled > 0) {
+        profiling_zero_pool_refill(refilled, profiling_get_timestamp() - start_time);
+    }
+}
+
+// 设置预清零页帧池的水位，降低时立即归还多余的页帧
+static void vm_set_zero_pool_watermark_locked(unsigned int watermark) {
+    if (watermark > VM_ZERO_POOL_MAX) {
+        watermark = VM_ZERO_POOL_MAX;
+    }
+    zero_pool_watermark = watermark;
+    
+    while (zero_pool_count > zero_pool_watermark) {
+        vm_free_frame(zero_pool[--zero_pool_count]);
+    }
+    vm_statistics.zero_pool_frames = zero_pool_count;
+}
+
+// 批量分配count个页帧写入frames，按最大可能的阶从伙伴系统整块取出再拆成单页帧，
+// 全部成功返回count，否则释放已分配的页帧并返回0
+static int vm_allocate_frames_locked(unsigned int count, unsigned int* frames) {
+    unsigned int allocated = 0;
+    
+    if (!frames) {
+        return 0;
+    }
+    
+    while (allocated < count) {
+        unsigned int order = BUDDY_MAX_ORDER;
+        while (order > 0 && (1u << order) > count - allocated) {
+            order--;
+        }
+        
+        unsigned int block = alloc_pages(order);
+        while (block == 0 && order > 0) {
+            order--;
+            block = alloc_pages(order);
+        }
+        if (block == 0) {
+            // 内存不足，回滚
+            for (unsigned int i = 0; i < allocated; i++) {
+                vm_free_frame(frames[i]);
+            }
+            return 0;
+        }
+        
+        // 拆分为可单独释放的单页帧
+        for (unsigned int i = 0; i < (1u << order); i++) {
+            page_frames[block + i].state = FRAME_ALLOCATED;
+            page_frames[block + i].order = 0;
+            page_frames[block + i].refcount = 1;
+            frames[allocated++] = block + i;
+        }
+    }
+    
+    return count;
+}
+
+// 释放页帧（减少一次引用，最后一个引用释放时才真正归还）
+static void vm_free_frame_locked(unsigned int frame) {
+    if (frame < TOTAL_PHYSICAL_PAGES && page_frames[frame].state == FRAME_ALLOCATED &&
+        page_frames[frame].refcount > 1) {
+        page_frames[frame].refcount--;
+        return;
+    }
+    
+    // 归还给伙伴系统，并与相邻空闲块合并
+    free_pages(frame, 0);
+    
+    // 刚释放的页帧最可能仍在缓存中，下一次优先从这里分配
+    if (frame < TOTAL_PHYSICAL_PAGES && page_frames[frame].state != FRAME_ALLOCATED) {
+        next_free_hint = frame;
+    }
+}
+
+// 增加页帧引用计数（页帧被另一个地址空间共享时调用）
+static void vm_ref_frame_locked(unsigned int frame) {
+    if (frame < TOTAL_PHYSICAL_PAGES && page_frames[frame].state == FRAME_ALLOCATED) {
+        page_frames[frame].refcount++;
+    }
+}
+
+// 获取页帧引用计数，未分配的页帧返回0
+static unsigned int vm_frame_refcount_locked(unsigned int frame) {
+    if (frame >= TOTAL_PHYSICAL_PAGES || page_frames[frame].state != FRAME_ALLOCATED) {
+        return 0;
+    }
+    return page_frames[frame].refcount;
+}
+
+// 计算4字节前缀的哈希
+static inline unsigned int lz_hash(const unsigned char* p) {
+    unsigned int value = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// 写入扩展长度：逐字节累加，255表示后面还有
+static int lz_put_length(unsigned char* dst, unsigned int* out, unsigned int limit, unsigned int length) {
+    while (length >= 255) {
+        if (*out >= limit) {
+            return -1;
+        }
+        dst[(*out)++] = 255;
+        length -= 255;
+    }
+    if (*out >= limit) {
+        return -1;
+    }
+    dst[(*out)++] = (unsigned char)length;
+    return 0;
+}
+
+// 读取扩展长度并累加到length
+static int lz_get_length(const unsigned char* src, unsigned int* in, unsigned int size, unsigned int* length) {
+    unsigned int byte;
+    do {
+        if (*in >= size) {
+            return -1;
+        }
+        byte = src[(*in)++];
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+// 输出一个序列：标记字节（高4位为字面量长度，低4位为匹配长度-4，为15时后跟扩展长度）、
+// 字面量、2字节匹配偏移；match_length为0表示页末尾只有字面量的最后一个序列
+static int lz_emit(const unsigned char* literals, unsigned int literal_length,
+                   unsigned int offset, unsigned int match_length,
+                   unsigned char* dst, unsigned int* out, unsigned int limit) {
+    unsigned int literal_code = literal_length < 15 ? literal_length : 15;
+    unsigned int match_code = 0;
+    if (match_length) {
+        match_code = match_length - LZ_MIN_MATCH < 15 ? match_length - LZ_MIN_MATCH : 15;
+    }
+    
+    if (*out >= limit) {
+        return -1;
+    }
+    dst[(*out)++] = (unsigned char)((literal_code << 4) | match_code);
+    if (literal_code == 15 && lz_put_length(dst, out, limit, literal_length - 15) != 0) {
+        return -1;
+    }
+    
+    if (*out + literal_length + (match_length ? 2 : 0) > limit) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < literal_length; i++) {
+        dst[(*out)++] = literals[i];
+    }
+    
+    if (match_length) {
+        dst[(*out)++] = (unsigned char)(offset & 0xFF);
+        dst[(*out)++] = (unsigned char)(offset >> 8);
+        if (match_code == 15 && lz_put_length(dst, out, limit, match_length - LZ_MIN_MATCH - 15) != 0) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+// 压缩一页（LZ77变体，匹配窗口为整页），输出超过limit字节时放弃并返回0，否则返回压缩后的长度
+static unsigned int lz_compress(const unsigned char* src, unsigned char* dst, unsigned int limit) {
+    unsigned int in = 0;
+    unsigned int anchor = 0;
+    unsigned int out = 0;
+    
+    for (int i = 0; i < (1 << LZ_HASH_BITS); i++) {
+        lz_hash_table[i] = LZ_NO_POS;
+    }
+    
+    while (in + LZ_MIN_MATCH <= PAGE_SIZE) {
+        unsigned int hash = lz_hash(src + in);
+        unsigned int candidate = lz_hash_table[hash];
+        lz_hash_table[hash] = (unsigned short)in;
+        
+        if (candidate == LZ_NO_POS || src[candidate] != src[in] || src[candidate + 1] != src[in + 1] ||
+            src[candidate + 2] != src[in + 2] || src[candidate + 3] != src[in + 3]) {
+            in++;
+            continue;
+        }
+        
+        unsigned int length = LZ_MIN_MATCH;
+        while (in + length < PAGE_SIZE && src[candidate + length] == src[in + length]) {
+            length++;
+        }
+        
+        if (lz_emit(src + anchor, in - anchor, in - candidate, length, dst, &out, limit) != 0) {
+            return 0;
+        }
+        in += length;
+        anchor = in;
+    }
+    
+    if (anchor < PAGE_SIZE && lz_emit(src + anchor, PAGE_SIZE - anchor, 0, 0, dst, &out, limit) != 0) {
+        return 0;
+    }
+    
+    return out;
+}
+
+// 解压出一整页，数据损坏时返回-1
+static int lz_decompress(const unsigned char* src, unsigned int size, unsigned char* dst) {
+    unsigned int in = 0;
+    unsigned int out = 0;
+    
+    while (out < PAGE_SIZE) {
+        if (in >= size) {
+            return -1;
+        }
+        unsigned int token = src[in++];
+        
+        unsigned int literal_length = token >> 4;
+        if (literal_length == 15 && lz_get_length(src, &in, size, &literal_length) != 0) {
+            return -1;
+        }
+        if (literal_length > PAGE_SIZE - out || literal_length > size - in) {
+            return -1;
+        }
+        for (unsigned int i = 0; i < literal_length; i++) {
+            dst[out++] = src[in++];
+        }
+        if (out == PAGE_SIZE) {
+            break;
+        }
+        
+        if (in + 2 > size) {
+            return -1;
+        }
+        unsigned int offset = src[in] | (src[in + 1] << 8);
+        in += 2;
+        unsigned int match_length = (token & 0xF) + LZ_MIN_MATCH;
+        if ((token & 0xF) == 15 && lz_get_length(src, &in, size, &match_length) != 0) {
+            return -1;
+        }
+        if (offset == 0 || offset > out || match_length > PAGE_SIZE - out) {
+            return -1;
+        }
+        
+        // 逐字节复制，允许与输出重叠（重复的短模式）
+        for (unsigned int i = 0; i < match_length; i++) {
+            dst[out] = dst[out - offset];
+            out++;
+        }
+    }
+    
+    return 0;
+}
+
+// 释放存储页帧的一个引用，页帧归还时更新统计
+static void zswap_put_frame(unsigned int frame) {
+    vm_free_frame(frame);
+    if (vm_frame_refcount(frame) == 0) {
+        vm_statistics.zswap_frames--;
+    }
+}
+
+// 分配一个压缩存储槽，没有空闲槽时返回0
+static unsigned int zswap_alloc_slot() {
+    unsigned int slot = zswap_free_slot;
+    if (slot == 0) {
+        return 0;
+    }
+    
+    zswap_free_slot = zswap_slots[slot].data;
+    zswap_slots[slot].refs = 1;
+    vm_statistics.zswap_pages++;
+    return slot;
+}
+
+// 释放页表项对槽的一个引用，最后一个引用释放时归还槽和压缩数据
+static void zswap_put_slot(unsigned int slot) {
+    if (slot == 0 || slot >= VM_ZSWAP_SLOTS || zswap_slots[slot].refs == 0) {
+        return;
+    }
+    
+    struct zswap_slot* entry = &zswap_slots[slot];
+    if (--entry->refs > 0) {
+        return;
+    }
+    
+    if (entry->length == 0) {
+        vm_statistics.zswap_same_filled--;
+    } else {
+        vm_statistics.zswap_bytes -= entry->length;
+        zswap_put_frame(entry->data);
+    }
+    vm_statistics.zswap_pages--;
+    
+    entry->data = zswap_free_slot;
+    zswap_free_slot = slot;
+}
+
+// 将页帧内容存入压缩存储，返回槽号，不可压缩或槽位用尽时返回0。压缩数据依次追加到
+// 存储页帧中，没有空闲页帧作为新的存储页帧时直接复用被换出的页帧，回收本身不需要额外内存；
+// 存储页帧在其中全部数据失效后才归还，不做整理
+static unsigned int zswap_store(unsigned int frame) {
+    const unsigned int* words = (const unsigned int*)(frame << 12);
+    unsigned int slot;
+    
+    // 整页为同一个值（最常见的是全0）时只记录该值
+    unsigned int i = 1;
+    while (i < PAGE_SIZE / 4 && words[i] == words[0]) {
+        i++;
+    }
+    if (i == PAGE_SIZE / 4) {
+        slot = zswap_alloc_slot();
+        if (slot) {
+            zswap_slots[slot].data = words[0];
+            zswap_slots[slot].offset = 0;
+            zswap_slots[slot].length = 0;
+            vm_statistics.zswap_same_filled++;
+        }
+        return slot;
+    }
+    
+    unsigned int length = lz_compress((const unsigned char*)words, zswap_buffer, VM_ZSWAP_MAX_SIZE);
+    if (length == 0) {
+        vm_statistics.zswap_rejected++;
+        return 0;
+    }
+    
+    slot = zswap_alloc_slot();
+    if (slot == 0) {
+        return 0;
+    }
+    
+    // 当前存储页帧放不下时换一个新的
+    if (zswap_frame == 0 || zswap_offset + length > PAGE_SIZE) {
+        unsigned int storage = vm_take_free_frame();
+        if (storage == 0) {
+            // 换出方随后释放映射持有的引用，这里另加的引用由存储持有
+            storage = frame;
+            vm_ref_frame(storage);
+        }
+        if (zswap_frame) {
+            zswap_put_frame(zswap_frame);
+        }
+        zswap_frame = storage;
+        zswap_offset = 0;
+        vm_statistics.zswap_frames++;
+    }
+    
+    unsigned char* dest = (unsigned char*)(zswap_frame << 12) + zswap_offset;
+    for (unsigned int j = 0; j < length; j++) {
+        dest[j] = zswap_buffer[j];
+    }
+    
+    zswap_slots[slot].data = zswap_frame;
+    zswap_slots[slot].offset = (unsigned short)zswap_offset;
+    zswap_slots[slot].length = (unsigned short)length;
+    vm_ref_frame(zswap_frame);
+    zswap_offset += length;
+    vm_statistics.zswap_bytes += length;
+    
+    return slot;
+}
+
+// 将槽中的页内容恢复到页帧
+static int zswap_load(unsigned int slot, unsigned int frame) {
+    struct zswap_slot* entry = &zswap_slots[slot];
+    
+    if (entry->length == 0) {
+        unsigned int* words = (unsigned int*)(frame << 12);
+        for (int i = 0; i < PAGE_SIZE / 4; i++) {
+            words[i] = entry->data;
+        }
+        return 0;
+    }
+    
+    return lz_decompress((const unsigned char*)(entry->data << 12) + entry->offset, entry->length,
+                         (unsigned char*)(frame << 12));
+}
+
+// 创建页表（从页帧分配器获取一个清零的页帧）
+static page_table_t* vm_create_page_table_locked() {
+    return (page_table_t*)vm_allocate_table_frame();
+}
+
+// 用一个4MB大页映射虚拟地址到物理地址，两者都必须按4MB对齐
+static int vm_map_large_page_locked(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, int user, int rw) {
+    if (!page_dir || (virtual_addr & (LARGE_PAGE_SIZE - 1)) || (physical_addr & (LARGE_PAGE_SIZE - 1))) {
+        return -1;
+    }
+    
+    page_directory_entry_t* pde = &page_dir->entries[virtual_addr >> 22];
+    
+    // 已经有4KB页表的区域不能覆盖
+    if (pde->present && !pde->page_size) {
+        return -1;
+    }
+    if (!pde->present) {
+        vm_statistics.large_pages++;
+    }
+    
+    pde->present = 1;
+    pde->rw = rw;
+    pde->user = user;
+    pde->page_size = 1;
+    pde->frame = physical_addr >> 12;
+    
+    flush_tlb_entry(virtual_addr);
+    
+    return 0;
+}
+
+// 设置虚拟地址到物理地址的页表项，不刷新TLB
+static int vm_set_pte(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, int user, int rw) {
+    
+    // 计算页目录索引和页表索引
+    unsigned int page_dir_index = virtual_addr >> 22;
+    unsigned int page_table_index = (virtual_addr >> 12) & 0x3FF;
+    
+    // 4MB大页覆盖的区域不能再映射单个页
+    if (page_dir->entries[page_dir_index].present && page_dir->entries[page_dir_index].page_size) {
+        return -1;
+    }
+    
+    // 如果页目录项不存在，则创建页表
+    if (!page_dir->entries[page_dir_index].present) {
+        page_table_t* new_table = vm_create_page_table();
+        if (!new_table) {
+            return -1;
+        }
+        
+        // 设置页目录项
+        page_dir->entries[page_dir_index].present = 1;
+        page_dir->entries[page_dir_index].rw = rw;
+        page_dir->entries[page_dir_index].user = user;
+        page_dir->entries[page_dir_index].frame = ((unsigned int)new_table) >> 12;
+    }
+    
+    // 页目录项的权限需覆盖其下所有页
+    page_dir->entries[page_dir_index].rw |= rw;
+    page_dir->entries[page_dir_index].user |= user;
+    
+    // 获取页表
+    page_table_t* table = (page_table_t*)(page_dir->entries[page_dir_index].frame << 12);
+    
+    // 覆盖已换出的页时释放其压缩数据
+    page_table_entry_t* pte = &table->entries[page_table_index];
+    if (!pte->present && (pte->available & PTE_SWAPPED)) {
+        zswap_put_slot(pte->frame);
+        pte->available = 0;
+    }
+    
+    // 设置页表项，清除上一次映射留下的访问位和脏位
+    pte->present = 1;
+    pte->rw = rw;
+    pte->user = user;
+    pte->accessed = 0;
+    pte->dirty = 0;
+    pte->frame = physical_addr >> 12;
+    
+    return 0;
+}
+
+// 映射虚拟地址到物理地址
+static int vm_map_page_locked(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, int user, int rw) {
+    if (!page_dir || vm_set_pte(page_dir, virtual_addr, physical_addr, user, rw) != 0) {
+        return -1;
+    }
+    
+    // 只有当前地址空间的TLB中可能存在旧条目
+    if (page_dir == current_page_directory[smp_processor_id()]) {
+        flush_tlb_entry(virtual_addr);
+        vm_statistics.tlb_page_flushes++;
+    }
+    
+    return 0;
+}
+
+// 查找包含指定地址的虚拟内存区域
+static struct vm_region* vm_find_region(page_directory_t* page_dir, unsigned int addr) {
+    for (int i = 0; i < MAX_VM_REGIONS; i++) {
+        if (vm_regions[i].page_dir == page_dir &&
+            addr >= vm_regions[i].start && addr < vm_regions[i].end) {
+            return &vm_regions[i];
+        }
+    }
+    return 0;
+}
+
+// 获取虚拟地址对应的页表项，页表不存在时返回0
+static page_table_entry_t* vm_get_pte(page_directory_t* page_dir, unsigned int virtual_addr) {
+    unsigned int page_dir_index = virtual_addr >> 22;
+    unsigned int page_table_index = (virtual_addr >> 12) & 0x3FF;
+    
+    if (!page_dir->entries[page_dir_index].present || page_dir->entries[page_dir_index].page_size) {
+        return 0;
+    }
+    
+    page_table_t* table = (page_table_t*)(page_dir->entries[page_dir_index].frame << 12);
+    return &table->entries[page_table_index];
+}
+
+// 刷新本处理器TLB中的一段地址：页数少时逐页invlpg，页数多时重新加载当前的CR3，内核的全局页不受影响。
+// 也由TLB shootdown IPI调用
+void vm_flush_tlb_local(unsigned int virtual_addr, unsigned int pages) {
+    if (pages > TLB_FLUSH_THRESHOLD) {
+        __asm__ volatile (
+            "mov %%cr3, %%eax\n\t"
+            "mov %%eax, %%cr3"
+            :
+            :
+            : "eax", "memory"
+        );
+        vm_statistics.tlb_full_flushes++;
+        return;
+    }
+    
+    for (unsigned int i = 0; i < pages; i++) {
+        flush_tlb_entry(virtual_addr + i * PAGE_SIZE);
+    }
+    vm_statistics.tlb_page_flushes += pages;
+}
+
+// 除本处理器外可能缓存了page_dir中映射的处理器：CR3仍指向该页目录的处理器（进程离开后CR3保持不变），
+// 内核页目录的页表被所有地址空间共享，所有处理器都可能缓存
+static unsigned int vm_tlb_remote_cpus(page_directory_t* page_dir) {
+    unsigned int self = smp_processor_id();
+    unsigned int cpus = 0;
+    
+    for (unsigned int cpu = 0; cpu < smp_num_cpus(); cpu++) {
+        if (cpu != self && smp_cpu_online(cpu) &&
+            (page_dir == kernel_page_directory || current_page_directory[cpu] == page_dir)) {
+            cpus |= 1u << cpu;
+        }
+    }
+    return cpus;
+}
+
+// 批量修改映射后统一刷新TLB：不在任何处理器上使用的地址空间无需刷新；
+// 其他处理器通过TLB shootdown IPI刷新，返回时都已完成，被撤销映射的页帧可以释放
+static void vm_flush_range(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int pages) {
+    if (pages == 0) {
+        return;
+    }
+    
+    if (page_dir == current_page_directory[smp_processor_id()] || page_dir == kernel_page_directory) {
+        vm_flush_tlb_local(virtual_addr, pages);
+    }
+    
+    unsigned int cpus = vm_tlb_remote_cpus(page_dir);
+    if (cpus) {
+        smp_tlb_shootdown(cpus, virtual_addr, pages);
+        vm_statistics.tlb_shootdowns++;
+    }
+}
+
+// 释放映射持有的页帧引用，只处理单页帧分配；
+// alloc_pages整块分配的页帧由调用者用free_pages释放，设备内存等不受分配器管理的页帧不处理
+static void vm_put_mapped_frame(unsigned int frame) {
+    if (vm_frame_refcount(frame) > 0 && page_frames[frame].order == 0) {
+        vm_free_frame(frame);
+    }
+}
+
+// 映射一段连续的虚拟地址到连续的物理地址，全部设置完成后只刷新一次TLB
+static int vm_map_range_locked(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, unsigned int size, int user, int rw) {
+    if (!page_dir || (virtual_addr & (PAGE_SIZE - 1)) || (physical_addr & (PAGE_SIZE - 1))) {
+        return -1;
+    }
+    
+    unsigned int pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    unsigned int mapped = 0;
+    int result = 0;
+    
+    while (mapped < pages) {
+        if (vm_set_pte(page_dir, virtual_addr + mapped * PAGE_SIZE,
+                       physical_addr + mapped * PAGE_SIZE, user, rw) != 0) {
+            result = -1;
+            break;
+        }
+        mapped++;
+    }
+    
+    vm_flush_range(page_dir, virtual_addr, mapped);
+    return result;
+}
+
+// 取消一段虚拟地址的映射并释放映射持有的页帧引用。页帧要等所有处理器的TLB都刷新后才能释放，
+// 先攒下最多VM_UNMAP_BATCH个，批满或结束时刷新一次TLB再统一释放
+static void vm_unmap_range_locked(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int size) {
+    if (!page_dir) {
+        return;
+    }
+    
+    unsigned int start = virtual_addr & ~(PAGE_SIZE - 1);
+    unsigned int pages = (virtual_addr + size - start + PAGE_SIZE - 1) / PAGE_SIZE;
+    unsigned int frames[VM_UNMAP_BATCH];
+    unsigned int count = 0;
+    unsigned int flushed = 0;
+    
+    for (unsigned int i = 0; i < pages; i++) {
+        page_table_entry_t* pte = vm_get_pte(page_dir, start + i * PAGE_SIZE);
+        if (pte && pte->present) {
+            frames[count++] = pte->frame;
+            pte->present = 0;
+            pte->available = 0;
+            pte->frame = 0;
+        } else if (pte && (pte->available & PTE_SWAPPED)) {
+            zswap_put_slot(pte->frame);
+            pte->available = 0;
+            pte->frame = 0;
+        }
+    
+        if (count == VM_UNMAP_BATCH) {
+            vm_flush_range(page_dir, start + flushed * PAGE_SIZE, i + 1 - flushed);
+            for (unsigned int j = 0; j < count; j++) {
+                vm_put_mapped_frame(frames[j]);
+            }
+            count = 0;
+            flushed = i + 1;
+        }
+    }
+    
+    vm_flush_range(page_dir, start + flushed * PAGE_SIZE, pages - flushed);
+    for (unsigned int j = 0; j < count; j++) {
+        vm_put_mapped_frame(frames[j]);
+    }
+}
+
+// 添加一个区域记录，与同一地址空间的已有区域重叠时失败
+static struct vm_region* vm_add_region(page_directory_t* page_dir, unsigned int start, unsigned int end,
+                                       unsigned int flags, struct fs_node* file, unsigned int file_offset) {
+    struct vm_region* free_slot = 0;
+    
+    // 内核范围的页表由所有地址空间共享，不能在其中建立用户区域
+    if (start < VM_KERNEL_LOW_END || end > VM_KERNEL_HIGH_BASE) {
+        return 0;
+    }
+    
+    for (int i = 0; i < MAX_VM_REGIONS; i++) {
+        if (!vm_regions[i].page_dir) {
+            if (!free_slot) {
+                free_slot = &vm_regions[i];
+            }
+        } else if (vm_regions[i].page_dir == page_dir &&
+                   start < vm_regions[i].end && vm_regions[i].start < end) {
+            return 0;
+        }
+    }
+    if (!free_slot) {
+        return 0;
+    }
+    
+    free_slot->page_dir = page_dir;
+    free_slot->start = start;
+    free_slot->end = end;
+    free_slot->flags = flags;
+    free_slot->file = file;
+    free_slot->file_offset = file_offset;
+    
+    return free_slot;
+}
+
+// 预留一段虚拟地址区域，只记录范围和权限，物理页帧在首次访问时才分配
+static int vm_reserve_region_locked(page_directory_t* page_dir, unsigned int start, unsigned int size, unsigned int flags) {
+    if (!page_dir || size == 0 || (start & (PAGE_SIZE - 1)) != 0) {
+        return -1;
+    }
+    
+    unsigned int end = start + ((size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+    if (end <= start) {
+        return -1;
+    }
+    
+    return vm_add_region(page_dir, start, end, flags, 0, 0) ? 0 : -1;
+}
+
+// 在文件映射范围内查找一段未被占用的虚拟地址，失败返回0
+static unsigned int vm_find_free_area(page_directory_t* page_dir, unsigned int size) {
+    unsigned int start = VM_MMAP_BASE;
+    
+    while (start < VM_MMAP_END && VM_MMAP_END - start >= size) {
+        unsigned int end = start + size;
+        struct vm_region* overlap = 0;
+        
+        for (int i = 0; i < MAX_VM_REGIONS; i++) {
+            if (vm_regions[i].page_dir == page_dir &&
+                start < vm_regions[i].end && vm_regions[i].start < end) {
+                overlap = &vm_regions[i];
+                break;
+            }
+        }
+        
+        if (!overlap) {
+            return start;
+        }
+        start = overlap->end;
+    }
+    
+    return 0;
+}
+
+// 将文件从offset开始的size字节映射到地址空间，页面在首次访问时通过文件的read回调填充；
+// 返回映射的起始地址，失败返回0。可写映射为私有映射，写入时复制，不回写文件
+static unsigned int vm_map_file_locked(page_directory_t* page_dir, struct fs_node* node, unsigned int offset, unsigned int size, unsigned int flags) {
+    if (!page_dir || !node || !node->read || size == 0 || (offset & (PAGE_SIZE - 1)) != 0) {
+        return 0;
+    }
+    
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    unsigned int start = vm_find_free_area(page_dir, size);
+    if (start == 0) {
+        return 0;
+    }
+    
+    if (!vm_add_region(page_dir, start, start + size, flags, node, offset)) {
+        return 0;
+    }
+    
+    return start;
+}
+
+// 把一组已分配的页帧映射到地址空间的文件映射范围内，各地址空间直接共享这些页帧，
+// 每个映射持有每个页帧的一个引用；返回起始地址，失败返回0。用vm_release_region解除映射
+static unsigned int vm_map_shared_locked(page_directory_t* page_dir, const unsigned int* frames, unsigned int count, unsigned int flags) {
+    if (!page_dir || !frames || count == 0 || count > (VM_MMAP_END - VM_MMAP_BASE) / PAGE_SIZE) {
+        return 0;
+    }
+    
+    unsigned int size = count * PAGE_SIZE;
+    unsigned int start = vm_find_free_area(page_dir, size);
+    if (start == 0) {
+        return 0;
+    }
+    
+    if (!vm_add_region(page_dir, start, start + size, flags | VM_REGION_SHARED, 0, 0)) {
+        return 0;
+    }
+    
+    int user = (flags & VM_REGION_USER) != 0;
+    int rw = (flags & VM_REGION_WRITE) != 0;
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int addr = start + i * PAGE_SIZE;
+        if (vm_set_pte(page_dir, addr, frames[i] << 12, user, rw) != 0) {
+            // 已映射的页由释放区域时归还引用
+            vm_release_region(page_dir, start);
+            return 0;
+        }
+        vm_get_pte(page_dir, addr)->available = PTE_SHARED;
+        vm_ref_frame(frames[i]);
+    }
+    
+    vm_flush_range(page_dir, start, count);
+    return start;
+}
+
+// 共享内存页中某个地址对应的物理地址（各地址空间映射的虚拟地址可以不同），不是共享内存页时返回0
+static unsigned int vm_shared_physical_address_locked(page_directory_t* page_dir, unsigned int virtual_addr) {
+    if (!page_dir) {
+        return 0;
+    }
+    
+    page_table_entry_t* pte = vm_get_pte(page_dir, virtual_addr);
+    if (!pte || !pte->present || !(pte->available & PTE_SHARED)) {
+        return 0;
+    }
+    return (pte->frame << 12) | (virtual_addr & (PAGE_SIZE - 1));
+}
+
+// 在地址空间中建立进程栈：立即分配全部清零的页帧，成功返回0。栈在内核态使用，缺页时异常帧
+// 无处可压，所以既不按需分配也不写时复制，回收时跳过，fork时复制一份
+static int vm_map_stack_locked(page_directory_t* page_dir, unsigned int start, unsigned int size) {
+    if (!page_dir || size == 0 || ((start | size) & (PAGE_SIZE - 1)) != 0 || start + size <= start) {
+        return -1;
+    }
+    
+    if (!vm_add_region(page_dir, start, start + size, VM_REGION_WRITE | VM_REGION_STACK, 0, 0)) {
+        return -1;
+    }
+    
+    for (unsigned int addr = start; addr < start + size; addr += PAGE_SIZE) {
+        unsigned int frame = vm_allocate_zeroed_frame();
+        if (frame == 0 || vm_set_pte(page_dir, addr, frame << 12, 0, 1) != 0) {
+            if (frame) {
+                vm_free_frame(frame);
+            }
+            // 已映射的页由释放区域时归还
+            vm_release_region(page_dir, start);
+            return -1;
+        }
+    }
+    
+    vm_flush_range(page_dir, start, size / PAGE_SIZE);
+    return 0;
+}
+
+// 页缓存中(文件, 页号)对应的组
+static struct page_cache_entry* page_cache_set(struct fs_node* node, unsigned int index) {
+    unsigned int hash = (((unsigned int)node >> 4) ^ (index * 2654435761u)) % VM_PAGE_CACHE_SETS;
+    return page_cache[hash];
+}
+
+// 查找缓存的文件页，未命中返回0
+static unsigned int page_cache_lookup(struct fs_node* node, unsigned int index) {
+    struct page_cache_entry* set = page_cache_set(node, index);
+    
+    for (int i = 0; i < VM_PAGE_CACHE_WAYS; i++) {
+        if (set[i].node == node && set[i].index == index) {
+            return set[i].frame;
+        }
+    }
+    return 0;
+}
+
+// 将文件页放入缓存：优先使用空项，否则替换只被缓存自身引用的项；
+// 整组都在被映射使用时不缓存，页帧只属于当前映射
+static void page_cache_insert(struct fs_node* node, unsigned int index, unsigned int frame) {
+    struct page_cache_entry* set = page_cache_set(node, index);
+    struct page_cache_entry* victim = 0;
+    
+    for (int i = 0; i < VM_PAGE_CACHE_WAYS; i++) {
+        if (!set[i].node) {
+            victim = &set[i];
+            break;
+        }
+        if (!victim && vm_frame_refcount(set[i].frame) == 1) {
+            victim = &set[i];
+        }
+    }
+    if (!victim) {
+        return;
+    }
+    
+    if (victim->node) {
+        vm_free_frame(victim->frame);
+    }
+    victim->node = node;
+    victim->index = index;
+    victim->frame = frame;
+    vm_ref_frame(frame);
+}
+
+// 丢弃某个文件的全部缓存页（文件内容改变或文件被删除时调用），已有映射不受影响
+static void vm_page_cache_invalidate_locked(struct fs_node* node) {
+    for (int i = 0; i < VM_PAGE_CACHE_SETS; i++) {
+        for (int j = 0; j < VM_PAGE_CACHE_WAYS; j++) {
+            if (page_cache[i][j].node == node) {
+                vm_free_frame(page_cache[i][j].frame);
+                page_cache[i][j].node = 0;
+            }
+        }
+    }
+}
+
+// 处理文件映射区域的缺页：优先共享页缓存中的页帧，否则读取文件内容到新页帧；
+// 页面总是以只读方式映射，可写区域标记写时复制
+static int vm_handle_file_fault(struct vm_region* region, unsigned int page) {
+    struct fs_node* node = region->file;
+    unsigned int index = (region->file_offset + (page - region->start)) / PAGE_SIZE;
+    
+    vm_statistics.file_faults++;
+    
+    unsigned int frame = page_cache_lookup(node, index);
+    if (frame) {
+        vm_ref_frame(frame);
+        vm_statistics.page_cache_hits++;
+    } else {
+        frame = vm_allocate_zeroed_frame();
+        if (frame == 0) {
+            return -1;
+        }
+        
+        // 物理内存已恒等映射，直接填充页帧，文件末尾之后的部分保持为0
+        unsigned char* buffer = (unsigned char*)(frame << 12);
+        unsigned int file_offset = index * PAGE_SIZE;
+        if (file_offset < node->size) {
+            unsigned int length = node->size - file_offset;
+            if (length > PAGE_SIZE) {
+                length = PAGE_SIZE;
+            }
+            node->read(node, file_offset, length, buffer);
+        }
+        
+        page_cache_insert(node, index, frame);
+    }
+    
+    int user = (region->flags & VM_REGION_USER) != 0;
+    if (vm_map_page(current_page_directory[smp_processor_id()], page, frame << 12, user, 0) != 0) {
+        vm_free_frame(frame);
+        return -1;
+    }
+    if (region->flags & VM_REGION_WRITE) {
+        vm_get_pte(current_page_directory[smp_processor_id()], page)->available |= PTE_COW;
+    }
+    
+    return 0;
+}
+
+// 释放预留区域，归还其中已经分配的页帧
+static int vm_release_region_locked(page_directory_t* page_dir, unsigned int start) {
+    struct vm_region* region = vm_find_region(page_dir, start);
+    if (!region || region->start != start) {
+        return -1;
+    }
+    
+    vm_unmap_range(page_dir, region->start, region->end - region->start);
+    
+    region->page_dir = 0;
+    return 0;
+}
+
+// 丢弃只被页缓存自身引用的文件页（之后访问时重新读取文件），最多target个，返回释放的页帧数
+static unsigned int page_cache_shrink(unsigned int target) {
+    unsigned int freed = 0;
+    
+    for (int i = 0; i < VM_PAGE_CACHE_SETS && freed < target; i++) {
+        for (int j = 0; j < VM_PAGE_CACHE_WAYS && freed < target; j++) {
+            if (page_cache[i][j].node && vm_frame_refcount(page_cache[i][j].frame) == 1) {
+                vm_free_frame(page_cache[i][j].frame);
+                page_cache[i][j].node = 0;
+                vm_statistics.reclaimed_pages++;
+                freed++;
+            }
+        }
+    }
+    
+    return freed;
+}
+
+// 换出一个匿名页：从未写过的页仍然全为0，直接丢弃（再次访问时重新按需清零），
+// 其余存入压缩存储，页表项改为记录槽号
+static int vm_swap_out(page_directory_t* page_dir, unsigned int page, page_table_entry_t* pte) {
+    unsigned int frame = pte->frame;
+    unsigned int slot = 0;
+    
+    // 先撤销映射并刷新所有处理器的TLB，之后不会再有写入，此时的脏位和页面内容才是最终的
+    pte->present = 0;
+    vm_flush_range(page_dir, page, 1);
+    
+    if (pte->dirty) {
+        slot = zswap_store(frame);
+        if (slot == 0) {
+            pte->present = 1;
+            return -1;
+        }
+    } else {
+        vm_statistics.reclaim_dropped++;
+    }
+    
+    pte->accessed = 0;
+    pte->dirty = 0;
+    pte->available = slot ? PTE_SWAPPED : 0;
+    pte->frame = slot;
+    
+    vm_free_frame(frame);
+    vm_statistics.reclaimed_pages++;
+    return 0;
+}
+
+// 用时钟算法回收页帧直到空闲页帧增加target个：先丢弃只被页缓存引用的文件页，再沿匿名区域的页表项
+// 推进时钟指针，访问位为1的页清除访问位后跳过（第二次机会），其余换出；返回净增加的空闲页帧数
+// （压缩存储新占用的页帧已扣除）。每次最多推进VM_RECLAIM_SCAN_LIMIT步，没有任何净增加时继续推进
+// 直到转满三圈（每页至少被检查两次）。清除访问位时不刷新TLB，TLB中仍有条目的页再次访问时
+// 不会重新置位，代价只是偶尔换出一个热页
+static unsigned int vm_reclaim_pages_locked(unsigned int target) {
+    unsigned int free_before = vm_statistics.free_pages;
+    unsigned int reclaimed = page_cache_shrink(target);
+    unsigned int scanned = 0;
+    unsigned int wraps = 0;
+    
+    while (reclaimed < target && (scanned < VM_RECLAIM_SCAN_LIMIT || (reclaimed == 0 && wraps < 3))) {
+        struct vm_region* region = &vm_regions[clock_region];
+        scanned++;
+    
+        // 当前区域已扫描完或不是可换出的匿名私有区域时转到下一个区域
+        if (!region->page_dir || region->file || (region->flags & (VM_REGION_SHARED | VM_REGION_STACK)) ||
+            clock_addr >= region->end) {
+            clock_region = (clock_region + 1) % MAX_VM_REGIONS;
+            clock_addr = vm_regions[clock_region].start;
+            if (clock_region == 0) {
+                wraps++;
+            }
+            continue;
+        }
+        if (clock_addr < region->start) {
+            clock_addr = region->start;
+        }
+        
+        unsigned int page = clock_addr;
+        page_table_entry_t* pte = vm_get_pte(region->page_dir, page);
+        if (!pte) {
+            // 整个页表不存在，跳到下一个4MB边界
+            clock_addr = (page & ~(LARGE_PAGE_SIZE - 1)) + LARGE_PAGE_SIZE;
+            if (clock_addr <= page) {
+                clock_addr = region->end;
+            }
+            continue;
+        }
+        clock_addr += PAGE_SIZE;
+        
+        // 只回收独占的单页帧，与其他地址空间共享的页（写时复制）留给引用者
+        unsigned int frame = pte->frame;
+        if (!pte->present || vm_frame_refcount(frame) != 1 || page_frames[frame].order != 0) {
+            continue;
+        }
+        vm_statistics.reclaim_scanned++;
+        
+        if (pte->accessed) {
+            pte->accessed = 0;
+            continue;
+        }
+        
+        vm_swap_out(region->page_dir, page, pte);
+        reclaimed = vm_statistics.free_pages > free_before ? vm_statistics.free_pages - free_before : 0;
+    }
+    
+    return reclaimed;
+}
+
+// 从压缩存储恢复换出的页，恢复后的内容无法从别处重建，标记为脏页
+static int vm_swap_in(struct vm_region* region, page_table_entry_t* pte) {
+    unsigned int slot = pte->frame;
+    unsigned int frame = vm_allocate_frame();
+    if (frame == 0) {
+        return -1;
     }
     
-    // 标记前4MB为已使用(内核空间)
-    for (int i = 0; i < 1024; i++) {
-        page_frame_bitmap[i / 8] |= (1 << (i % 8));
+    if (zswap_load(slot, frame) != 0) {
+        vm_free_frame(frame);
+        return -1;
     }
+    zswap_put_slot(slot);
     
-    // 初始化虚拟内存统计
-    vm_statistics.total_pages = TOTAL_PHYSICAL_PAGES;
-    vm_statistics.used_pages = 1024; // 内核占用的页
-    vm_statistics.free_pages = TOTAL_PHYSICAL_PAGES - 1024;
-    vm_statistics.page_faults = 0;
+    pte->frame = frame;
+    pte->available = 0;
+    pte->rw = (region->flags & VM_REGION_WRITE) != 0;
+    pte->user = (region->flags & VM_REGION_USER) != 0;
+    pte->accessed = 1;
+    pte->dirty = 1;
+    pte->present = 1;
+    vm_statistics.swap_ins++;
     
-    // 创建内核页目录
-    kernel_page_directory = (page_directory_t*)allocate_memory(sizeof(page_directory_t));
+    return 0;
+}
+
+// 获取内核页目录
+page_directory_t* vm_get_kernel_directory() {
+    return kernel_page_directory;
+}
+
+// 页目录项是否属于固定的内核范围（所有地址空间共享其页表）
+static int vm_is_kernel_pde(unsigned int index) {
+    return index < (VM_KERNEL_LOW_END >> 22) || index >= (VM_KERNEL_HIGH_BASE >> 22);
+}
+
+// 创建新的地址空间：内核部分与内核页目录共享同一组（全局）页目录项，用户部分为空
+static page_directory_t* vm_create_address_space_locked() {
     if (!kernel_page_directory) {
-        print_string("Error: Failed to allocate kernel page directory\n");
-        return;
+        return 0;
+    }
+    
+    page_directory_t* page_dir = (page_directory_t*)vm_allocate_table_frame();
+    if (!page_dir) {
+        return 0;
     }
     
-    // 初始化页目录项
+    // 只复制固定的内核范围，内核页目录中测试或启动期间建立的用户范围映射不属于新地址空间
     for (int i = 0; i < 1024; i++) {
-        kernel_page_directory->entries[i].present = 0;
-        kernel_page_directory->entries[i].rw = 1;
-        kernel_page_directory->entries[i].user = 0;
-        kernel_page_directory->entries[i].write_through = 0;
-        kernel_page_directory->entries[i].cache_disabled = 0;
-        kernel_page_directory->entries[i].accessed = 0;
-        kernel_page_directory->entries[i].reserved = 0;
-        kernel_page_directory->entries[i].page_size = 0;
-        kernel_page_directory->entries[i].global = 0;
-        kernel_page_directory->entries[i].available = 0;
-        kernel_page_directory->entries[i].frame = 0;
-    }
-    
-    // 设置内核页表(映射前4MB)
-    for (int i = 0; i < 4; i++) {
-        // 创建页表
-        page_table_t* table = &page_tables[i];
-        
-        // 初始化页表项
-        for (int j = 0; j < 1024; j++) {
-            table->entries[j].present = 1;
-            table->entries[j].rw = 1;
-            table->entries[j].user = 0;
-            table->entries[j].write_through = 0;
-            table->entries[j].cache_disabled = 0;
-            table->entries[j].accessed = 0;
-            table->entries[j].dirty = 0;
-            table->entries[j].reserved = 0;
-            table->entries[j].global = 1;
-            table->entries[j].available = 0;
-            table->entries[j].frame = (i * 1024 * 4096 + j * 4096) >> 12;
+        if (vm_is_kernel_pde(i)) {
+            page_dir->entries[i] = kernel_page_directory->entries[i];
         }
-        
-        // 设置页目录项
-        kernel_page_directory->entries[i].present = 1;
-        kernel_page_directory->entries[i].rw = 1;
-        kernel_page_directory->entries[i].user = 0;
-        kernel_page_directory->entries[i].frame = ((unsigned int)table) >> 12;
     }
     
-    // 加载页目录到CR3寄存器
-    load_page_directory(kernel_page_directory);
+    return page_dir;
+}
+
+// 切换地址空间：只重新加载CR3，内核映射为全局页，其TLB条目不会被刷掉
+void vm_switch_address_space(page_directory_t* page_dir) {
+    if (!page_dir) {
+        page_dir = kernel_page_directory;
+    }
+    if (!page_dir || page_dir == current_page_directory[smp_processor_id()]) {
+        return;
+    }
     
-    // 启用分页
-    enable_paging();
+    load_page_directory(page_dir);
+    vm_statistics.address_space_switches++;
+}
+
+// 无条件重新加载CR3（例如进程从别的处理器迁移过来），丢弃本处理器TLB中该地址空间的非全局条目
+void vm_reload_address_space(page_directory_t* page_dir) {
+    if (!page_dir) {
+        page_dir = kernel_page_directory;
+    }
+    if (!page_dir) {
+        return;
+    }
     
-    print_string("Virtual memory management initialized\n");
-    print_string("Total pages: ");
-    char pages_str[16];
-    int_to_string(vm_statistics.total_pages, pages_str);
-    print_string(pages_str);
-    print_string("\n");
+    load_page_directory(page_dir);
+    vm_statistics.address_space_switches++;
 }
 
-// 分配页帧
-unsigned int vm_allocate_frame() {
-    // 查找空闲页帧
-    for (int i = 0; i < PAGE_FRAME_BITMAP_SIZE; i++) {
-        if (page_frame_bitmap[i] != 0xFF) {
-            for (int j = 0; j < 8; j++) {
-                if (!(page_frame_bitmap[i] & (1 << j))) {
-                    // 标记为已使用
-                    page_frame_bitmap[i] |= (1 << j);
-                    
-                    // 更新统计信息
-                    vm_statistics.used_pages++;
-                    vm_statistics.free_pages--;
-                    
-                    // 返回页帧号
-                    return (i * 8 + j);
+// 复制地址空间：内核页表直接共享，用户页改为只读并标记写时复制，
+// 父子进程共享页帧直到其中一方写入，开销与页表大小成正比而不是与驻留内存成正比
+static page_directory_t* vm_clone_directory_locked(page_directory_t* src) {
+    if (!src) {
+        return 0;
+    }
+    
+    page_directory_t* dest = (page_directory_t*)vm_allocate_table_frame();
+    if (!dest) {
+        return 0;
+    }
+    
+    int write_protected = 0;
+    
+    for (unsigned int i = 0; i < 1024; i++) {
+        if (!src->entries[i].present) {
+            continue;
+        }
+        
+        if (vm_is_kernel_pde(i) || src->entries[i].page_size) {
+            dest->entries[i] = src->entries[i];
+            continue;
+        }
+        
+        page_table_t* src_table = (page_table_t*)(src->entries[i].frame << 12);
+        page_table_t* dest_table = (page_table_t*)vm_allocate_table_frame();
+        if (!dest_table) {
+            vm_destroy_directory(dest);
+            return 0;
+        }
+    
+        // 先挂上页表，中途失败时由vm_destroy_directory归还已复制的页表项
+        dest->entries[i] = src->entries[i];
+        dest->entries[i].frame = ((unsigned int)dest_table) >> 12;
+    
+        for (int j = 0; j < 1024; j++) {
+            page_table_entry_t* pte = &src_table->entries[j];
+            if (!pte->present) {
+                // 换出的页共享同一个压缩存储槽，恢复时各自解压出私有副本
+                if (pte->available & PTE_SWAPPED) {
+                    dest_table->entries[j] = *pte;
+                    zswap_slots[pte->frame].refs++;
+                }
+                continue;
+            }
+    
+            // 栈页不能写保护，立即复制一份
+            struct vm_region* region = vm_find_region(src, (i << 22) | (j << 12));
+            if (region && (region->flags & VM_REGION_STACK)) {
+                unsigned int frame = vm_allocate_frame();
+                if (frame == 0) {
+                    if (write_protected) {
+                        vm_flush_range(src, 0, 1024 * 1024);
+                    }
+                    vm_destroy_directory(dest);
+                    return 0;
                 }
+                copy_page((void*)(frame << 12), (const void*)(pte->frame << 12));
+                dest_table->entries[j] = *pte;
+                dest_table->entries[j].frame = frame;
+                continue;
+            }
+    
+            // 可写的私有页在父子双方都改为只读，写入时再复制；共享内存页保持原样
+            if (pte->rw && !(pte->available & PTE_SHARED)) {
+                pte->rw = 0;
+                pte->available |= PTE_COW;
+                write_protected = 1;
             }
+            dest_table->entries[j] = *pte;
+            vm_ref_frame(pte->frame);
         }
     }
     
-    // 没有空闲页帧
-    return 0;
-}
-
-// 释放页帧
-void vm_free_frame(unsigned int frame) {
-    if (frame >= TOTAL_PHYSICAL_PAGES) {
-        return;
+    // 预留的按需分配区域同样继承
+    for (int i = 0; i < MAX_VM_REGIONS; i++) {
+        if (vm_regions[i].page_dir == src) {
+            if (!vm_add_region(dest, vm_regions[i].start, vm_regions[i].end, vm_regions[i].flags,
+                               vm_regions[i].file, vm_regions[i].file_offset)) {
+                vm_destroy_directory(dest);
+                return 0;
+            }
+        }
     }
     
-    // 标记为未使用
-    page_frame_bitmap[frame / 8] &= ~(1 << (frame % 8));
+    // 父进程的写权限已被收回，刷新所有使用该页目录的处理器的整个TLB
+    if (write_protected) {
+        vm_flush_range(src, 0, 1024 * 1024);
+    }
     
-    // 更新统计信息
-    vm_statistics.used_pages--;
-    vm_statistics.free_pages++;
+    return dest;
 }
 
-// 创建页表
-page_table_t* vm_create_page_table() {
-    // 在实际实现中，这里会分配物理内存给页表
-    static int table_index = 4; // 前4个页表已用于内核
-    
-    if (table_index >= MAX_PAGE_TABLES) {
-        return 0; // 没有可用的页表
+// 销毁地址空间：释放用户页的引用、用户页表和页目录本身，内核页表不受影响
+static void vm_destroy_directory_locked(page_directory_t* page_dir) {
+    if (!page_dir || page_dir == kernel_page_directory || page_dir == current_page_directory[smp_processor_id()]) {
+        return;
     }
     
-    page_table_t* table = &page_tables[table_index++];
+    for (int i = 0; i < MAX_VM_REGIONS; i++) {
+        if (vm_regions[i].page_dir == page_dir) {
+            vm_regions[i].page_dir = 0;
+        }
+    }
     
-    // 初始化页表项
-    for (int i = 0; i < 1024; i++) {
-        table->entries[i].present = 0;
-        table->entries[i].rw = 0;
-        table->entries[i].user = 0;
-        table->entries[i].write_through = 0;
-        table->entries[i].cache_disabled = 0;
-        table->entries[i].accessed = 0;
-        table->entries[i].dirty = 0;
-        table->entries[i].reserved = 0;
-        table->entries[i].global = 0;
-        table->entries[i].available = 0;
-        table->entries[i].frame = 0;
+    for (unsigned int i = 0; i < 1024; i++) {
+        if (!page_dir->entries[i].present || vm_is_kernel_pde(i) ||
+            page_dir->entries[i].page_size) {
+            continue;
+        }
+        
+        page_table_t* table = (page_table_t*)(page_dir->entries[i].frame << 12);
+        for (int j = 0; j < 1024; j++) {
+            if (table->entries[j].present) {
+                vm_put_mapped_frame(table->entries[j].frame);
+            } else if (table->entries[j].available & PTE_SWAPPED) {
+                zswap_put_slot(table->entries[j].frame);
+            }
+        }
+        vm_free_frame(page_dir->entries[i].frame);
+        vm_statistics.page_table_frames--;
     }
     
-    return table;
+    vm_free_frame(((unsigned int)page_dir) >> 12);
+    vm_statistics.page_table_frames--;
 }
 
-// 映射虚拟地址到物理地址
-int vm_map_page(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, int user, int rw) {
-    if (!page_dir) {
+// 处理写时复制页错误：最后一个引用者直接恢复写权限，否则复制到新页帧
+static int vm_handle_cow_fault(unsigned int faulting_address, unsigned int error_code) {
+    page_table_entry_t* pte = vm_get_pte(current_page_directory[smp_processor_id()], faulting_address);
+    if (!pte || !pte->present || !(pte->available & PTE_COW)) {
+        return -1;
+    }
+    if ((error_code & 0x4) && !pte->user) {
         return -1;
     }
     
-    // 计算页目录索引和页表索引
-    unsigned int page_dir_index = virtual_addr >> 22;
-    unsigned int page_table_index = (virtual_addr >> 12) & 0x3FF;
+    unsigned int page = faulting_address & ~(PAGE_SIZE - 1);
+    unsigned int old_frame = pte->frame;
+    vm_statistics.cow_faults++;
     
-    // 如果页目录项不存在，则创建页表
-    if (!page_dir->entries[page_dir_index].present) {
-        page_table_t* new_table = vm_create_page_table();
-        if (!new_table) {
+    if (vm_frame_refcount(old_frame) > 1) {
+        unsigned int new_frame = vm_allocate_frame();
+        if (new_frame == 0) {
             return -1;
         }
-        
-        // 设置页目录项
-        page_dir->entries[page_dir_index].present = 1;
-        page_dir->entries[page_dir_index].rw = rw;
-        page_dir->entries[page_dir_index].user = user;
-        page_dir->entries[page_dir_index].frame = ((unsigned int)new_table) >> 12;
+        copy_page((void*)(new_frame << 12), (const void*)(old_frame << 12));
+        pte->frame = new_frame;
+        vm_free_frame(old_frame);
+        vm_statistics.cow_copies++;
     }
     
-    // 获取页表
-    page_table_t* table = (page_table_t*)(page_dir->entries[page_dir_index].frame << 12);
-    
-    // 设置页表项
-    table->entries[page_table_index].present = 1;
-    table->entries[page_table_index].rw = rw;
-    table->entries[page_table_index].user = user;
-    table->entries[page_table_index].frame = physical_addr >> 12;
-    
-    // 刷新TLB
-    flush_tlb_entry(virtual_addr);
+    pte->available &= ~PTE_COW;
+    pte->rw = 1;
+    flush_tlb_entry(page);
     
     return 0;
 }
 
-// 处理页错误
-void vm_handle_page_fault(unsigned int faulting_address, unsigned int error_code) {
+// 处理页错误：访问预留区域中尚未分配的页时分配并清零一个页帧，
+// 成功处理返回0，其余情况返回-1由异常处理程序报告
+static int vm_handle_page_fault_locked(unsigned int faulting_address, unsigned int error_code) {
     // 更新统计信息
     vm_statistics.page_faults++;
     
-    print_string("Page fault at address: 0x");
-    char addr_str[16];
-    hex_to_string(faulting_address, addr_str);
-    print_string(addr_str);
-    print_string("\n");
+    // 对写时复制页的写保护违例
+    if ((error_code & 0x3) == 0x3) {
+        return vm_handle_cow_fault(faulting_address, error_code);
+    }
     
-    // 分析错误代码
+    // 其余保护违例不属于按需分配
     if (error_code & 0x1) {
-        print_string("Page protection violation\n");
-    } else {
-        print_string("Page not present\n");
+        return -1;
     }
     
-    if (error_code & 0x2) {
-        print_string("Write operation\n");
-    } else {
-        print_string("Read operation\n");
+    struct vm_region* region = vm_find_region(current_page_directory[smp_processor_id()], faulting_address);
+    if (!region) {
+        return -1;
     }
     
-    if (error_code & 0x4) {
-        print_string("User mode access\n");
-    } else {
-        print_string("Supervisor mode access\n");
+    // 检查访问权限
+    if ((error_code & 0x2) && !(region->flags & VM_REGION_WRITE)) {
+        return -1;
+    }
+    if ((error_code & 0x4) && !(region->flags & VM_REGION_USER)) {
+        return -1;
+    }
+    
+    unsigned int page = faulting_address & ~(PAGE_SIZE - 1);
+    
+    // 换出到压缩存储的页
+    page_table_entry_t* pte = vm_get_pte(current_page_directory[smp_processor_id()], page);
+    if (pte && !pte->present && (pte->available & PTE_SWAPPED)) {
+        return vm_swap_in(region, pte);
     }
     
-    // 在实际实现中，这里会处理页错误
-    // 可能的操作包括：
-    // 1. 分配物理页帧
-    // 2. 从磁盘加载页面
-    // 3. 终止进程（如果访问非法）
+    // 共享内存的页在映射时已全部建立，不按需分配
+    if (region->flags & VM_REGION_SHARED) {
+        return -1;
+    }
+    
+    // 文件映射区域从文件填充
+    if (region->file) {
+        return vm_handle_file_fault(region, page);
+    }
+    
+    unsigned long long start_time = profiling_get_timestamp();
+    
+    // 清零通过恒等映射完成（通常已在空闲时预先清零），页表项的脏位保持为0，
+    // 回收时未写过的页可直接丢弃
+    unsigned int frame = vm_allocate_zeroed_frame();
+    if (frame == 0) {
+        return -1;
+    }
     
-    // 简化实现，只记录错误
+    int user = (region->flags & VM_REGION_USER) != 0;
+    int rw = (region->flags & VM_REGION_WRITE) != 0;
+    if (vm_map_page(current_page_directory[smp_processor_id()], page, frame << 12, user, rw) != 0) {
+        vm_free_frame(frame);
+        return -1;
+    }
+    
+    unsigned long long elapsed = profiling_get_timestamp() - start_time;
+    vm_statistics.minor_faults++;
+    vm_statistics.minor_fault_time += elapsed;
+    if (elapsed > vm_statistics.minor_fault_time_max) {
+        vm_statistics.minor_fault_time_max = elapsed;
+    }
+    
+    return 0;
+}
+
+// 以下公开接口获取虚拟内存锁后调用对应的_locked实现。锁可以在同一处理器上重复获取，
+// 公开接口之间相互调用（包括_locked实现调用公开接口）不会死锁
+unsigned int alloc_pages(unsigned int order) {
+    vm_lock();
+    unsigned int result = alloc_pages_locked(order);
+    vm_unlock();
+    return result;
+}
+
+void free_pages(unsigned int frame, unsigned int order) {
+    vm_lock();
+    free_pages_locked(frame, order);
+    vm_unlock();
+}
+
+unsigned int vm_allocate_frame() {
+    vm_lock();
+    unsigned int result = vm_allocate_frame_locked();
+    vm_unlock();
+    return result;
+}
+
+unsigned int vm_allocate_zeroed_frame() {
+    vm_lock();
+    unsigned int result = vm_allocate_zeroed_frame_locked();
+    vm_unlock();
+    return result;
+}
+
+void vm_refill_zero_pool() {
+    vm_lock();
+    vm_refill_zero_pool_locked();
+    vm_unlock();
+}
+
+void vm_set_zero_pool_watermark(unsigned int watermark) {
+    vm_lock();
+    vm_set_zero_pool_watermark_locked(watermark);
+    vm_unlock();
+}
+
+int vm_allocate_frames(unsigned int count, unsigned int* frames) {
+    vm_lock();
+    int result = vm_allocate_frames_locked(count, frames);
+    vm_unlock();
+    return result;
+}
+
+void vm_free_frame(unsigned int frame) {
+    vm_lock();
+    vm_free_frame_locked(frame);
+    vm_unlock();
+}
+
+void vm_ref_frame(unsigned int frame) {
+    vm_lock();
+    vm_ref_frame_locked(frame);
+    vm_unlock();
+}
+
+unsigned int vm_frame_refcount(unsigned int frame) {
+    vm_lock();
+    unsigned int result = vm_frame_refcount_locked(frame);
+    vm_unlock();
+    return result;
+}
+
+page_table_t* vm_create_page_table() {
+    vm_lock();
+    page_table_t* result = vm_create_page_table_locked();
+    vm_unlock();
+    return result;
+}
+
+int vm_map_large_page(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, int user, int rw) {
+    vm_lock();
+    int result = vm_map_large_page_locked(page_dir, virtual_addr, physical_addr, user, rw);
+    vm_unlock();
+    return result;
+}
+
+int vm_map_page(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, int user, int rw) {
+    vm_lock();
+    int result = vm_map_page_locked(page_dir, virtual_addr, physical_addr, user, rw);
+    vm_unlock();
+    return result;
+}
+
+int vm_map_range(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, unsigned int size, int user, int rw) {
+    vm_lock();
+    int result = vm_map_range_locked(page_dir, virtual_addr, physical_addr, size, user, rw);
+    vm_unlock();
+    return result;
+}
+
+void vm_unmap_range(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int size) {
+    vm_lock();
+    vm_unmap_range_locked(page_dir, virtual_addr, size);
+    vm_unlock();
+}
+
+int vm_reserve_region(page_directory_t* page_dir, unsigned int start, unsigned int size, unsigned int flags) {
+    vm_lock();
+    int result = vm_reserve_region_locked(page_dir, start, size, flags);
+    vm_unlock();
+    return result;
+}
+
+unsigned int vm_map_file(page_directory_t* page_dir, struct fs_node* node, unsigned int offset, unsigned int size, unsigned int flags) {
+    vm_lock();
+    unsigned int result = vm_map_file_locked(page_dir, node, offset, size, flags);
+    vm_unlock();
+    return result;
+}
+
+unsigned int vm_map_shared(page_directory_t* page_dir, const unsigned int* frames, unsigned int count, unsigned int flags) {
+    vm_lock();
+    unsigned int result = vm_map_shared_locked(page_dir, frames, count, flags);
+    vm_unlock();
+    return result;
+}
+
+unsigned int vm_shared_physical_address(page_directory_t* page_dir, unsigned int virtual_addr) {
+    vm_lock();
+    unsigned int result = vm_shared_physical_address_locked(page_dir, virtual_addr);
+    vm_unlock();
+    return result;
+}
+
+int vm_map_stack(page_directory_t* page_dir, unsigned int start, unsigned int size) {
+    vm_lock();
+    int result = vm_map_stack_locked(page_dir, start, size);
+    vm_unlock();
+    return result;
+}
+
+void vm_page_cache_invalidate(struct fs_node* node) {
+    vm_lock();
+    vm_page_cache_invalidate_locked(node);
+    vm_unlock();
+}
+
+int vm_release_region(page_directory_t* page_dir, unsigned int start) {
+    vm_lock();
+    int result = vm_release_region_locked(page_dir, start);
+    vm_unlock();
+    return result;
+}
+
+unsigned int vm_reclaim_pages(unsigned int target) {
+    vm_lock();
+    unsigned int result = vm_reclaim_pages_locked(target);
+    vm_unlock();
+    return result;
+}
+
+page_directory_t* vm_create_address_space() {
+    vm_lock();
+    page_directory_t* result = vm_create_address_space_locked();
+    vm_unlock();
+    return result;
+}
+
+page_directory_t* vm_clone_directory(page_directory_t* src) {
+    vm_lock();
+    page_directory_t* result = vm_clone_directory_locked(src);
+    vm_unlock();
+    return result;
+}
+
+void vm_destroy_directory(page_directory_t* page_dir) {
+    vm_lock();
+    vm_destroy_directory_locked(page_dir);
+    vm_unlock();
+}
+
+int vm_handle_page_fault(unsigned int faulting_address, unsigned int error_code) {
+    vm_lock();
+    int result = vm_handle_page_fault_locked(faulting_address, error_code);
+    vm_unlock();
+    return result;
+}
+
+// 获取当前加载的页目录
+page_directory_t* vm_get_current_directory() {
+    return current_page_directory[smp_processor_id()];
 }
 
 // 获取虚拟内存统计信息
@@ -266,14 +2135,137 @@ void vm_print_stats() {
     print_string(stat_str);
     print_string("\n");
     
+    print_string("Zeroed frame pool: ");
+    int_to_string(vm_statistics.zero_pool_frames, stat_str);
+    print_string(stat_str);
+    print_string(" / ");
+    int_to_string(zero_pool_watermark, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
     print_string("Page faults: ");
     int_to_string(vm_statistics.page_faults, stat_str);
     print_string(stat_str);
     print_string("\n");
+    
+    print_string("Page table frames: ");
+    int_to_string(vm_statistics.page_table_frames, stat_str);
+    print_string(stat_str);
+    print_string(", 4MB pages: ");
+    int_to_string(vm_statistics.large_pages, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("TLB flushes: ");
+    int_to_string(vm_statistics.tlb_page_flushes, stat_str);
+    print_string(stat_str);
+    print_string(" single, ");
+    int_to_string(vm_statistics.tlb_full_flushes, stat_str);
+    print_string(stat_str);
+    print_string(" full, ");
+    int_to_string(vm_statistics.tlb_shootdowns, stat_str);
+    print_string(stat_str);
+    print_string(" shootdowns; address space switches: ");
+    int_to_string(vm_statistics.address_space_switches, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("File faults: ");
+    int_to_string(vm_statistics.file_faults, stat_str);
+    print_string(stat_str);
+    print_string(", page cache hits: ");
+    int_to_string(vm_statistics.page_cache_hits, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Reclaim: scanned ");
+    int_to_string(vm_statistics.reclaim_scanned, stat_str);
+    print_string(stat_str);
+    print_string(", reclaimed ");
+    int_to_string(vm_statistics.reclaimed_pages, stat_str);
+    print_string(stat_str);
+    print_string(" (");
+    int_to_string(vm_statistics.reclaim_dropped, stat_str);
+    print_string(stat_str);
+    print_string(" clean), incompressible ");
+    int_to_string(vm_statistics.zswap_rejected, stat_str);
+    print_string(stat_str);
+    print_string(", swap-ins ");
+    int_to_string(vm_statistics.swap_ins, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Compressed store: ");
+    int_to_string(vm_statistics.zswap_pages, stat_str);
+    print_string(stat_str);
+    print_string(" pages (");
+    int_to_string(vm_statistics.zswap_same_filled, stat_str);
+    print_string(stat_str);
+    print_string(" same-filled) in ");
+    int_to_string(vm_statistics.zswap_frames, stat_str);
+    print_string(stat_str);
+    print_string(" frames, ");
+    int_to_string(vm_statistics.zswap_bytes, stat_str);
+    print_string(stat_str);
+    print_string(" bytes");
+    if (vm_statistics.zswap_frames > 0) {
+        // 压缩比 = 存储的页数 / 实际占用的页帧数
+        unsigned int ratio = vm_statistics.zswap_pages * 100 / vm_statistics.zswap_frames;
+        print_string(", ratio ");
+        int_to_string(ratio / 100, stat_str);
+        print_string(stat_str);
+        print_string(".");
+        int_to_string((ratio % 100) / 10, stat_str);
+        print_string(stat_str);
+        int_to_string(ratio % 10, stat_str);
+        print_string(stat_str);
+        print_string(":1");
+    }
+    print_string("\n");
+    
+    print_string("COW faults: ");
+    int_to_string(vm_statistics.cow_faults, stat_str);
+    print_string(stat_str);
+    print_string(", copies: ");
+    int_to_string(vm_statistics.cow_copies, stat_str);
+    print_string(stat_str);
+    print_string("\n");
+    
+    print_string("Minor faults (demand-zero): ");
+    int_to_string(vm_statistics.minor_faults, stat_str);
+    print_string(stat_str);
+    if (vm_statistics.minor_faults > 0) {
+        print_string(", avg latency: ");
+        unsigned long long total_ns = profiling_cycles_to_ns(vm_statistics.minor_fault_time);
+        int_to_string((int)div_u64_u32(total_ns, vm_statistics.minor_faults), stat_str);
+        print_string(stat_str);
+        print_string(" ns, max: ");
+        int_to_string((int)profiling_cycles_to_ns(vm_statistics.minor_fault_time_max), stat_str);
+        print_string(stat_str);
+        print_string(" ns");
+    }
+    print_string("\n");
+    
+    print_string("Buddy free blocks by order:");
+    for (int i = 0; i <= BUDDY_MAX_ORDER; i++) {
+        print_string(" ");
+        int_to_string(vm_statistics.buddy_free_blocks[i], stat_str);
+        print_string(stat_str);
+    }
+    print_string("\n");
+    
+    print_string("Buddy splits: ");
+    int_to_string(vm_statistics.buddy_splits, stat_str);
+    print_string(stat_str);
+    print_string(", merges: ");
+    int_to_string(vm_statistics.buddy_merges, stat_str);
+    print_string(stat_str);
+    print_string("\n");
 }
 
 // 加载页目录到CR3寄存器
 void load_page_directory(page_directory_t* page_dir) {
+    current_page_directory[smp_processor_id()] = page_dir;
     __asm__ volatile (
         "mov %0, %%cr3"
         :
@@ -282,11 +2274,12 @@ void load_page_directory(page_directory_t* page_dir) {
     );
 }
 
-// 启用分页
+// 启用分页(CR0.PG)和写保护(CR0.WP)：没有WP时内核态写只读页不会触发缺页，
+// 内核代替进程写入写时复制的页面会绕过复制。AP直接沿用BSP的CR0
 void enable_paging() {
     __asm__ volatile (
         "mov %%cr0, %%eax\n\t"
-        "or $0x80000000, %%eax\n\t"
+        "or $0x80010000, %%eax\n\t"
         "mov %%eax, %%cr0"
         :
         :
@@ -294,6 +2287,18 @@ void enable_paging() {
     );
 }
 
+// 启用4MB页(CR4.PSE)和全局页(CR4.PGE)
+void enable_large_pages() {
+    __asm__ volatile (
+        "mov %%cr4, %%eax\n\t"
+        "or $0x90, %%eax\n\t"
+        "mov %%eax, %%cr4"
+        :
+        :
+        : "eax", "memory"
+    );
+}
+
 // 刷新TLB条目
 void flush_tlb_entry(unsigned int virtual_addr) {
     __asm__ volatile (
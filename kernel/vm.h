@@ -8,11 +8,61 @@
 #define PHYSICAL_MEMORY_SIZE (128 * 1024 * 1024)
 #define TOTAL_PHYSICAL_PAGES (PHYSICAL_MEMORY_SIZE / PAGE_SIZE)
 
-// 页帧位图大小 (以字节为单位)
-#define PAGE_FRAME_BITMAP_SIZE (TOTAL_PHYSICAL_PAGES / 8)
+// 页帧位图大小 (以32位字为单位)，每位表示一个页帧是否空闲
+#define FRAME_BITMAP_WORDS (TOTAL_PHYSICAL_PAGES / 32)
 
-// 最大页表数
-#define MAX_PAGE_TABLES 1024
+// 摘要位图大小，每位表示页帧位图中对应的字是否还有空闲页帧
+#define FRAME_SUMMARY_WORDS (FRAME_BITMAP_WORDS / 32)
+
+// 大页大小（PSE，4MB）
+#define LARGE_PAGE_SIZE (4 * 1024 * 1024)
+
+// 批量修改映射后，页数超过该值时重新加载CR3刷新整个TLB，否则逐页invlpg
+#define TLB_FLUSH_THRESHOLD 32
+
+// 取消映射时攒够这么多页帧就先刷新TLB再释放它们
+#define VM_UNMAP_BATCH 64
+
+// 伙伴分配器最大阶数（2^10个页帧 = 4MB）
+#define BUDDY_MAX_ORDER 10
+
+// 按需分配的虚拟内存区域数上限
+#define MAX_VM_REGIONS 64
+
+// 虚拟内存区域标志
+#define VM_REGION_USER  0x1   // 用户态可访问
+#define VM_REGION_WRITE 0x2   // 可写
+#define VM_REGION_SHARED 0x4  // 共享内存：页帧在映射时建立，fork后继续共享而不写时复制
+#define VM_REGION_STACK  0x8  // 进程栈：页帧在映射时建立，不换出，fork时直接复制（内核态使用的栈上不能发生缺页）
+
+// 文件映射在用户地址空间中的分配范围
+#define VM_MMAP_BASE 0x80000000
+#define VM_MMAP_END  0xC0000000
+
+// 内核地址范围，所有地址空间共享这两段的页目录项：低端用4MB大页恒等映射全部物理内存，
+// 高端窗口用于本地APIC等设备寄存器，其页表在初始化时全部建好，之后新增的内核映射不必同步到各地址空间。
+// 用户区域不能与之重叠
+#define VM_KERNEL_LOW_END   PHYSICAL_MEMORY_SIZE
+#define VM_KERNEL_HIGH_BASE 0xC0000000
+
+// 文件页缓存：按(文件, 页号)组相联，共VM_PAGE_CACHE_SETS组，每组VM_PAGE_CACHE_WAYS路
+#define VM_PAGE_CACHE_SETS 64
+#define VM_PAGE_CACHE_WAYS 4
+
+// 预清零页帧池容量上限，实际补充到的水位由配置项zero_pool_watermark决定
+#define VM_ZERO_POOL_MAX 256
+// 空闲时每次最多清零的页帧数，避免推迟空闲期间到来的中断的后续处理
+#define VM_ZERO_POOL_REFILL_BATCH 16
+
+// 页回收：页帧耗尽时一次回收的页数，以及时钟指针每次推进的步数上限
+#define VM_RECLAIM_BATCH      32
+#define VM_RECLAIM_SCAN_LIMIT 4096
+
+// 压缩存储（内存中的交换区）：槽位数，以及单页压缩后的字节数上限，超过则视为不可压缩
+#define VM_ZSWAP_SLOTS    8192
+#define VM_ZSWAP_MAX_SIZE (PAGE_SIZE * 3 / 4)
+
+struct fs_node;
 
 // 页目录项结构
 typedef struct {
@@ -60,22 +110,76 @@ struct vm_stats {
     unsigned int used_pages;    // 已使用页数
     unsigned int free_pages;    // 空闲页数
     unsigned int page_faults;   // 页错误次数
+    unsigned int buddy_free_blocks[BUDDY_MAX_ORDER + 1]; // 各阶空闲块数
+    unsigned int buddy_splits;  // 分裂次数
+    unsigned int buddy_merges;  // 合并次数
+    unsigned int minor_faults;  // 按需分配零页处理的页错误次数
+    unsigned long long minor_fault_time;     // 处理这些页错误的总耗时
+    unsigned long long minor_fault_time_max; // 单次最长耗时
+    unsigned int cow_faults;    // 写时复制页错误次数
+    unsigned int cow_copies;    // 其中需要复制页帧的次数（其余直接恢复写权限）
+    unsigned int page_table_frames; // 页目录和页表占用的页帧数
+    unsigned int large_pages;   // 4MB大页映射数
+    unsigned int tlb_page_flushes;  // 逐页刷新（invlpg）次数
+    unsigned int tlb_full_flushes;  // 重新加载CR3的整体刷新次数
+    unsigned int tlb_shootdowns;    // 向其他处理器发出的TLB shootdown请求数
+    unsigned int address_space_switches; // 地址空间切换次数
+    unsigned int file_faults;   // 文件映射页错误次数
+    unsigned int page_cache_hits; // 其中直接共享页缓存中页帧的次数
+    unsigned int reclaim_scanned; // 时钟算法检查的页数
+    unsigned int reclaimed_pages; // 被回收（换出或丢弃）的页数
+    unsigned int reclaim_dropped; // 其中从未写过、直接丢弃的零页数
+    unsigned int zswap_rejected;  // 压缩率不足而留在内存中的页数
+    unsigned int swap_ins;        // 从压缩存储恢复的页数
+    unsigned int zswap_pages;     // 当前压缩存储中的页数
+    unsigned int zswap_same_filled; // 其中整页为同一个值、不占存储空间的页数
+    unsigned int zswap_bytes;     // 压缩数据占用的字节数
+    unsigned int zswap_frames;    // 压缩存储占用的页帧数
+    unsigned int zero_pool_frames; // 预清零页帧池中的页帧数
 };
 
 // 函数声明
 void vm_init();
 unsigned int vm_allocate_frame();
+unsigned int vm_allocate_zeroed_frame();
+void vm_refill_zero_pool();
+void vm_set_zero_pool_watermark(unsigned int watermark);
+int vm_allocate_frames(unsigned int count, unsigned int* frames);
 void vm_free_frame(unsigned int frame);
+void vm_ref_frame(unsigned int frame);
+unsigned int vm_frame_refcount(unsigned int frame);
+unsigned int alloc_pages(unsigned int order);
+void free_pages(unsigned int frame, unsigned int order);
 page_table_t* vm_create_page_table();
 int vm_map_page(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, int user, int rw);
-void vm_handle_page_fault(unsigned int faulting_address, unsigned int error_code);
+int vm_map_large_page(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, int user, int rw);
+int vm_map_range(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int physical_addr, unsigned int size, int user, int rw);
+void vm_unmap_range(page_directory_t* page_dir, unsigned int virtual_addr, unsigned int size);
+int vm_handle_page_fault(unsigned int faulting_address, unsigned int error_code);
+int vm_reserve_region(page_directory_t* page_dir, unsigned int start, unsigned int size, unsigned int flags);
+int vm_release_region(page_directory_t* page_dir, unsigned int start);
+unsigned int vm_map_file(page_directory_t* page_dir, struct fs_node* node, unsigned int offset, unsigned int size, unsigned int flags);
+void vm_page_cache_invalidate(struct fs_node* node);
+unsigned int vm_map_shared(page_directory_t* page_dir, const unsigned int* frames, unsigned int count, unsigned int flags);
+unsigned int vm_shared_physical_address(page_directory_t* page_dir, unsigned int virtual_addr);
+int vm_map_stack(page_directory_t* page_dir, unsigned int start, unsigned int size);
+unsigned int vm_reclaim_pages(unsigned int target);
+page_directory_t* vm_get_current_directory();
+page_directory_t* vm_get_kernel_directory();
+page_directory_t* vm_create_address_space();
+void vm_switch_address_space(page_directory_t* page_dir);
+void vm_reload_address_space(page_directory_t* page_dir);
+page_directory_t* vm_clone_directory(page_directory_t* src);
+void vm_destroy_directory(page_directory_t* page_dir);
 struct vm_stats* vm_get_stats();
 void vm_print_stats();
 
 // 内部函数
 void load_page_directory(page_directory_t* page_dir);
 void enable_paging();
+void enable_large_pages();
 void flush_tlb_entry(unsigned int virtual_addr);
+void vm_flush_tlb_local(unsigned int virtual_addr, unsigned int pages);
 
 // 辅助函数
 void hex_to_string(unsigned int value, char* str);
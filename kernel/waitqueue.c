@@ -0,0 +1,111 @@
+#include "waitqueue.h"
+#include "process.h"
+#include "scheduler.h"
+#include "context.h"
+
+// 初始化等待队列
+void wait_queue_init(struct wait_queue* wq) {
+    spin_lock_init(&wq->lock);
+    wq->head = 0;
+    wq->tail = 0;
+    wq->count = 0;
+}
+
+// 把等待者挂到队尾（调用者持有wq->lock）
+void wait_queue_add(struct wait_queue* wq, struct wait_queue_entry* entry) {
+    entry->next = 0;
+    entry->prev = wq->tail;
+    if (wq->tail) {
+        wq->tail->next = entry;
+    } else {
+        wq->head = entry;
+    }
+    wq->tail = entry;
+    wq->count++;
+}
+
+// 把等待者从队列中摘下（调用者持有wq->lock）
+void wait_queue_remove(struct wait_queue* wq, struct wait_queue_entry* entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        wq->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        wq->tail = entry->prev;
+    }
+    entry->next = 0;
+    entry->prev = 0;
+    wq->count--;
+}
+
+// 摘下并唤醒指定的等待者（调用者持有wq->lock）。
+// 在锁内唤醒：超时返回的等待者要先拿到锁才能离开，不会在它开始别的等待之后才被这里唤醒
+void wait_queue_wake_entry(struct wait_queue* wq, struct wait_queue_entry* entry) {
+    wait_queue_remove(wq, entry);
+    entry->woken = 1;
+    scheduler_wake_process(entry->proc);
+}
+
+// 当前进程在队列上阻塞，timeout为最多等待的tick数，0表示一直等待。
+// 调用者持有wq->lock并已确认需要等待，返回时锁已释放
+int wait_queue_sleep(struct wait_queue* wq, struct wait_queue_entry* entry, unsigned int timeout) {
+    struct process* proc = context_get_current();
+    if (!proc) {
+        spin_unlock(&wq->lock);
+        return WAIT_NO_CONTEXT;
+    }
+    
+    // 持有队列锁时进入等待状态：唤醒方必须先拿到这把锁，唤醒不会早于进入等待
+    entry->proc = proc;
+    entry->woken = 0;
+    wait_queue_add(wq, entry);
+    scheduler_block(proc, timeout);
+    spin_unlock(&wq->lock);
+    
+    // 回到调度循环，被唤醒或超时后从这里继续
+    process_yield();
+    
+    spin_lock(&wq->lock);
+    int woken = entry->woken;
+    if (!woken) {
+        wait_queue_remove(wq, entry);
+    }
+    spin_unlock(&wq->lock);
+    
+    return woken ? WAIT_WOKEN : WAIT_TIMEOUT;
+}
+
+// 无条件地在队列上等待下一次唤醒
+int wait_queue_wait(struct wait_queue* wq, unsigned int timeout) {
+    struct wait_queue_entry entry;
+    
+    spin_lock(&wq->lock);
+    return wait_queue_sleep(wq, &entry, timeout);
+}
+
+// 按到达顺序唤醒最多nr个等待者，返回唤醒的个数
+unsigned int wait_queue_wake(struct wait_queue* wq, unsigned int nr) {
+    unsigned int woken = 0;
+    
+    spin_lock(&wq->lock);
+    while (woken < nr && wq->head) {
+        wait_queue_wake_entry(wq, wq->head);
+        woken++;
+    }
+    spin_unlock(&wq->lock);
+    
+    return woken;
+}
+
+// 唤醒最早的等待者
+unsigned int wait_queue_wake_one(struct wait_queue* wq) {
+    return wait_queue_wake(wq, 1);
+}
+
+// 唤醒所有等待者
+unsigned int wait_queue_wake_all(struct wait_queue* wq) {
+    return wait_queue_wake(wq, WAIT_ALL);
+}
@@ -0,0 +1,58 @@
+#ifndef WAITQUEUE_H
+#define WAITQUEUE_H
+
+#include "spinlock.h"
+
+// 等待队列：进程在队列上阻塞，直到其他进程唤醒它或等待超时。
+// 等待条件由调用者在持有wq->lock时检查，确认需要等待后调用wait_queue_sleep，
+// 唤醒方修改条件后在同一把锁下唤醒，因此不会丢失唤醒：
+//
+//     spin_lock(&wq->lock);
+//     while (!condition) {
+//         wait_queue_sleep(wq, &entry, 0);   // 返回时已释放锁
+//         spin_lock(&wq->lock);
+//     }
+//     spin_unlock(&wq->lock);
+//
+// 中断处理程序不获取自旋锁，不能直接唤醒等待队列
+
+// wait_queue_sleep的返回值
+#define WAIT_WOKEN       0   // 被唤醒
+#define WAIT_TIMEOUT    -1   // 超时（或被等待队列以外的原因唤醒）
+#define WAIT_NO_CONTEXT -2   // 当前不在进程上下文中（例如调度循环），不能阻塞
+
+// 唤醒所有等待者时使用的数量
+#define WAIT_ALL 0xFFFFFFFF
+
+struct process;
+
+// 等待者，通常放在等待进程的内核栈上，只在等待期间挂在队列中
+struct wait_queue_entry {
+    struct process* proc;
+    struct wait_queue_entry* next;
+    struct wait_queue_entry* prev;
+    volatile unsigned int woken;   // 由唤醒方摘下并置位
+};
+
+// 等待队列，等待者按到达顺序排列，唤醒从队首开始
+struct wait_queue {
+    spinlock_t lock;
+    struct wait_queue_entry* head;
+    struct wait_queue_entry* tail;
+    unsigned int count;
+};
+
+#define WAIT_QUEUE_INIT { SPINLOCK_INIT, 0, 0, 0 }
+
+// 函数声明
+void wait_queue_init(struct wait_queue* wq);
+void wait_queue_add(struct wait_queue* wq, struct wait_queue_entry* entry);
+void wait_queue_remove(struct wait_queue* wq, struct wait_queue_entry* entry);
+void wait_queue_wake_entry(struct wait_queue* wq, struct wait_queue_entry* entry);
+int wait_queue_sleep(struct wait_queue* wq, struct wait_queue_entry* entry, unsigned int timeout);
+int wait_queue_wait(struct wait_queue* wq, unsigned int timeout);
+unsigned int wait_queue_wake(struct wait_queue* wq, unsigned int nr);
+unsigned int wait_queue_wake_one(struct wait_queue* wq);
+unsigned int wait_queue_wake_all(struct wait_queue* wq);
+
+#endif
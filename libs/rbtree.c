@@ -0,0 +1,285 @@
+#include "rbtree.h"
+
+// 以node为支点左旋：node的右孩子取代node的位置
+static void rb_rotate_left(struct rb_node* node, struct rb_root* root) {
+    struct rb_node* right = node->right;
+    
+    node->right = right->left;
+    if (right->left) {
+        right->left->parent = node;
+    }
+    
+    right->parent = node->parent;
+    if (!node->parent) {
+        root->node = right;
+    } else if (node == node->parent->left) {
+        node->parent->left = right;
+    } else {
+        node->parent->right = right;
+    }
+    
+    right->left = node;
+    node->parent = right;
+}
+
+// 以node为支点右旋：node的左孩子取代node的位置
+static void rb_rotate_right(struct rb_node* node, struct rb_root* root) {
+    struct rb_node* left = node->left;
+    
+    node->left = left->right;
+    if (left->right) {
+        left->right->parent = node;
+    }
+    
+    left->parent = node->parent;
+    if (!node->parent) {
+        root->node = left;
+    } else if (node == node->parent->right) {
+        node->parent->right = left;
+    } else {
+        node->parent->left = left;
+    }
+    
+    left->right = node;
+    node->parent = left;
+}
+
+// 插入后恢复红黑性质：消除红色节点的红色父节点
+void rb_insert_color(struct rb_node* node, struct rb_root* root) {
+    struct rb_node* parent;
+    
+    while ((parent = node->parent) && parent->color == RB_RED) {
+        struct rb_node* grandparent = parent->parent;
+    
+        if (parent == grandparent->left) {
+            struct rb_node* uncle = grandparent->right;
+            if (uncle && uncle->color == RB_RED) {
+                // 叔节点为红：父、叔变黑，祖父变红，问题上移两层
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                grandparent->color = RB_RED;
+                node = grandparent;
+                continue;
+            }
+    
+            if (node == parent->right) {
+                rb_rotate_left(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+    
+            parent->color = RB_BLACK;
+            grandparent->color = RB_RED;
+            rb_rotate_right(grandparent, root);
+        } else {
+            struct rb_node* uncle = grandparent->left;
+            if (uncle && uncle->color == RB_RED) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                grandparent->color = RB_RED;
+                node = grandparent;
+                continue;
+            }
+    
+            if (node == parent->left) {
+                rb_rotate_right(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+    
+            parent->color = RB_BLACK;
+            grandparent->color = RB_RED;
+            rb_rotate_left(grandparent, root);
+        }
+    }
+    
+    root->node->color = RB_BLACK;
+}
+
+// 删除黑色节点后恢复红黑性质：node（可能为空）所在子树少了一个黑色节点
+static void rb_erase_color(struct rb_node* node, struct rb_node* parent, struct rb_root* root) {
+    while (node != root->node && (!node || node->color == RB_BLACK)) {
+        if (node == parent->left) {
+            struct rb_node* sibling = parent->right;
+            if (sibling->color == RB_RED) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_left(parent, root);
+                sibling = parent->right;
+            }
+    
+            if ((!sibling->left || sibling->left->color == RB_BLACK) &&
+                (!sibling->right || sibling->right->color == RB_BLACK)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+    
+            if (!sibling->right || sibling->right->color == RB_BLACK) {
+                sibling->left->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_right(sibling, root);
+                sibling = parent->right;
+            }
+    
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->right->color = RB_BLACK;
+            rb_rotate_left(parent, root);
+            node = root->node;
+            break;
+        } else {
+            struct rb_node* sibling = parent->left;
+            if (sibling->color == RB_RED) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_right(parent, root);
+                sibling = parent->left;
+            }
+    
+            if ((!sibling->left || sibling->left->color == RB_BLACK) &&
+                (!sibling->right || sibling->right->color == RB_BLACK)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+    
+            if (!sibling->left || sibling->left->color == RB_BLACK) {
+                sibling->right->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_left(sibling, root);
+                sibling = parent->left;
+            }
+    
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->left->color = RB_BLACK;
+            rb_rotate_right(parent, root);
+            node = root->node;
+            break;
+        }
+    }
+    
+    if (node) {
+        node->color = RB_BLACK;
+    }
+}
+
+// 用new_node替换old_node在父节点中的位置
+static void rb_replace_child(struct rb_node* old_node, struct rb_node* new_node,
+                             struct rb_node* parent, struct rb_root* root) {
+    if (!parent) {
+        root->node = new_node;
+    } else if (parent->left == old_node) {
+        parent->left = new_node;
+    } else {
+        parent->right = new_node;
+    }
+}
+
+// 从树中删除节点
+void rb_erase(struct rb_node* node, struct rb_root* root) {
+    struct rb_node* child;
+    struct rb_node* parent;
+    int color;
+    
+    if (node->left && node->right) {
+        // 有两个孩子：用中序后继（右子树的最左节点）顶替node的位置和颜色
+        struct rb_node* successor = node->right;
+        while (successor->left) {
+            successor = successor->left;
+        }
+    
+        child = successor->right;
+        parent = successor->parent;
+        color = successor->color;
+    
+        if (parent == node) {
+            parent = successor;
+        } else {
+            if (child) {
+                child->parent = parent;
+            }
+            parent->left = child;
+            successor->right = node->right;
+            node->right->parent = successor;
+        }
+    
+        successor->parent = node->parent;
+        successor->color = node->color;
+        successor->left = node->left;
+        node->left->parent = successor;
+        rb_replace_child(node, successor, node->parent, root);
+    } else {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        color = node->color;
+    
+        if (child) {
+            child->parent = parent;
+        }
+        rb_replace_child(node, child, parent, root);
+    }
+    
+    if (color == RB_BLACK) {
+        rb_erase_color(child, parent, root);
+    }
+}
+
+// 最小的节点
+struct rb_node* rb_first(const struct rb_root* root) {
+    struct rb_node* node = root->node;
+    if (!node) {
+        return 0;
+    }
+    while (node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+// 最大的节点
+struct rb_node* rb_last(const struct rb_root* root) {
+    struct rb_node* node = root->node;
+    if (!node) {
+        return 0;
+    }
+    while (node->right) {
+        node = node->right;
+    }
+    return node;
+}
+
+// 中序后继
+struct rb_node* rb_next(const struct rb_node* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return (struct rb_node*)node;
+    }
+    
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+// 中序前驱
+struct rb_node* rb_prev(const struct rb_node* node) {
+    if (node->left) {
+        node = node->left;
+        while (node->right) {
+            node = node->right;
+        }
+        return (struct rb_node*)node;
+    }
+    
+    while (node->parent && node == node->parent->left) {
+        node = node->parent;
+    }
+    return node->parent;
+}
@@ -0,0 +1,55 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+// 侵入式红黑树：节点嵌入在使用者的结构中，树只负责平衡，比较由使用者完成。
+// 插入时使用者自己从根向下查找位置，用rb_link_node挂上节点，再调用rb_insert_color恢复平衡：
+//
+//     struct rb_node** link = &root->node;
+//     struct rb_node* parent = 0;
+//     while (*link) {
+//         parent = *link;
+//         link = key < rb_entry(parent, struct item, node)->key ? &parent->left : &parent->right;
+//     }
+//     rb_link_node(&item->node, parent, link);
+//     rb_insert_color(&item->node, root);
+
+#define RB_RED   0
+#define RB_BLACK 1
+
+struct rb_node {
+    struct rb_node* parent;
+    struct rb_node* left;
+    struct rb_node* right;
+    int color;
+};
+
+struct rb_root {
+    struct rb_node* node;
+};
+
+// 由节点指针得到包含它的结构
+#define rb_entry(ptr, type, member) \
+    ((type*)((char*)(ptr) - __builtin_offsetof(type, member)))
+
+static inline void rb_root_init(struct rb_root* root) {
+    root->node = 0;
+}
+
+// 将新节点挂到parent下由link指向的空位置（着红色，尚未平衡）
+static inline void rb_link_node(struct rb_node* node, struct rb_node* parent, struct rb_node** link) {
+    node->parent = parent;
+    node->left = 0;
+    node->right = 0;
+    node->color = RB_RED;
+    *link = node;
+}
+
+// 函数声明
+void rb_insert_color(struct rb_node* node, struct rb_root* root);
+void rb_erase(struct rb_node* node, struct rb_root* root);
+struct rb_node* rb_first(const struct rb_root* root);
+struct rb_node* rb_last(const struct rb_root* root);
+struct rb_node* rb_next(const struct rb_node* node);
+struct rb_node* rb_prev(const struct rb_node* node);
+
+#endif
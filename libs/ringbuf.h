@@ -0,0 +1,189 @@
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+// 单生产者/单消费者无锁环形缓冲区，放在共享内存段的开头，两个进程各自映射后直接读写：
+// head只由生产者写，tail只由消费者写，两者都是不回绕的计数，取模后得到数据区内的位置。
+// x86的存储不会与更早的存储重排，因此只需编译器屏障保证"先写数据再发布head"和"先读数据再发布tail"。
+//
+// 典型用法（生产者）：
+//     struct ring_buffer* ring = ring_init(shm_attach(...), SEGMENT_SIZE);
+//     ring_send(ring, &request, sizeof(request));
+// 消费者：
+//     struct ring_buffer* ring = ring_attach(shm_attach(...));
+//     unsigned int n = ring_receive(ring, buffer, sizeof(buffer));
+//
+// 大块数据可以用ring_write_ptr/ring_produce直接在共享内存中构造，ring_read_ptr/ring_consume原地读取，
+// 避免经过中间缓冲区
+
+// 头部魔数，用于确认段已被生产者初始化
+#define RING_MAGIC 0x52494E47
+
+// 缓存行大小，生产者和消费者各自修改的字段放在不同缓存行，避免伪共享
+#define RING_CACHE_LINE 64
+
+// 消息长度前缀的字节数
+#define RING_MSG_HEADER 4
+
+#define RING_BARRIER() __asm__ volatile ("" : : : "memory")
+
+// 环形缓冲区头部，数据区紧随其后
+struct ring_buffer {
+    unsigned int magic;
+    unsigned int size;               // 数据区大小（2的幂）
+    unsigned int mask;               // size - 1
+    unsigned char pad0[RING_CACHE_LINE - 3 * sizeof(unsigned int)];
+    volatile unsigned int head;      // 已写入的总字节数（生产者）
+    unsigned char pad1[RING_CACHE_LINE - sizeof(unsigned int)];
+    volatile unsigned int tail;      // 已读取的总字节数（消费者）
+    unsigned char pad2[RING_CACHE_LINE - sizeof(unsigned int)];
+    unsigned char data[];
+};
+
+// 在memory开始的bytes字节上初始化环形缓冲区（由生产者调用一次），数据区取不超过剩余空间的最大2的幂，
+// 空间不足时返回0
+static inline struct ring_buffer* ring_init(void* memory, unsigned int bytes) {
+    struct ring_buffer* ring = (struct ring_buffer*)memory;
+    if (!ring || bytes <= sizeof(struct ring_buffer)) {
+        return 0;
+    }
+    
+    unsigned int available = bytes - sizeof(struct ring_buffer);
+    unsigned int size = 1;
+    while (size <= available / 2) {
+        size <<= 1;
+    }
+    
+    ring->size = size;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    RING_BARRIER();
+    ring->magic = RING_MAGIC;
+    return ring;
+}
+
+// 使用已由生产者初始化的环形缓冲区，未初始化时返回0
+static inline struct ring_buffer* ring_attach(void* memory) {
+    struct ring_buffer* ring = (struct ring_buffer*)memory;
+    if (!ring || ring->magic != RING_MAGIC) {
+        return 0;
+    }
+    RING_BARRIER();
+    return ring;
+}
+
+// 可读取的字节数
+static inline unsigned int ring_used(const struct ring_buffer* ring) {
+    return ring->head - ring->tail;
+}
+
+// 可写入的字节数
+static inline unsigned int ring_free(const struct ring_buffer* ring) {
+    return ring->size - (ring->head - ring->tail);
+}
+
+// 生产者：返回可直接写入的连续空间起始地址，*length为其长度（到数据区末尾为止）
+static inline unsigned char* ring_write_ptr(struct ring_buffer* ring, unsigned int* length) {
+    unsigned int head = ring->head;
+    unsigned int offset = head & ring->mask;
+    unsigned int space = ring->size - (head - ring->tail);
+    
+    *length = (space < ring->size - offset) ? space : ring->size - offset;
+    return ring->data + offset;
+}
+
+// 生产者：发布已写入的bytes字节
+static inline void ring_produce(struct ring_buffer* ring, unsigned int bytes) {
+    RING_BARRIER();
+    ring->head += bytes;
+}
+
+// 消费者：返回可直接读取的连续数据起始地址，*length为其长度（到数据区末尾为止）
+static inline const unsigned char* ring_read_ptr(struct ring_buffer* ring, unsigned int* length) {
+    unsigned int tail = ring->tail;
+    unsigned int offset = tail & ring->mask;
+    unsigned int used = ring->head - tail;
+    RING_BARRIER();
+    
+    *length = (used < ring->size - offset) ? used : ring->size - offset;
+    return ring->data + offset;
+}
+
+// 消费者：释放已读取的bytes字节
+static inline void ring_consume(struct ring_buffer* ring, unsigned int bytes) {
+    RING_BARRIER();
+    ring->tail += bytes;
+}
+
+// 从position开始向数据区复制（处理回绕），不发布
+static inline void ring_copy_in(struct ring_buffer* ring, unsigned int position, const void* buffer, unsigned int bytes) {
+    const unsigned char* src = (const unsigned char*)buffer;
+    for (unsigned int i = 0; i < bytes; i++) {
+        ring->data[(position + i) & ring->mask] = src[i];
+    }
+}
+
+// 从position开始从数据区复制出来（处理回绕），不释放
+static inline void ring_copy_out(const struct ring_buffer* ring, unsigned int position, void* buffer, unsigned int bytes) {
+    unsigned char* dst = (unsigned char*)buffer;
+    for (unsigned int i = 0; i < bytes; i++) {
+        dst[i] = ring->data[(position + i) & ring->mask];
+    }
+}
+
+// 生产者：写入最多bytes字节的字节流，返回实际写入的字节数
+static inline unsigned int ring_write(struct ring_buffer* ring, const void* buffer, unsigned int bytes) {
+    unsigned int space = ring_free(ring);
+    if (bytes > space) {
+        bytes = space;
+    }
+    
+    ring_copy_in(ring, ring->head, buffer, bytes);
+    ring_produce(ring, bytes);
+    return bytes;
+}
+
+// 消费者：读取最多bytes字节的字节流，返回实际读取的字节数
+static inline unsigned int ring_read(struct ring_buffer* ring, void* buffer, unsigned int bytes) {
+    unsigned int used = ring_used(ring);
+    RING_BARRIER();
+    if (bytes > used) {
+        bytes = used;
+    }
+    
+    ring_copy_out(ring, ring->tail, buffer, bytes);
+    ring_consume(ring, bytes);
+    return bytes;
+}
+
+// 生产者：发送一条带长度前缀的消息，空间不足时不写入任何内容并返回-1
+static inline int ring_send(struct ring_buffer* ring, const void* message, unsigned int length) {
+    if (RING_MSG_HEADER + length > ring_free(ring)) {
+        return -1;
+    }
+    
+    ring_copy_in(ring, ring->head, &length, RING_MSG_HEADER);
+    ring_copy_in(ring, ring->head + RING_MSG_HEADER, message, length);
+    ring_produce(ring, RING_MSG_HEADER + length);
+    return 0;
+}
+
+// 消费者：接收一条消息，返回消息长度；没有消息返回0，缓冲区太小时消息保留在环中并返回-1
+static inline int ring_receive(struct ring_buffer* ring, void* buffer, unsigned int capacity) {
+    if (ring_used(ring) < RING_MSG_HEADER) {
+        return 0;
+    }
+    RING_BARRIER();
+    
+    unsigned int length;
+    ring_copy_out(ring, ring->tail, &length, RING_MSG_HEADER);
+    if (length > capacity) {
+        return -1;
+    }
+    
+    ring_copy_out(ring, ring->tail + RING_MSG_HEADER, buffer, length);
+    ring_consume(ring, RING_MSG_HEADER + length);
+    return (int)length;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include "sync.h"
+#include "../kernel/syscall.h"
+
+// 通过系统调用进入futex（eax为调用号，ebx、ecx、edx为参数）
+static inline int sync_futex(volatile unsigned int* uaddr, int op, unsigned int val) {
+    int result;
+    __asm__ volatile (
+        "int $0x80"
+        : "=a"(result)
+        : "a"(SYSCALL_FUTEX), "b"(uaddr), "c"(op), "d"(val)
+        : "memory"
+    );
+    return result;
+}
+
+// 原子地交换，返回旧值（xchg隐含lock前缀）
+static inline unsigned int sync_xchg(volatile unsigned int* ptr, unsigned int value) {
+    __asm__ volatile ("xchgl %0, %1" : "+r"(value), "+m"(*ptr) : : "memory");
+    return value;
+}
+
+// 初始化互斥锁
+void mutex_init(struct mutex* mutex) {
+    mutex->state = MUTEX_UNLOCKED;
+}
+
+// 加锁：无竞争时一次比较交换即可；否则把状态置为CONTENDED后在futex上等待，
+// 醒来后再次交换，读到UNLOCKED说明已经拿到锁（状态保持CONTENDED，解锁时会多一次唤醒，但不会丢失唤醒）
+void mutex_lock(struct mutex* mutex) {
+    unsigned int state = __sync_val_compare_and_swap(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED);
+    if (state == MUTEX_UNLOCKED) {
+        return;
+    }
+    
+    if (state != MUTEX_CONTENDED) {
+        state = sync_xchg(&mutex->state, MUTEX_CONTENDED);
+    }
+    while (state != MUTEX_UNLOCKED) {
+        sync_futex(&mutex->state, FUTEX_WAIT, MUTEX_CONTENDED);
+        state = sync_xchg(&mutex->state, MUTEX_CONTENDED);
+    }
+}
+
+// 尝试加锁，成功返回1
+int mutex_trylock(struct mutex* mutex) {
+    return __sync_val_compare_and_swap(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED) == MUTEX_UNLOCKED;
+}
+
+// 解锁：没有等待者（LOCKED）时只有一次原子减法，否则清零后唤醒一个等待者
+void mutex_unlock(struct mutex* mutex) {
+    if (__sync_fetch_and_sub(&mutex->state, 1) != MUTEX_LOCKED) {
+        mutex->state = MUTEX_UNLOCKED;
+        sync_futex(&mutex->state, FUTEX_WAKE, 1);
+    }
+}
+
+// 初始化条件变量
+void cond_init(struct cond_var* cond) {
+    cond->seq = 0;
+    cond->waiters = 0;
+}
+
+// 等待通知：调用者持有mutex，返回时重新持有。和其他条件变量一样可能虚假唤醒，调用者应循环检查条件。
+// 先登记为等待者再读seq：通知方先递增seq再检查waiters，读到旧seq的等待者一定会被看到
+void cond_wait(struct cond_var* cond, struct mutex* mutex) {
+    __sync_fetch_and_add(&cond->waiters, 1);
+    unsigned int seq = __sync_fetch_and_add(&cond->seq, 0);
+    mutex_unlock(mutex);
+    
+    sync_futex(&cond->seq, FUTEX_WAIT, seq);
+    
+    // 可能有其他被唤醒的进程同时在等锁，直接按有竞争的方式加锁，解锁时才会唤醒它们
+    while (sync_xchg(&mutex->state, MUTEX_CONTENDED) != MUTEX_UNLOCKED) {
+        sync_futex(&mutex->state, FUTEX_WAIT, MUTEX_CONTENDED);
+    }
+    __sync_fetch_and_sub(&cond->waiters, 1);
+}
+
+// 唤醒一个等待者
+void cond_signal(struct cond_var* cond) {
+    __sync_fetch_and_add(&cond->seq, 1);
+    if (cond->waiters) {
+        sync_futex(&cond->seq, FUTEX_WAKE, 1);
+    }
+}
+
+// 唤醒所有等待者
+void cond_broadcast(struct cond_var* cond) {
+    __sync_fetch_and_add(&cond->seq, 1);
+    if (cond->waiters) {
+        sync_futex(&cond->seq, FUTEX_WAKE, WAIT_ALL);
+    }
+}
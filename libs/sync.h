@@ -0,0 +1,36 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+// 基于futex的互斥锁和条件变量：状态放在调用者的内存中，无竞争时只用原子指令，
+// 只有需要阻塞或唤醒其他进程时才进入内核（SYSCALL_FUTEX）。
+// 放在共享内存段（shm_attach）中时可以跨进程使用：内核以共享页的物理地址为键，各进程映射的地址可以不同
+
+// 互斥锁状态
+#define MUTEX_UNLOCKED  0
+#define MUTEX_LOCKED    1   // 已加锁，没有等待者
+#define MUTEX_CONTENDED 2   // 已加锁，可能有等待者，解锁时需要唤醒
+
+struct mutex {
+    volatile unsigned int state;
+};
+
+// 条件变量：seq每次通知时递增，等待者在读到的seq上阻塞，通知与等待之间的递增使等待立即返回
+struct cond_var {
+    volatile unsigned int seq;
+    volatile unsigned int waiters;  // 正在等待的进程数，为0时通知不进入内核
+};
+
+#define MUTEX_INIT { MUTEX_UNLOCKED }
+#define COND_VAR_INIT { 0, 0 }
+
+// 函数声明
+void mutex_init(struct mutex* mutex);
+void mutex_lock(struct mutex* mutex);
+int mutex_trylock(struct mutex* mutex);
+void mutex_unlock(struct mutex* mutex);
+void cond_init(struct cond_var* cond);
+void cond_wait(struct cond_var* cond, struct mutex* mutex);
+void cond_signal(struct cond_var* cond);
+void cond_broadcast(struct cond_var* cond);
+
+#endif
@@ -31,6 +31,7 @@ void show_log_stats();
 void show_memory_map();
 void show_disk_usage();
 void show_network_stats();
+void show_heap_profile();
 
 // 系统调用模拟函数
 static inline void syscall_print_string(const char* str) {
@@ -93,6 +94,21 @@ static inline int syscall_get_process_list(struct process_list_entry* list, unsi
     return 0;
 }
 
+static inline int syscall_get_heap_profile(struct heap_site_stats* buf, unsigned int max_sites) {
+    int count;
+    __asm__ volatile (
+        "mov $40, %%eax\n\t"
+        "mov %1, %%ebx\n\t"
+        "mov %2, %%ecx\n\t"
+        "int $0x80\n\t"
+        "mov %%eax, %0\n\t"
+        : "=r"(count)
+        : "r"(buf), "r"(max_sites)
+        : "eax", "ebx", "ecx"
+    );
+    return count;
+}
+
 // 主函数
 int main(int argc, char* argv[]) {
     // 检查参数
@@ -118,6 +134,8 @@ int main(int argc, char* argv[]) {
         show_disk_usage();
     } else if (strcmp(argv[1], "-n") == 0 || strcmp(argv[1], "--network") == 0) {
         show_network_stats();
+    } else if (strcmp(argv[1], "-H") == 0 || strcmp(argv[1], "--heap") == 0) {
+        show_heap_profile();
     } else {
         syscall_print_string("Unknown option: ");
         syscall_print_string(argv[1]);
@@ -141,6 +159,7 @@ void print_help() {
     syscall_print_string("  -m, --memory      Show memory map\n");
     syscall_print_string("  -d, --disk        Show disk usage\n");
     syscall_print_string("  -n, --network     Show network statistics\n");
+    syscall_print_string("  -H, --heap        Show top heap consumers by allocation site\n");
 }
 
 // 显示系统信息
@@ -302,6 +321,58 @@ void show_network_stats() {
     syscall_print_string("lo         0         0         0        0\n");
 }
 
+// 显示堆分析（按分配位置统计的占用）
+void show_heap_profile() {
+    struct heap_site_stats sites[16];
+    int count = syscall_get_heap_profile(sites, 16);
+    
+    syscall_print_string("=== Heap Profile ===\n");
+    if (count <= 0) {
+        syscall_print_string("No allocation sites recorded (release allocator?)\n");
+        return;
+    }
+    
+    syscall_print_string("LIVE BYTES  BLOCKS  ALLOCS  SITE\n");
+    syscall_print_string("----------  ------  ------  ----\n");
+    
+    char buffer[32];
+    for (int i = 0; i < count; i++) {
+        // LIVE BYTES
+        int_to_string(sites[i].live_bytes, buffer);
+        int len = strlen(buffer);
+        for (int j = 0; j < 10 - len; j++) {
+            syscall_putchar(' ');
+        }
+        syscall_print_string(buffer);
+        syscall_print_string("  ");
+        
+        // BLOCKS
+        int_to_string(sites[i].live_count, buffer);
+        len = strlen(buffer);
+        for (int j = 0; j < 6 - len; j++) {
+            syscall_putchar(' ');
+        }
+        syscall_print_string(buffer);
+        syscall_print_string("  ");
+        
+        // ALLOCS
+        int_to_string(sites[i].total_allocations, buffer);
+        len = strlen(buffer);
+        for (int j = 0; j < 6 - len; j++) {
+            syscall_putchar(' ');
+        }
+        syscall_print_string(buffer);
+        syscall_print_string("  ");
+        
+        // SITE
+        syscall_print_string(sites[i].file);
+        syscall_putchar(':');
+        int_to_string(sites[i].line, buffer);
+        syscall_print_string(buffer);
+        syscall_putchar('\n');
+    }
+}
+
 // 字符串长度
 int strlen(const char* str) {
     int len = 0;